@@ -0,0 +1,152 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "load_balancer.h"
+#include "utils.h"
+
+/**
+ * Compara stocarea si cautarea cheilor pe rand (`loader_store`,
+ * `loader_retrieve`) cu stocarea si cautarea lor in grupuri
+ * (`loader_store_batch`, `loader_retrieve_batch`), verificand ca rezultatele
+ * coincid.
+ *
+ * Utilizare: batch_ops [numar_chei] [dimensiune_grup] [chained|flat]
+ */
+
+#define SERVER_NUM 64
+#define DEFAULT_KEYS 1000000
+#define DEFAULT_BATCH 1024
+#define KEY_LENGTH 32
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static load_balancer *create(ht_engine engine)
+{
+	load_balancer *lb = init_load_balancer();
+
+	loader_set_storage_engine(lb, engine);
+	for (int i = 0; i < SERVER_NUM; ++i)
+		loader_add_server(lb, i, 1);
+	return lb;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_keys = DEFAULT_KEYS;
+	size_t batch_size = DEFAULT_BATCH;
+	ht_engine engine = HT_ENGINE_CHAINED;
+
+	if (argc > 1)
+		num_keys = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		batch_size = strtoul(argv[2], NULL, 10);
+	if (argc > 3 && !strcmp(argv[3], "flat"))
+		engine = HT_ENGINE_FLAT;
+
+	char *storage = malloc(2 * num_keys * KEY_LENGTH);
+	char **keys = malloc(num_keys * sizeof(char *));
+	char **values = malloc(num_keys * sizeof(char *));
+	char **lookups = malloc(num_keys * sizeof(char *));
+	char **found = malloc(num_keys * sizeof(char *));
+	char **batch_found = malloc(num_keys * sizeof(char *));
+	int *ids = malloc(num_keys * sizeof(int));
+	int *batch_ids = malloc(num_keys * sizeof(int));
+	DIE(!storage || !keys || !values || !lookups || !found || !batch_found ||
+			!ids || !batch_ids,
+		"failed malloc() of keys");
+
+	unsigned int seed = 0x2023;
+	for (size_t i = 0; i < num_keys; ++i) {
+		keys[i] = storage + 2 * i * KEY_LENGTH;
+		values[i] = keys[i] + KEY_LENGTH;
+		snprintf(keys[i], KEY_LENGTH, "key_%u_%zu", next_random(&seed), i);
+		snprintf(values[i], KEY_LENGTH, "value_%u", next_random(&seed));
+	}
+	/* Cautarile sunt in ordine aleatoare, ca sa nu profite de cache. */
+	for (size_t i = 0; i < num_keys; ++i)
+		lookups[i] = keys[next_random(&seed) % num_keys];
+
+	load_balancer *single = create(engine);
+	load_balancer *batched = create(engine);
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; ++i)
+		loader_store(single, keys[i], values[i], &ids[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double store_single = elapsed(&start, &end);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; i += batch_size) {
+		size_t count = num_keys - i < batch_size ? num_keys - i : batch_size;
+		loader_store_batch(batched, keys + i, values + i, count,
+						   batch_ids + i);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double store_batch = elapsed(&start, &end);
+
+	if (memcmp(ids, batch_ids, num_keys * sizeof(int))) {
+		fprintf(stderr, "loader_store_batch: wrong servers\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; ++i)
+		found[i] = loader_retrieve(single, lookups[i], &ids[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double retrieve_single = elapsed(&start, &end);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; i += batch_size) {
+		size_t count = num_keys - i < batch_size ? num_keys - i : batch_size;
+		loader_retrieve_batch(batched, lookups + i, count, batch_found + i,
+							  batch_ids + i);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double retrieve_batch = elapsed(&start, &end);
+
+	for (size_t i = 0; i < num_keys; ++i) {
+		if (ids[i] != batch_ids[i] || !found[i] || !batch_found[i] ||
+			strcmp(found[i], batch_found[i])) {
+			fprintf(stderr, "loader_retrieve_batch: wrong value for %s\n",
+					lookups[i]);
+			return 1;
+		}
+	}
+
+	printf("op=store mode=single ops_per_sec=%.0f\n", num_keys / store_single);
+	printf("op=store mode=batch batch=%zu ops_per_sec=%.0f\n", batch_size,
+		   num_keys / store_batch);
+	printf("op=retrieve mode=single ops_per_sec=%.0f\n",
+		   num_keys / retrieve_single);
+	printf("op=retrieve mode=batch batch=%zu ops_per_sec=%.0f\n", batch_size,
+		   num_keys / retrieve_batch);
+
+	free_load_balancer(single);
+	free_load_balancer(batched);
+	free(storage);
+	free(keys);
+	free(values);
+	free(lookups);
+	free(found);
+	free(batch_found);
+	free(ids);
+	free(batch_ids);
+	return 0;
+}
@@ -0,0 +1,86 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "keys.h"
+#include "utils.h"
+
+/**
+ * Compara functiile de hash ale cheilor (`djb2`, `fast`) si comparatia cheilor
+ * (`memcmp`, `keys_equal`) pe chei de diferite lungimi.
+ *
+ * Utilizare: key_ops [numar_operatii]
+ */
+
+#define DEFAULT_OPS 2000000
+/** Cate chei diferite se folosesc, ca sa incapa in cache */
+#define KEY_NUM 256
+
+static const size_t key_lengths[] = {8, 16, 32, 64, 256, 1024};
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *methods[] = {"djb2", "fast", "memcmp", "keys_equal"};
+	size_t num_ops = DEFAULT_OPS;
+
+	if (argc > 1)
+		num_ops = strtoul(argv[1], NULL, 10);
+
+	for (size_t l = 0; l < sizeof(key_lengths) / sizeof(*key_lengths); ++l) {
+		size_t len = key_lengths[l];
+		char *keys = malloc(KEY_NUM * (len + 1));
+		char *copies = malloc(KEY_NUM * (len + 1));
+		DIE(!keys || !copies, "failed malloc() of keys");
+
+		for (size_t i = 0; i < KEY_NUM * (len + 1); ++i)
+			keys[i] = 'a' + rand() % 26;
+		for (size_t i = 0; i < KEY_NUM; ++i)
+			keys[i * (len + 1) + len] = '\0';
+		memcpy(copies, keys, KEY_NUM * (len + 1));
+
+		for (int m = 0; m < 4; ++m) {
+			/* Rezultatele sunt acumulate ca sa nu fie eliminate apelurile. */
+			unsigned long checksum = 0;
+			struct timespec start, end;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (size_t i = 0; i < num_ops; ++i) {
+				char *key = keys + (i % KEY_NUM) * (len + 1);
+				char *copy = copies + (i % KEY_NUM) * (len + 1);
+
+				switch (m) {
+				case 0:
+					checksum += key_hash(KEY_HASH_DJB2, key);
+					break;
+				case 1:
+					checksum += key_hash(KEY_HASH_FAST, key);
+					break;
+				case 2:
+					checksum += memcmp(key, copy, len + 1) == 0;
+					break;
+				default:
+					checksum += keys_equal(key, copy, len + 1);
+				}
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			printf("key_length=%zu method=%s ns_per_op=%.2f checksum=%lu\n",
+				   len, methods[m], elapsed(&start, &end) * 1e9 / num_ops,
+				   checksum);
+		}
+
+		free(keys);
+		free(copies);
+	}
+
+	return 0;
+}
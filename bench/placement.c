@@ -0,0 +1,162 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "load_balancer.h"
+#include "utils.h"
+
+/**
+ * Compara strategiile de repartizare (hashring, jump, Maglev, rendezvous):
+ * durata unei cautari, memoria folosita pentru a gasi serverul unei chei,
+ * echilibrul (cel mai incarcat server, fata de medie) si fractiunea de chei
+ * mutate la adaugarea, respectiv stergerea unui server (ideal,
+ * `1 / (numar_servere + 1)`). Se numara si cheile care nu mai sunt gasite dupa
+ * schimbari; daca exista, programul se termina cu eroare.
+ *
+ * Utilizare: placement [numar_chei] [numar_servere]
+ */
+
+#define DEFAULT_KEYS 200000
+#define DEFAULT_SERVERS 64
+#define KEY_LENGTH 32
+
+static const char *names[] = {"ring", "jump", "maglev", "rendezvous"};
+static const placement_strategy strategies[] = {
+	PLACEMENT_RING, PLACEMENT_JUMP, PLACEMENT_MAGLEV, PLACEMENT_RENDEZVOUS};
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Cauta din nou toate cheile si numara cate si-au schimbat serverul, respectiv
+ * cate nu mai sunt gasite.
+ */
+static size_t count_moved(load_balancer *lb, char **keys, char **values,
+						  int *ids, size_t num_keys, size_t *lost)
+{
+	size_t moved = 0;
+
+	for (size_t i = 0; i < num_keys; ++i) {
+		int id;
+		char *value = loader_retrieve(lb, keys[i], &id);
+
+		if (!value || strcmp(value, values[i])) {
+			++*lost;
+			continue;
+		}
+		moved += id != ids[i];
+		ids[i] = id;
+	}
+
+	return moved;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_keys = DEFAULT_KEYS;
+	int num_servers = DEFAULT_SERVERS;
+
+	if (argc > 1)
+		num_keys = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		num_servers = atoi(argv[2]);
+	DIE(num_servers < 2, "at least 2 servers are needed");
+
+	char *storage = malloc(2 * num_keys * KEY_LENGTH);
+	char **keys = malloc(num_keys * sizeof(char *));
+	char **values = malloc(num_keys * sizeof(char *));
+	char **lookups = malloc(num_keys * sizeof(char *));
+	int *ids = malloc(num_keys * sizeof(int));
+	size_t *loads = calloc(num_servers + 1, sizeof(size_t));
+	DIE(!storage || !keys || !values || !lookups || !ids || !loads,
+		"failed malloc() of keys");
+
+	unsigned int seed = 0x2023;
+	for (size_t i = 0; i < num_keys; ++i) {
+		keys[i] = storage + 2 * i * KEY_LENGTH;
+		values[i] = keys[i] + KEY_LENGTH;
+		snprintf(keys[i], KEY_LENGTH, "key_%u_%zu", next_random(&seed), i);
+		snprintf(values[i], KEY_LENGTH, "value_%u", next_random(&seed));
+	}
+	/* Cautarile sunt in ordine aleatoare, ca sa nu profite de cache. */
+	for (size_t i = 0; i < num_keys; ++i)
+		lookups[i] = keys[next_random(&seed) % num_keys];
+
+	for (size_t s = 0; s < sizeof(strategies) / sizeof(*strategies); ++s) {
+		load_balancer *lb = init_load_balancer();
+		loader_set_placement(lb, strategies[s]);
+		for (int i = 0; i < num_servers; ++i)
+			loader_add_server(lb, i, 1);
+
+		memset(loads, 0, (num_servers + 1) * sizeof(size_t));
+		for (size_t i = 0; i < num_keys; ++i) {
+			loader_store(lb, keys[i], values[i], &ids[i]);
+			++loads[ids[i]];
+		}
+
+		size_t max_load = 0;
+		for (int i = 0; i < num_servers; ++i)
+			max_load = loads[i] > max_load ? loads[i] : max_load;
+
+		struct timespec start, end;
+		unsigned long checksum = 0;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t i = 0; i < num_keys; ++i) {
+			int id;
+			checksum += loader_retrieve(lb, lookups[i], &id) != NULL;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double lookup = elapsed(&start, &end);
+		DIE(checksum != num_keys, "missing keys");
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		loader_add_server(lb, num_servers, 1);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double add = elapsed(&start, &end);
+		size_t lost = 0;
+		size_t add_moved = count_moved(lb, keys, values, ids, num_keys, &lost);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		loader_remove_server(lb, 0);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double remove = elapsed(&start, &end);
+		size_t remove_moved =
+			count_moved(lb, keys, values, ids, num_keys, &lost);
+
+		printf("strategy=%s servers=%d keys=%zu lookup_ns=%.2f "
+			   "memory_bytes=%zu max_load_ratio=%.3f add_moved=%.4f "
+			   "remove_moved=%.4f ideal_moved=%.4f add_ms=%.3f "
+			   "remove_ms=%.3f lost_keys=%zu\n",
+			   names[s], num_servers, num_keys, lookup * 1e9 / num_keys,
+			   loader_placement_memory(lb),
+			   (double)max_load * num_servers / num_keys,
+			   (double)add_moved / num_keys, (double)remove_moved / num_keys,
+			   1.0 / (num_servers + 1), add * 1e3, remove * 1e3, lost);
+
+		free_load_balancer(lb);
+		if (lost)
+			return 1;
+	}
+
+	free(storage);
+	free(keys);
+	free(values);
+	free(lookups);
+	free(ids);
+	free(loads);
+	return 0;
+}
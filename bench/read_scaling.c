@@ -0,0 +1,340 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "load_balancer.h"
+#include "utils.h"
+
+/**
+ * Masoara cum creste numarul de cautari pe secunda odata cu numarul de
+ * threaduri care apeleaza `loader_retrieve`, in timp ce un scriitor stocheaza
+ * chei noi si adauga/sterge periodic un server.
+ *
+ * Cu un numar nenul de stocatori, load balancerul foloseste
+ * `loader_enable_locking`, iar la fiecare rulare stocatorii scriu in paralel
+ * propriile chei si le cauta inapoi. La sfarsitul rularii, toate cheile
+ * stocate trebuie gasite, cu valorile lor, desi hashringul s-a schimbat intre
+ * timp.
+ *
+ * Utilizare: read_scaling [numar_maxim_threaduri] [secunde_per_rulare]
+ *                         [chained|flat] [numar_stocatori]
+ */
+
+#define SERVER_NUM 64
+#define KEY_NUM 100000
+#define KEY_LENGTH 32
+/** Pauza dintre 2 stocari ale scriitorului */
+#define WRITE_INTERVAL_NS 20000
+/** Dupa cate stocari scriitorul schimba hashringul */
+#define RING_CHANGE_INTERVAL 1000
+/** Cate cautari face un cititor intre 2 verificari ale opririi */
+#define READ_BATCH 256
+/** Cate chei diferite scrie un stocator la o rulare; apoi le suprascrie */
+#define STORER_KEYS 20000
+#define STORER_KEY_LENGTH 64
+
+static char keys[KEY_NUM][KEY_LENGTH];
+static char values[KEY_NUM][KEY_LENGTH];
+
+typedef struct {
+	load_balancer *lb;
+	int *stop;
+	unsigned int seed;
+	unsigned long ops;
+	unsigned long errors;
+} reader_args;
+
+typedef struct {
+	load_balancer *lb;
+	int *stop;
+	unsigned long stored;
+	unsigned long ring_changes;
+} writer_args;
+
+typedef struct {
+	load_balancer *lb;
+	int *stop;
+	/** numarul de cititori al rularii si numarul stocatorului, care fac
+	 * cheile unice */
+	int run;
+	int index;
+	unsigned int seed;
+	unsigned long ops;
+	unsigned long errors;
+} storer_args;
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void *reader_thread(void *arg)
+{
+	reader_args *args = arg;
+	epoch_reader *reader = loader_register_reader(args->lb);
+
+	while (!__atomic_load_n(args->stop, __ATOMIC_RELAXED)) {
+		for (int i = 0; i < READ_BATCH; ++i) {
+			unsigned int k = next_random(&args->seed) % KEY_NUM;
+			int server_id;
+
+			loader_read_begin(args->lb, reader);
+			char *value = loader_retrieve(args->lb, keys[k], &server_id);
+			if (!value || strcmp(value, values[k]))
+				++args->errors;
+			loader_read_end(reader);
+		}
+		args->ops += READ_BATCH;
+	}
+
+	loader_unregister_reader(reader);
+	return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+	writer_args *args = arg;
+	epoch_reader *reader = loader_register_reader(args->lb);
+	struct timespec pause = {0, WRITE_INTERVAL_NS};
+	char key[KEY_LENGTH];
+	int extra_server = -1;
+
+	while (!__atomic_load_n(args->stop, __ATOMIC_RELAXED)) {
+		int server_id;
+		snprintf(key, sizeof(key), "extra_%lu", args->stored);
+		loader_read_begin(args->lb, reader);
+		loader_store(args->lb, key, key, &server_id);
+		loader_read_end(reader);
+
+		if (++args->stored % RING_CHANGE_INTERVAL == 0) {
+			if (extra_server < 0) {
+				extra_server = SERVER_NUM + args->ring_changes;
+				loader_add_server(args->lb, extra_server, 1);
+			} else {
+				loader_remove_server(args->lb, extra_server);
+				extra_server = -1;
+			}
+			++args->ring_changes;
+		}
+
+		nanosleep(&pause, NULL);
+	}
+
+	if (extra_server >= 0)
+		loader_remove_server(args->lb, extra_server);
+	loader_unregister_reader(reader);
+	return NULL;
+}
+
+/** Cheia si valoarea cu numarul `index` ale unui stocator. */
+static void storer_item(storer_args *args, unsigned long index, char *key,
+						char *value)
+{
+	snprintf(key, STORER_KEY_LENGTH, "s%d_%d_%lu", args->run, args->index,
+			 index);
+	snprintf(value, STORER_KEY_LENGTH, "v%d_%d_%lu", args->run, args->index,
+			 index);
+}
+
+/**
+ * Stocheaza pe rand cheile stocatorului (suprascriindu-le dupa primele
+ * `STORER_KEYS`) si, dupa fiecare stocare, cauta o cheie deja stocata.
+ */
+static void *storer_thread(void *arg)
+{
+	storer_args *args = arg;
+	epoch_reader *reader = loader_register_reader(args->lb);
+	char key[STORER_KEY_LENGTH], value[STORER_KEY_LENGTH];
+
+	while (!__atomic_load_n(args->stop, __ATOMIC_RELAXED)) {
+		int server_id;
+
+		storer_item(args, args->ops % STORER_KEYS, key, value);
+		loader_read_begin(args->lb, reader);
+		loader_store(args->lb, key, value, &server_id);
+		loader_read_end(reader);
+		++args->ops;
+
+		unsigned long stored =
+			args->ops < STORER_KEYS ? args->ops : STORER_KEYS;
+		storer_item(args, next_random(&args->seed) % stored, key, value);
+		loader_read_begin(args->lb, reader);
+		char *found = loader_retrieve(args->lb, key, &server_id);
+		if (!found || strcmp(found, value))
+			++args->errors;
+		loader_read_end(reader);
+	}
+
+	loader_unregister_reader(reader);
+	return NULL;
+}
+
+/** Numara cheile stocate de un stocator care nu mai sunt gasite. */
+static unsigned long count_lost(load_balancer *lb, storer_args *args)
+{
+	unsigned long stored = args->ops < STORER_KEYS ? args->ops : STORER_KEYS;
+	unsigned long lost = 0;
+	char key[STORER_KEY_LENGTH], value[STORER_KEY_LENGTH];
+
+	for (unsigned long i = 0; i < stored; ++i) {
+		int server_id;
+		storer_item(args, i, key, value);
+		char *found = loader_retrieve(lb, key, &server_id);
+		lost += !found || strcmp(found, value);
+	}
+
+	return lost;
+}
+
+/**
+ * Ruleaza cititorii, scriitorul si stocatorii; intoarce numarul de cautari pe
+ * secunda. Adauga la `errors` valorile gresite gasite, la `lost` cheile
+ * stocatorilor negasite la sfarsit, iar in `writes` pune numarul de stocari
+ * pe secunda ale stocatorilor.
+ */
+static double run(load_balancer *lb, int num_threads, int num_storers,
+				  double seconds, unsigned long *errors, unsigned long *lost,
+				  double *writes)
+{
+	pthread_t writer;
+	pthread_t *readers =
+		malloc((num_threads + num_storers) * sizeof(pthread_t));
+	pthread_t *storers = readers + num_threads;
+	reader_args *args = calloc(num_threads, sizeof(reader_args));
+	storer_args *storer = calloc(num_storers, sizeof(storer_args));
+	DIE(!readers || !args || (num_storers && !storer),
+		"failed malloc() of reader threads");
+
+	int stop = 0;
+	writer_args writer_arg = {.lb = lb, .stop = &stop};
+
+	struct timespec start, end;
+	struct timespec duration = {(time_t)seconds,
+								(long)((seconds - (time_t)seconds) * 1e9)};
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < num_threads; ++i) {
+		args[i].lb = lb;
+		args[i].stop = &stop;
+		args[i].seed = 2463534242u + i * 7919;
+		pthread_create(&readers[i], NULL, reader_thread, &args[i]);
+	}
+	for (int i = 0; i < num_storers; ++i) {
+		storer[i].lb = lb;
+		storer[i].stop = &stop;
+		storer[i].seed = 88675123u + i * 7919;
+		storer[i].run = num_threads;
+		storer[i].index = i;
+		pthread_create(&storers[i], NULL, storer_thread, &storer[i]);
+	}
+	pthread_create(&writer, NULL, writer_thread, &writer_arg);
+
+	nanosleep(&duration, NULL);
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+	unsigned long ops = 0, stores = 0;
+	for (int i = 0; i < num_threads; ++i) {
+		pthread_join(readers[i], NULL);
+		ops += args[i].ops;
+		*errors += args[i].errors;
+	}
+	for (int i = 0; i < num_storers; ++i) {
+		pthread_join(storers[i], NULL);
+		stores += storer[i].ops;
+		*errors += storer[i].errors;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_join(writer, NULL);
+
+	/* Toate threadurile s-au oprit, deci cheile se pot cauta direct. */
+	for (int i = 0; i < num_storers; ++i)
+		*lost += count_lost(lb, &storer[i]);
+
+	double duration_s = elapsed(&start, &end);
+	*writes = stores / duration_s;
+
+	free(readers);
+	free(args);
+	free(storer);
+	return ops / duration_s;
+}
+
+int main(int argc, char *argv[])
+{
+	int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int num_storers = 0;
+	double seconds = 1;
+
+	if (argc > 1)
+		max_threads = atoi(argv[1]);
+	if (argc > 2)
+		seconds = atof(argv[2]);
+	if (argc > 4)
+		num_storers = atoi(argv[4]);
+	if (max_threads < 1)
+		max_threads = 1;
+	if (num_storers < 0)
+		num_storers = 0;
+
+	load_balancer *lb = init_load_balancer();
+	if (argc > 3 && !strcmp(argv[3], "flat"))
+		loader_set_storage_engine(lb, HT_ENGINE_FLAT);
+	if (num_storers)
+		loader_enable_locking(lb);
+	else
+		loader_enable_concurrent_reads(lb);
+	for (int i = 0; i < SERVER_NUM; ++i)
+		loader_add_server(lb, i, 1);
+
+	for (int i = 0; i < KEY_NUM; ++i) {
+		int server_id;
+		snprintf(keys[i], KEY_LENGTH, "key_%d", i);
+		snprintf(values[i], KEY_LENGTH, "value_%d", i);
+		loader_store(lb, keys[i], values[i], &server_id);
+	}
+
+	unsigned long errors = 0, lost = 0;
+	double base = 0;
+	for (int threads = 1;; threads *= 2) {
+		if (threads > max_threads)
+			threads = max_threads;
+
+		double writes;
+		double throughput =
+			run(lb, threads, num_storers, seconds, &errors, &lost, &writes);
+		if (threads == 1)
+			base = throughput;
+
+		printf("threads=%d reads_per_sec=%.0f speedup=%.2f", threads,
+			   throughput, throughput / base);
+		if (num_storers)
+			printf(" storers=%d writes_per_sec=%.0f", num_storers, writes);
+		printf("\n");
+
+		if (threads == max_threads)
+			break;
+	}
+
+	free_load_balancer(lb);
+
+	if (errors || lost) {
+		fprintf(stderr, "%lu wrong values retrieved, %lu stored keys lost\n",
+				errors, lost);
+		return 1;
+	}
+	return 0;
+}
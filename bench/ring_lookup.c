@@ -0,0 +1,173 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hashring.h"
+#include "utils.h"
+
+/**
+ * Compara cautarea serverului caruia ii revine un hash pe hashringuri cu 10,
+ * 1000 si 100000 de servere:
+ *  - `rehash`: cautarea binara initiala, care recalcula hashul labelului la
+ *    fiecare pas;
+ *  - `binary`: `find_server`, cu hashurile retinute in hashring;
+ *  - `eytzinger`: `hashring_lookup_find`;
+ *  - `jump`: `hashring_jump_find`.
+ *
+ * Utilizare: ring_lookup [numar_cautari]
+ */
+
+#define DEFAULT_LOOKUPS 4000000
+/** Labelurile sunt generate ca in load balancer */
+#define REPLICA_NUM 3
+#define REPLICA_OFFSET 100000
+
+static const size_t server_counts[] = {10, 1000, 100000};
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Cautarea binara de dinaintea indexului, care recalcula hashurile. */
+static hashring_entry *find_server_rehash(hashring_entry *hashring,
+										  size_t hashring_size,
+										  unsigned int target_hash)
+{
+	size_t left = 0, right = hashring_size - 1;
+
+	while (left <= right && right < hashring_size) {
+		size_t index = (left + right) / 2;
+		unsigned int hash = hash_function_servers(&hashring[index].label);
+
+		if (hash == target_hash)
+			return &hashring[index];
+
+		if (hash > target_hash) {
+			if (index == 0)
+				return &hashring[0];
+
+			unsigned int previous_hash =
+				hash_function_servers(&hashring[index - 1].label);
+			if (previous_hash < target_hash)
+				return &hashring[index];
+			right = index - 1;
+		} else {
+			left = index + 1;
+		}
+	}
+
+	return &hashring[0];
+}
+
+/** Intoarce numarul de nanosecunde per cautare. */
+static double run(int method, hashring_entry *hashring, size_t size,
+				  hashring_lookup *lookup, hashring_jump *jump,
+				  unsigned int *targets,
+				  size_t num_lookups, size_t *positions)
+{
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_lookups; ++i) {
+		unsigned int hash = targets[i];
+
+		switch (method) {
+		case 0:
+			positions[i] = find_server_rehash(hashring, size, hash) - hashring;
+			break;
+		case 1:
+			positions[i] = find_server(hashring, size, hash, true) - hashring;
+			break;
+		case 2:
+			positions[i] = hashring_lookup_find(lookup, hash);
+			break;
+		default:
+			positions[i] = hashring_jump_find(jump, hashring, size, hash);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return elapsed(&start, &end) * 1e9 / num_lookups;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *methods[] = {"rehash", "binary", "eytzinger", "jump"};
+	size_t num_lookups = DEFAULT_LOOKUPS;
+	unsigned int seed = 0x2023;
+
+	if (argc > 1)
+		num_lookups = strtoul(argv[1], NULL, 10);
+
+	unsigned int *targets = malloc(num_lookups * sizeof(unsigned int));
+	size_t *expected = malloc(num_lookups * sizeof(size_t));
+	size_t *positions = malloc(num_lookups * sizeof(size_t));
+	DIE(!targets || !expected || !positions, "failed malloc() of lookups");
+
+	for (size_t i = 0; i < num_lookups; ++i)
+		targets[i] = next_random(&seed);
+
+	for (size_t c = 0; c < sizeof(server_counts) / sizeof(*server_counts);
+		 ++c) {
+		size_t servers = server_counts[c];
+		size_t size = servers * REPLICA_NUM;
+		hashring_entry *hashring = malloc(size * sizeof(hashring_entry));
+		DIE(!hashring, "failed malloc() of hashring");
+
+		for (size_t i = 0; i < servers; ++i) {
+			for (int j = 0; j < REPLICA_NUM; ++j) {
+				unsigned int label = j * REPLICA_OFFSET + i;
+
+				hashring[i * REPLICA_NUM + j] = (hashring_entry){
+					.id = i,
+					.hash = hash_function_servers(&label),
+					.label = label,
+				};
+			}
+		}
+		qsort(hashring, size, sizeof(hashring_entry), compare_servers);
+
+		hashring_lookup lookup = {0};
+		hashring_lookup_build(&lookup, hashring, size);
+		hashring_jump jump = {0};
+		hashring_jump_build(&jump, hashring, size);
+
+		for (size_t m = 0; m < sizeof(methods) / sizeof(*methods); ++m) {
+			double ns = run(m, hashring, size, &lookup, &jump, targets,
+							num_lookups, m ? positions : expected);
+
+			/* Toate metodele trebuie sa gaseasca aceleasi labeluri. */
+			if (m && memcmp(positions, expected,
+							num_lookups * sizeof(size_t))) {
+				fprintf(stderr, "%s: wrong results for %zu servers\n",
+						methods[m], servers);
+				return 1;
+			}
+
+			printf("servers=%zu method=%s ns_per_lookup=%.2f\n", servers,
+				   methods[m], ns);
+		}
+
+		hashring_lookup_destroy(&lookup);
+		hashring_jump_destroy(&jump);
+		free(hashring);
+	}
+
+	free(targets);
+	free(expected);
+	free(positions);
+	return 0;
+}
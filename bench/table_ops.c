@@ -0,0 +1,199 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "hashtable.h"
+#include "keys.h"
+#include "utils.h"
+
+/**
+ * Masoara operatiile unui singur hashtable, fara load balancer, pentru
+ * ambele moduri de organizare: stocarea cheilor (`ht_store_item`), cautarea
+ * cheilor existente si a celor inexistente (`ht_retrieve_item`), mutarea
+ * obiectelor in alt hashtable si inapoi, pe rand pentru fiecare dintre cele
+ * `TRANSFER_SLICES` intervale egale de hashuri, ca la adaugarea unui server
+ * (`ht_transfer_items`), apoi stergerea cheilor (`ht_remove_item`). Dupa
+ * transferuri, toate cheile trebuie gasite, cu valorile lor.
+ *
+ * Utilizare: table_ops [numar_chei] [numar_cautari]
+ */
+
+#define DEFAULT_KEYS 200000
+#define DEFAULT_LOOKUPS 2000000
+#define KEY_LENGTH 32
+#define VALUE_SIZE 64
+/** In cate intervale este impartit spatiul hashurilor la transferuri */
+#define TRANSFER_SLICES 64
+
+/** Parametrii bazelor de date ale serverelor */
+#define BUCKET_NO 421
+#define LOAD_FACTOR 1.0
+#define FLAT_LOAD_FACTOR 0.8
+
+static const char *names[] = {"chained", "flat"};
+static const ht_engine engines[] = {HT_ENGINE_CHAINED, HT_ENGINE_FLAT};
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Memoria maxima folosita de proces, in KiB. */
+static long max_rss_kb(void)
+{
+	struct rusage usage;
+
+	DIE(getrusage(RUSAGE_SELF, &usage), "failed getrusage()");
+	return usage.ru_maxrss;
+}
+
+static void print_result(const char *engine, const char *op, size_t keys,
+						 size_t ops, double seconds)
+{
+	printf("engine=%s op=%s keys=%zu ops=%zu ns_per_op=%.1f ops_per_s=%.0f\n",
+		   engine, op, keys, ops, seconds * 1e9 / ops, ops / seconds);
+}
+
+/**
+ * Cauta `count` chei aleatoare dintre cele date si intoarce numarul celor
+ * gasite.
+ */
+static size_t retrieve_keys(hashtable *ht, char **keys, unsigned int *sizes,
+							unsigned int *hashes, size_t num_keys,
+							size_t count, unsigned int *seed)
+{
+	size_t found = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t key = next_random(seed) % num_keys;
+		found += !!ht_retrieve_item(ht, keys[key], sizes[key], hashes[key]);
+	}
+
+	return found;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_keys = DEFAULT_KEYS;
+	size_t num_lookups = DEFAULT_LOOKUPS;
+
+	if (argc > 1)
+		num_keys = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		num_lookups = strtoul(argv[2], NULL, 10);
+	DIE(!num_keys || !num_lookups, "at least one key and lookup are needed");
+
+	/* Prima jumatate sunt cheile stocate, a doua cheile cautate fara sa
+	 * existe. */
+	char *storage = malloc(2 * num_keys * KEY_LENGTH);
+	char **keys = malloc(2 * num_keys * sizeof(char *));
+	unsigned int *sizes = malloc(2 * num_keys * sizeof(unsigned int));
+	unsigned int *hashes = malloc(2 * num_keys * sizeof(unsigned int));
+	DIE(!storage || !keys || !sizes || !hashes, "failed malloc() of keys");
+
+	unsigned int seed = 0x2023;
+	for (size_t i = 0; i < 2 * num_keys; ++i) {
+		keys[i] = storage + i * KEY_LENGTH;
+		snprintf(keys[i], KEY_LENGTH, "%s_%u_%zu",
+				 i < num_keys ? "key" : "miss", next_random(&seed), i);
+		sizes[i] = strlen(keys[i]) + 1;
+		hashes[i] = key_hash_bytes(keys[i], sizes[i] - 1);
+	}
+
+	char value[VALUE_SIZE];
+	memset(value, 'v', sizeof(value));
+
+	for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e) {
+		double load_factor =
+			engines[e] == HT_ENGINE_FLAT ? FLAT_LOAD_FACTOR : LOAD_FACTOR;
+		hashtable *ht = ht_create(engines[e], BUCKET_NO, load_factor);
+		hashtable *other = ht_create(engines[e], BUCKET_NO, load_factor);
+		struct timespec start, end;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t i = 0; i < num_keys; ++i)
+			ht_store_item(ht, keys[i], sizes[i], hashes[i], value,
+						  sizeof(value));
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		print_result(names[e], "store", num_keys, num_keys,
+					 elapsed(&start, &end));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		size_t hits = retrieve_keys(ht, keys, sizes, hashes, num_keys,
+									num_lookups, &seed);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		print_result(names[e], "retrieve_hit", num_keys, num_lookups,
+					 elapsed(&start, &end));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		size_t false_hits =
+			retrieve_keys(ht, keys + num_keys, sizes + num_keys,
+						  hashes + num_keys, num_keys, num_lookups, &seed);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		print_result(names[e], "retrieve_miss", num_keys, num_lookups,
+					 elapsed(&start, &end));
+
+		/* Fiecare interval este mutat si adus inapoi; ultimul interval se
+		 * termina la `UINT_MAX`, deci contine si cheile cu acest hash. */
+		unsigned int slice = UINT_MAX / TRANSFER_SLICES + 1;
+		size_t moved = 0;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (unsigned int s = 0; s < TRANSFER_SLICES; ++s) {
+			unsigned int min_hash = s * slice;
+			unsigned int max_hash =
+				s + 1 < TRANSFER_SLICES ? min_hash + slice : UINT_MAX;
+
+			moved += ht_transfer_items(other, ht, min_hash, max_hash);
+			moved += ht_transfer_items(ht, other, min_hash, max_hash);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double transfer = elapsed(&start, &end);
+		printf("engine=%s op=transfer keys=%zu calls=%d moved=%zu "
+			   "ns_per_call=%.1f ns_per_key=%.1f\n",
+			   names[e], num_keys, 2 * TRANSFER_SLICES, moved,
+			   transfer * 1e9 / (2 * TRANSFER_SLICES),
+			   moved ? transfer * 1e9 / moved : 0.0);
+
+		size_t errors = (hits != num_lookups) + (false_hits != 0) +
+						(ht_size(ht) != num_keys) + (ht_size(other) != 0);
+		for (size_t i = 0; i < num_keys; ++i) {
+			char *found = ht_retrieve_item(ht, keys[i], sizes[i], hashes[i]);
+			errors += !found || dict_data_size(found) != sizeof(value) ||
+					  memcmp(found, value, sizeof(value));
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (size_t i = 0; i < num_keys; ++i)
+			errors += !ht_remove_item(ht, keys[i], sizes[i], hashes[i]);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		print_result(names[e], "remove", num_keys, num_keys,
+					 elapsed(&start, &end));
+
+		printf("engine=%s max_rss_kb=%ld errors=%zu\n", names[e], max_rss_kb(),
+			   errors);
+		ht_destroy(ht);
+		ht_destroy(other);
+		if (errors)
+			return 1;
+	}
+
+	free(storage);
+	free(keys);
+	free(sizes);
+	free(hashes);
+	return 0;
+}
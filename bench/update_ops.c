@@ -0,0 +1,185 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "load_balancer.h"
+#include "utils.h"
+
+/**
+ * Masoara actualizarile repetate ale acelorasi chei: cu valori de aceeasi
+ * dimensiune (inlocuite pe loc), cu valori de dimensiuni diferite (care pot
+ * necesita un nod nou), stergerea si restocarea cheilor, apoi cautarea
+ * tuturor cheilor. La sfarsit, fiecare cheie trebuie sa aiba ultima valoare
+ * stocata, iar cheile sterse sa lipseasca.
+ *
+ * Utilizare: update_ops [numar_chei] [numar_actualizari] [chained|flat]
+ */
+
+#define SERVER_NUM 64
+#define DEFAULT_KEYS 100000
+#define DEFAULT_UPDATES 1000000
+#define KEY_LENGTH 32
+/** Dimensiunile valorilor sunt intre `MIN_VALUE` si `MAX_VALUE` */
+#define MIN_VALUE 24
+#define MAX_VALUE 256
+/** Dimensiunea valorilor stocate initial */
+#define VALUE_SIZE 64
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Genereaza versiunea `version` a valorii unei chei, de lungimea `len`. */
+static void make_value(char *value, size_t key, unsigned int version,
+					   size_t len)
+{
+	int prefix = snprintf(value, len + 1, "%zu_%u_", key, version);
+
+	memset(value + prefix, 'a' + version % 26, len - prefix);
+	value[len] = '\0';
+}
+
+/**
+ * Actualizeaza `count` chei aleatoare. Cu `same_size`, valorile noi au
+ * lungimea celor vechi.
+ */
+static double update_keys(load_balancer *lb, char **keys,
+						  unsigned int *versions, size_t *lengths,
+						  size_t num_keys, size_t count, bool same_size,
+						  unsigned int *seed)
+{
+	char value[MAX_VALUE + 1];
+	struct timespec start, end;
+	double total = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t key = next_random(seed) % num_keys;
+		if (!same_size)
+			lengths[key] =
+				MIN_VALUE + next_random(seed) % (MAX_VALUE - MIN_VALUE + 1);
+		make_value(value, key, ++versions[key], lengths[key]);
+
+		int id;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		loader_store(lb, keys[key], value, &id);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		total += elapsed(&start, &end);
+	}
+
+	return total;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_keys = DEFAULT_KEYS;
+	size_t num_updates = DEFAULT_UPDATES;
+	ht_engine engine = HT_ENGINE_CHAINED;
+
+	if (argc > 1)
+		num_keys = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		num_updates = strtoul(argv[2], NULL, 10);
+	if (argc > 3 && !strcmp(argv[3], "flat"))
+		engine = HT_ENGINE_FLAT;
+	DIE(!num_keys, "at least one key is needed");
+
+	char *storage = malloc(num_keys * KEY_LENGTH);
+	char **keys = malloc(num_keys * sizeof(char *));
+	unsigned int *versions = calloc(num_keys, sizeof(unsigned int));
+	size_t *lengths = malloc(num_keys * sizeof(size_t));
+	bool *present = malloc(num_keys * sizeof(bool));
+	DIE(!storage || !keys || !versions || !lengths || !present,
+		"failed malloc() of keys");
+
+	load_balancer *lb = init_load_balancer();
+	loader_set_storage_engine(lb, engine);
+	for (int i = 0; i < SERVER_NUM; ++i)
+		loader_add_server(lb, i, 1);
+
+	unsigned int seed = 0x2023;
+	char value[MAX_VALUE + 1];
+	for (size_t i = 0; i < num_keys; ++i) {
+		int id;
+		keys[i] = storage + i * KEY_LENGTH;
+		snprintf(keys[i], KEY_LENGTH, "key_%u_%zu", next_random(&seed), i);
+		lengths[i] = VALUE_SIZE;
+		present[i] = true;
+		make_value(value, i, 0, lengths[i]);
+		loader_store(lb, keys[i], value, &id);
+	}
+
+	double same = update_keys(lb, keys, versions, lengths, num_keys,
+							  num_updates, true, &seed);
+	double mixed = update_keys(lb, keys, versions, lengths, num_keys,
+							   num_updates, false, &seed);
+
+	/* Jumatate dintre chei sunt sterse, apoi jumatate dintre acestea sunt
+	 * stocate din nou. */
+	struct timespec start, end;
+	size_t removed = 0, missing = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; i += 2) {
+		removed += loader_remove(lb, keys[i]);
+		present[i] = false;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double remove = elapsed(&start, &end);
+	for (size_t i = 0; i < num_keys; i += 2)
+		missing += !loader_remove(lb, keys[i]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; i += 4) {
+		int id;
+		make_value(value, i, ++versions[i], lengths[i]);
+		loader_store(lb, keys[i], value, &id);
+		present[i] = true;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double reinsert = elapsed(&start, &end);
+
+	size_t errors = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < num_keys; ++i) {
+		int id;
+		char *found = loader_retrieve(lb, keys[i], &id);
+
+		make_value(value, i, versions[i], lengths[i]);
+		errors += present[i] ? !found || strcmp(found, value) : !!found;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double retrieve = elapsed(&start, &end);
+
+	size_t removes = (num_keys + 1) / 2, reinserts = (num_keys + 3) / 4;
+	printf("op=update_same_size keys=%zu ops=%zu ns_per_op=%.1f\n", num_keys,
+		   num_updates, same * 1e9 / num_updates);
+	printf("op=update_mixed_size keys=%zu ops=%zu ns_per_op=%.1f\n", num_keys,
+		   num_updates, mixed * 1e9 / num_updates);
+	printf("op=remove keys=%zu ops=%zu ns_per_op=%.1f removed=%zu "
+		   "missing_on_second_remove=%zu\n",
+		   num_keys, removes, remove * 1e9 / removes, removed, missing);
+	printf("op=reinsert keys=%zu ops=%zu ns_per_op=%.1f\n", num_keys,
+		   reinserts, reinsert * 1e9 / reinserts);
+	printf("op=retrieve keys=%zu ops=%zu ns_per_op=%.1f errors=%zu\n",
+		   num_keys, num_keys, retrieve * 1e9 / num_keys, errors);
+
+	free_load_balancer(lb);
+	free(storage);
+	free(keys);
+	free(versions);
+	free(lengths);
+	free(present);
+	return errors != 0;
+}
@@ -0,0 +1,417 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "load_balancer.h"
+#include "utils.h"
+
+/**
+ * Genereaza o incarcare sintetica: cheile sunt alese uniform sau dupa o
+ * distributie Zipf, valorile au dimensiuni aleatoare intre doua limite, iar
+ * cererile sunt cautari sau stocari in proportia data, intercalate cu
+ * adaugari si stergeri de servere. Intai sunt stocate toate cheile, apoi se
+ * executa cererile.
+ *
+ * Implicit, cererile sunt executate direct pe load balancer si se scriu, pe
+ * tipuri de operatii, durata medie si numarul de operatii pe secunda, plus
+ * memoria maxima a procesului. Cu `file=...`, aceleasi cereri sunt scrise
+ * intr-un fisier de intrare pentru `tema2`. Cautarile trebuie sa gaseasca
+ * mereu ultima valoare stocata la cheie.
+ *
+ * Utilizare: workload [parametru=valoare]..., cu parametrii:
+ *  - `keys`: numarul de chei;
+ *  - `ops`: numarul de cereri de dupa stocarea cheilor;
+ *  - `zipf`: exponentul distributiei cheilor (0 pentru distributie uniforma);
+ *  - `reads`: fractiunea de cautari dintre cereri (restul sunt stocari);
+ *  - `churn`: probabilitatea ca o cerere sa fie o adaugare/stergere de server;
+ *  - `value_min`, `value_max`: limitele dimensiunilor valorilor;
+ *  - `servers`: numarul initial de servere;
+ *  - `seed`: samanta generatorului;
+ *  - `engine`: `chained` sau `flat`;
+ *  - `file`: fisierul in care se scriu cererile, in loc sa fie executate.
+ */
+
+#define KEY_LENGTH 32
+
+/**
+ * @brief Parametrii incarcarii.
+ */
+typedef struct {
+	size_t keys;
+	size_t ops;
+	double zipf;
+	double reads;
+	double churn;
+	size_t value_min;
+	size_t value_max;
+	int servers;
+	unsigned int seed;
+	ht_engine engine;
+	const char *file;
+} workload_params;
+
+/**
+ * @brief Durata si numarul operatiilor de un anumit tip.
+ */
+typedef struct {
+	const char *name;
+	size_t ops;
+	double seconds;
+} op_timing;
+
+enum {
+	OP_LOAD,
+	OP_STORE,
+	OP_RETRIEVE,
+	OP_ADD_SERVER,
+	OP_REMOVE_SERVER,
+	OP_NUM,
+};
+
+/**
+ * @brief Starea unei rulari: cererile sunt trimise fie load balancerului, fie
+ * fisierului.
+ */
+typedef struct {
+	load_balancer *lb;
+	FILE *file;
+	op_timing timings[OP_NUM];
+	/** serverele existente */
+	int *active;
+	int num_active;
+	/** urmatorul id de server nefolosit */
+	int next_id;
+	/** cautarile care nu au gasit valoarea asteptata */
+	size_t errors;
+} workload;
+
+static inline unsigned int next_random(unsigned int *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+/** Intoarce un numar aleator din `[0, 1)`. */
+static inline double next_unit(unsigned int *state)
+{
+	return next_random(state) / 4294967296.0;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		   (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** Memoria maxima folosita de proces, in KiB. */
+static long max_rss_kb(void)
+{
+	struct rusage usage;
+
+	DIE(getrusage(RUSAGE_SELF, &usage), "failed getrusage()");
+	return usage.ru_maxrss;
+}
+
+/**
+ * Calculeaza distributia cumulata a rangurilor cheilor: cheia `i` este aleasa
+ * cu probabilitatea proportionala cu `1 / (i + 1)^zipf`.
+ */
+static double *zipf_cdf(size_t num_keys, double exponent)
+{
+	double *cdf = malloc(num_keys * sizeof(double));
+	DIE(!cdf, "failed malloc() of cdf");
+
+	double sum = 0;
+	for (size_t i = 0; i < num_keys; ++i) {
+		sum += 1 / pow(i + 1, exponent);
+		cdf[i] = sum;
+	}
+	for (size_t i = 0; i < num_keys; ++i)
+		cdf[i] /= sum;
+
+	return cdf;
+}
+
+/** Alege o cheie (uniform daca nu exista distributie). */
+static size_t pick_key(const double *cdf, size_t num_keys, unsigned int *seed)
+{
+	if (!cdf)
+		return next_random(seed) % num_keys;
+
+	double target = next_unit(seed);
+	size_t left = 0, right = num_keys - 1;
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+
+		if (cdf[middle] < target)
+			left = middle + 1;
+		else
+			right = middle;
+	}
+
+	return left;
+}
+
+static void run_store(workload *w, int op, char *key, char *value,
+					  size_t value_size)
+{
+	struct timespec start, end;
+	int id;
+
+	if (w->file) {
+		fprintf(w->file, "store \"%s\" \"%.*s\"\n", key, (int)value_size,
+				value);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	loader_store_value(w->lb, key, value, value_size, &id);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	w->timings[op].seconds += elapsed(&start, &end);
+	++w->timings[op].ops;
+}
+
+static void run_retrieve(workload *w, char *key, size_t value_size)
+{
+	struct timespec start, end;
+	int id;
+
+	if (w->file) {
+		fprintf(w->file, "retrieve \"%s\"\n", key);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	char *found = loader_retrieve(w->lb, key, &id);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	w->timings[OP_RETRIEVE].seconds += elapsed(&start, &end);
+	++w->timings[OP_RETRIEVE].ops;
+
+	w->errors += !found || loader_value_size(found) != value_size;
+}
+
+static void run_add_server(workload *w, int id)
+{
+	struct timespec start, end;
+
+	w->active[w->num_active++] = id;
+	if (w->file) {
+		fprintf(w->file, "add_server %d\n", id);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	loader_add_server(w->lb, id, 1);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	w->timings[OP_ADD_SERVER].seconds += elapsed(&start, &end);
+	++w->timings[OP_ADD_SERVER].ops;
+}
+
+static void run_remove_server(workload *w, int index)
+{
+	struct timespec start, end;
+	int id = w->active[index];
+
+	w->active[index] = w->active[--w->num_active];
+	if (w->file) {
+		fprintf(w->file, "remove_server %d\n", id);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	loader_remove_server(w->lb, id);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	w->timings[OP_REMOVE_SERVER].seconds += elapsed(&start, &end);
+	++w->timings[OP_REMOVE_SERVER].ops;
+}
+
+/**
+ * Adauga sau sterge un server, astfel incat numarul lor sa ramana intre 1 si
+ * dublul celui initial.
+ */
+static void churn_servers(workload *w, const workload_params *params,
+						  unsigned int *seed)
+{
+	bool add = next_random(seed) & 1;
+
+	if (w->num_active <= 1)
+		add = true;
+	else if (w->num_active >= 2 * params->servers)
+		add = false;
+
+	if (add)
+		run_add_server(w, w->next_id++);
+	else
+		run_remove_server(w, next_random(seed) % w->num_active);
+}
+
+static size_t pick_value_size(const workload_params *params,
+							  unsigned int *seed)
+{
+	return params->value_min +
+		   next_random(seed) % (params->value_max - params->value_min + 1);
+}
+
+static void parse_param(workload_params *params, char *arg)
+{
+	char *value = strchr(arg, '=');
+	DIE(!value, "parameters must be given as name=value");
+	*value++ = '\0';
+
+	if (!strcmp(arg, "keys"))
+		params->keys = strtoul(value, NULL, 10);
+	else if (!strcmp(arg, "ops"))
+		params->ops = strtoul(value, NULL, 10);
+	else if (!strcmp(arg, "zipf"))
+		params->zipf = atof(value);
+	else if (!strcmp(arg, "reads"))
+		params->reads = atof(value);
+	else if (!strcmp(arg, "churn"))
+		params->churn = atof(value);
+	else if (!strcmp(arg, "value_min"))
+		params->value_min = strtoul(value, NULL, 10);
+	else if (!strcmp(arg, "value_max"))
+		params->value_max = strtoul(value, NULL, 10);
+	else if (!strcmp(arg, "servers"))
+		params->servers = atoi(value);
+	else if (!strcmp(arg, "seed"))
+		params->seed = strtoul(value, NULL, 10);
+	else if (!strcmp(arg, "engine"))
+		params->engine = strcmp(value, "flat") ? HT_ENGINE_CHAINED
+											   : HT_ENGINE_FLAT;
+	else if (!strcmp(arg, "file"))
+		params->file = value;
+	else
+		DIE(true, "unknown parameter");
+}
+
+int main(int argc, char *argv[])
+{
+	workload_params params = {
+		.keys = 100000,
+		.ops = 1000000,
+		.zipf = 0.99,
+		.reads = 0.9,
+		.churn = 0.0001,
+		.value_min = 16,
+		.value_max = 256,
+		.servers = 64,
+		.seed = 2023,
+		.engine = HT_ENGINE_CHAINED,
+		.file = NULL,
+	};
+
+	for (int i = 1; i < argc; ++i)
+		parse_param(&params, argv[i]);
+	DIE(!params.keys, "at least one key is needed");
+	DIE(params.servers < 1, "at least one server is needed");
+	DIE(params.value_min > params.value_max, "value_min > value_max");
+	DIE(!params.seed, "the seed must not be 0");
+
+	char *storage = malloc(params.keys * KEY_LENGTH);
+	size_t *lengths = malloc(params.keys * sizeof(size_t));
+	char *value = malloc(params.value_max + 1);
+	workload w = {
+		.active = malloc(2 * params.servers * sizeof(int)),
+		.timings = {[OP_LOAD] = {.name = "load"},
+					[OP_STORE] = {.name = "store"},
+					[OP_RETRIEVE] = {.name = "retrieve"},
+					[OP_ADD_SERVER] = {.name = "add_server"},
+					[OP_REMOVE_SERVER] = {.name = "remove_server"}},
+	};
+	DIE(!storage || !lengths || !value || !w.active,
+		"failed malloc() of the workload");
+
+	/* Valorile sunt prefixe ale aceluiasi sir, fara ghilimele, ca sa poata
+	 * fi scrise si in fisierul de intrare. */
+	for (size_t i = 0; i < params.value_max; ++i)
+		value[i] = 'a' + i % 26;
+	value[params.value_max] = '\0';
+
+	double *cdf = params.zipf > 0 ? zipf_cdf(params.keys, params.zipf) : NULL;
+	unsigned int seed = params.seed;
+
+	if (params.file) {
+		w.file = fopen(params.file, "w");
+		DIE(!w.file, "failed fopen() of the output file");
+	} else {
+		w.lb = init_load_balancer();
+		loader_set_storage_engine(w.lb, params.engine);
+	}
+
+	for (int i = 0; i < params.servers; ++i)
+		run_add_server(&w, w.next_id++);
+	for (size_t i = 0; i < params.keys; ++i) {
+		char *key = storage + i * KEY_LENGTH;
+
+		snprintf(key, KEY_LENGTH, "key_%zu", i);
+		lengths[i] = pick_value_size(&params, &seed);
+		run_store(&w, OP_LOAD, key, value, lengths[i]);
+	}
+	/* Serverele initiale nu fac parte din cereri. */
+	w.timings[OP_ADD_SERVER] = (op_timing){.name = "add_server"};
+
+	for (size_t i = 0; i < params.ops; ++i) {
+		if (params.churn > 0 && next_unit(&seed) < params.churn) {
+			churn_servers(&w, &params, &seed);
+			continue;
+		}
+
+		size_t index = pick_key(cdf, params.keys, &seed);
+		char *key = storage + index * KEY_LENGTH;
+		if (next_unit(&seed) < params.reads) {
+			run_retrieve(&w, key, lengths[index]);
+		} else {
+			lengths[index] = pick_value_size(&params, &seed);
+			run_store(&w, OP_STORE, key, value, lengths[index]);
+		}
+	}
+
+	printf("mode=%s keys=%zu ops=%zu zipf=%.2f reads=%.2f churn=%g "
+		   "value_min=%zu value_max=%zu servers=%d engine=%s\n",
+		   params.file ? "file" : "run", params.keys, params.ops, params.zipf,
+		   params.reads, params.churn, params.value_min, params.value_max,
+		   params.servers,
+		   params.engine == HT_ENGINE_FLAT ? "flat" : "chained");
+
+	if (params.file) {
+		DIE(fclose(w.file), "failed fclose() of the output file");
+		printf("file=%s\n", params.file);
+	} else {
+		size_t total_ops = 0;
+		double total_seconds = 0;
+
+		for (int i = 0; i < OP_NUM; ++i) {
+			op_timing *timing = &w.timings[i];
+			if (i != OP_LOAD) {
+				total_ops += timing->ops;
+				total_seconds += timing->seconds;
+			}
+
+			printf("op=%s ops=%zu ns_per_op=%.1f ops_per_s=%.0f\n",
+				   timing->name, timing->ops,
+				   timing->ops ? timing->seconds * 1e9 / timing->ops : 0.0,
+				   timing->seconds > 0 ? timing->ops / timing->seconds : 0.0);
+		}
+		printf("op=total ops=%zu ns_per_op=%.1f ops_per_s=%.0f "
+			   "max_rss_kb=%ld errors=%zu\n",
+			   total_ops, total_ops ? total_seconds * 1e9 / total_ops : 0.0,
+			   total_seconds > 0 ? total_ops / total_seconds : 0.0,
+			   max_rss_kb(), w.errors);
+		free_load_balancer(w.lb);
+	}
+
+	free(cdf);
+	free(storage);
+	free(lengths);
+	free(value);
+	free(w.active);
+	return w.errors != 0;
+}
@@ -0,0 +1,142 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "epoch.h"
+#include "utils.h"
+
+/** Dupa cate obiecte retrase se incearca avansarea epocii */
+#define EPOCH_COLLECT_THRESHOLD 64
+
+/** Elibereaza toate obiectele dintr-o lista. */
+static void epoch_free_list(epoch_retired *retired)
+{
+	while (retired) {
+		epoch_retired *next = retired->next;
+
+		retired->free_func(retired->ptr);
+		free(retired);
+		retired = next;
+	}
+}
+
+epoch *epoch_create(void)
+{
+	epoch *domain = calloc(1, sizeof(epoch));
+	DIE(!domain, "failed malloc() of epoch");
+	DIE(pthread_mutex_init(&domain->lock, NULL),
+		"failed pthread_mutex_init() of epoch.lock");
+
+	return domain;
+}
+
+epoch_reader *epoch_register(epoch *domain)
+{
+	epoch_reader *reader =
+		__atomic_load_n(&domain->readers, __ATOMIC_ACQUIRE);
+
+	/* Se refoloseste o intrare abandonata, daca exista. */
+	for (; reader; reader = reader->next) {
+		int free_entry = 0;
+		if (__atomic_compare_exchange_n(&reader->in_use, &free_entry, 1,
+										false, __ATOMIC_ACQ_REL,
+										__ATOMIC_RELAXED))
+			return reader;
+	}
+
+	reader = calloc(1, sizeof(epoch_reader));
+	DIE(!reader, "failed malloc() of epoch_reader");
+	reader->in_use = 1;
+
+	reader->next = __atomic_load_n(&domain->readers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&domain->readers, &reader->next,
+										reader, true, __ATOMIC_RELEASE,
+										__ATOMIC_RELAXED))
+		;
+
+	return reader;
+}
+
+void epoch_unregister(epoch_reader *reader)
+{
+	__atomic_store_n(&reader->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_enter(epoch *domain, epoch_reader *reader)
+{
+	__atomic_store_n(&reader->active, 1, __ATOMIC_RELAXED);
+	/* Scriitorul trebuie sa vada cititorul activ inainte ca acesta sa
+	 * citeasca vreun pointer din structuri. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	reader->epoch = __atomic_load_n(&domain->global, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_reader *reader)
+{
+	__atomic_store_n(&reader->active, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Avanseaza epoca, daca toti cititorii activi au vazut-o pe cea curenta.
+ * Lockul domeniului trebuie sa fie luat.
+ */
+static void epoch_advance(epoch *domain)
+{
+	unsigned long global = __atomic_load_n(&domain->global, __ATOMIC_RELAXED);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	epoch_reader *reader = __atomic_load_n(&domain->readers, __ATOMIC_ACQUIRE);
+	for (; reader; reader = reader->next) {
+		if (__atomic_load_n(&reader->active, __ATOMIC_ACQUIRE) &&
+			__atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE) != global)
+			return;
+	}
+
+	/* Toti cititorii activi au vazut epoca curenta, deci obiectele retrase
+	 * cu 2 epoci in urma nu mai sunt accesibile. */
+	__atomic_store_n(&domain->global, global + 1, __ATOMIC_RELEASE);
+	epoch_free_list(domain->limbo[(global + 2) % 3]);
+	domain->limbo[(global + 2) % 3] = NULL;
+	domain->pending = 0;
+}
+
+void epoch_retire(epoch *domain, void *ptr, void (*free_func)(void *))
+{
+	epoch_retired *retired = malloc(sizeof(epoch_retired));
+	DIE(!retired, "failed malloc() of epoch_retired");
+	retired->ptr = ptr;
+	retired->free_func = free_func;
+
+	pthread_mutex_lock(&domain->lock);
+	unsigned long global = __atomic_load_n(&domain->global, __ATOMIC_RELAXED);
+	retired->next = domain->limbo[global % 3];
+	domain->limbo[global % 3] = retired;
+
+	if (++domain->pending >= EPOCH_COLLECT_THRESHOLD)
+		epoch_advance(domain);
+	pthread_mutex_unlock(&domain->lock);
+}
+
+void epoch_collect(epoch *domain)
+{
+	pthread_mutex_lock(&domain->lock);
+	epoch_advance(domain);
+	pthread_mutex_unlock(&domain->lock);
+}
+
+void epoch_destroy(epoch *domain)
+{
+	for (int i = 0; i < 3; ++i)
+		epoch_free_list(domain->limbo[i]);
+
+	epoch_reader *reader = domain->readers;
+	while (reader) {
+		epoch_reader *next = reader->next;
+		free(reader);
+		reader = next;
+	}
+
+	pthread_mutex_destroy(&domain->lock);
+	free(domain);
+}
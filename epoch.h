@@ -0,0 +1,128 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef EPOCH_H_
+#define EPOCH_H_
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @class epoch_reader
+ * @brief Starea unui thread care citeste structuri protejate de un `epoch`.
+ */
+typedef struct epoch_reader {
+	/** epoca observata la intrarea in sectiunea critica */
+	unsigned long epoch;
+	/** daca threadul se afla intr-o sectiune critica */
+	int active;
+	/** daca intrarea apartine unui thread */
+	int in_use;
+	/** urmatorul cititor inregistrat */
+	struct epoch_reader *next;
+} epoch_reader;
+
+/**
+ * @class epoch_retired
+ * @brief Un obiect scos din structuri, care asteapta sa fie eliberat.
+ */
+typedef struct epoch_retired {
+	/** obiectul */
+	void *ptr;
+	/** functia care il elibereaza */
+	void (*free_func)(void *ptr);
+	/** urmatorul obiect din aceeasi epoca */
+	struct epoch_retired *next;
+} epoch_retired;
+
+/**
+ * @class epoch
+ * @brief Eliberare amanata a memoriei pe baza de epoci (epoch-based
+ * reclamation).
+ *
+ * Cititorii nu iau niciun lock: isi anunta doar intrarea si iesirea din
+ * sectiunea critica. Obiectele scoase din structuri sunt predate cu
+ * `epoch_retire` si eliberate abia dupa ce toti cititorii care le-ar fi putut
+ * vedea au iesit din sectiunea critica.
+ */
+typedef struct epoch {
+	/** epoca globala */
+	unsigned long global;
+	/** cititorii inregistrati */
+	epoch_reader *readers;
+	/** obiectele retrase in fiecare dintre ultimele 3 epoci */
+	epoch_retired *limbo[3];
+	/** numarul de obiecte retrase de la ultima avansare a epocii */
+	size_t pending;
+	/** protejeaza listele de obiecte retrase si avansarea epocii */
+	pthread_mutex_t lock;
+} epoch;
+
+/**
+ * @relates epoch
+ * @brief Creeaza un domeniu nou.
+ */
+epoch *epoch_create(void);
+
+/**
+ * @relates epoch
+ * @brief Inregistreaza threadul curent ca cititor.
+ *
+ * @param domain domeniul
+ *
+ * @return starea cititorului, folosita la `epoch_enter`/`epoch_exit`
+ */
+epoch_reader *epoch_register(epoch *domain);
+
+/**
+ * @relates epoch
+ * @brief Renunta la o intrare de cititor, care poate fi refolosita.
+ *
+ * @param reader cititorul
+ */
+void epoch_unregister(epoch_reader *reader);
+
+/**
+ * @relates epoch
+ * @brief Intra intr-o sectiune critica. Pana la `epoch_exit`, niciun obiect
+ * accesibil la intrare nu este eliberat.
+ *
+ * @param domain domeniul
+ * @param reader cititorul
+ */
+void epoch_enter(epoch *domain, epoch_reader *reader);
+
+/**
+ * @relates epoch
+ * @brief Iese din sectiunea critica.
+ *
+ * @param reader cititorul
+ */
+void epoch_exit(epoch_reader *reader);
+
+/**
+ * @relates epoch
+ * @brief Preda un obiect, deja scos din structuri, spre eliberare.
+ *
+ * @param domain	domeniul
+ * @param ptr		obiectul
+ * @param free_func	functia care il elibereaza
+ */
+void epoch_retire(epoch *domain, void *ptr, void (*free_func)(void *ptr));
+
+/**
+ * @relates epoch
+ * @brief Incearca sa avanseze epoca si elibereaza obiectele care nu mai pot
+ * fi vazute de niciun cititor.
+ *
+ * @param domain domeniul
+ */
+void epoch_collect(epoch *domain);
+
+/**
+ * @relates epoch
+ * @brief Elibereaza domeniul si toate obiectele retrase. Niciun cititor nu
+ * mai trebuie sa fie activ.
+ *
+ * @param domain domeniul
+ */
+void epoch_destroy(epoch *domain);
+
+#endif /* EPOCH_H_ */
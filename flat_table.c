@@ -0,0 +1,166 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <stdlib.h>
+
+#include "flat_table.h"
+#include "instrument.h"
+#include "utils.h"
+
+/** Numarul minim de pozitii al unei tabele */
+#define MIN_CAPACITY 8
+
+/** Folosit pentru a genera seedul fiecarei tabele */
+#define SEED_INCREMENT 0x9e3779b9u
+
+/**
+ * Calculeaza pozitia ideala a unui hash. Hashurile cheilor sunt amestecate
+ * inainte (finalizerul din MurmurHash3), pentru ca cheile asemanatoare au
+ * hashuri apropiate, iar pozitia este data de bitii cei mai semnificativi.
+ */
+static inline size_t flat_table_home(flat_table *table, unsigned int hash)
+{
+	hash ^= table->seed;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+
+	return hash >> table->shift;
+}
+
+flat_table *flat_table_create(size_t capacity)
+{
+	static unsigned int next_seed;
+
+	flat_table *table = malloc(sizeof(flat_table));
+	DIE(!table, "failed malloc() of flat_table");
+
+	/* Daca 2 tabele ar avea aceeasi ordine a pozitiilor, parcurgerea uneia si
+	 * inserarea elementelor in alta, mai mica, ar crea clustere uriase. */
+	next_seed += SEED_INCREMENT;
+	table->seed = next_seed;
+
+	table->capacity = MIN_CAPACITY;
+	table->shift = 32;
+	while (table->capacity < capacity)
+		table->capacity *= 2;
+	for (size_t i = table->capacity; i > 1; i /= 2)
+		--table->shift;
+
+	table->slots = calloc(table->capacity, sizeof(flat_slot));
+	DIE(!table->slots, "failed malloc() of flat_table.slots");
+
+	return table;
+}
+
+void flat_table_insert(flat_table *table, list *node)
+{
+	size_t mask = table->capacity - 1;
+	size_t index = flat_table_home(table, node->info.hash);
+	flat_slot curr = {
+		.hash = node->info.hash,
+		.distance = 1,
+		.node = node,
+	};
+
+	while (table->slots[index].distance) {
+		/* Elementul mai apropiat de pozitia ideala isi cedeaza locul. */
+		if (table->slots[index].distance < curr.distance) {
+			flat_slot tmp = table->slots[index];
+			table->slots[index] = curr;
+			curr = tmp;
+		}
+
+		index = (index + 1) & mask;
+		++curr.distance;
+	}
+
+	table->slots[index] = curr;
+}
+
+flat_slot *flat_table_find(flat_table *table, unsigned int hash, void *key,
+						   unsigned int key_size)
+{
+	size_t mask = table->capacity - 1;
+	size_t index = flat_table_home(table, hash);
+
+	INSTRUMENT_COUNT(INSTRUMENT_CHAIN_LOOKUPS, 1);
+	for (unsigned int distance = 1;; ++distance) {
+		flat_slot *slot = &table->slots[index];
+
+		INSTRUMENT_COUNT(INSTRUMENT_CHAIN_STEPS, 1);
+		/* Cheia ar fi trebuit sa apara pana acum. */
+		if (slot->distance < distance)
+			return NULL;
+
+		/* Nodul e citit o singura data, pentru ca poate fi mutat de alt
+		 * thread in timpul unei cautari concurente. */
+		list *node = __atomic_load_n(&slot->node, __ATOMIC_RELAXED);
+		if (slot->hash == hash && node &&
+			dict_entry_has_key(&node->info, key, key_size, hash))
+			return slot;
+
+		index = (index + 1) & mask;
+	}
+}
+
+flat_slot *flat_table_find_node(flat_table *table, list *node)
+{
+	size_t mask = table->capacity - 1;
+	size_t index = flat_table_home(table, node->info.hash);
+
+	for (unsigned int distance = 1;; ++distance) {
+		flat_slot *slot = &table->slots[index];
+
+		if (slot->distance < distance)
+			return NULL;
+		if (slot->node == node)
+			return slot;
+
+		index = (index + 1) & mask;
+	}
+}
+
+void flat_table_prefetch_slot(flat_table *table, unsigned int hash)
+{
+	__builtin_prefetch(&table->slots[flat_table_home(table, hash)]);
+}
+
+void flat_table_prefetch_node(flat_table *table, unsigned int hash)
+{
+	flat_slot *slot = &table->slots[flat_table_home(table, hash)];
+
+	if (slot->distance && slot->hash == hash && slot->node)
+		__builtin_prefetch(slot->node);
+}
+
+void flat_table_remove(flat_table *table, flat_slot *slot)
+{
+	size_t mask = table->capacity - 1;
+	size_t index = slot - table->slots;
+
+	for (;;) {
+		size_t next = (index + 1) & mask;
+		if (table->slots[next].distance <= 1)
+			break;
+
+		table->slots[index] = table->slots[next];
+		--table->slots[index].distance;
+		index = next;
+	}
+
+	table->slots[index].distance = 0;
+	table->slots[index].node = NULL;
+}
+
+void flat_table_destroy(flat_table *table)
+{
+	for (size_t i = 0; i < table->capacity; ++i) {
+		list *node = table->slots[i].node;
+		if (node)
+			list_free_node(node);
+	}
+
+	free(table->slots);
+	free(table);
+}
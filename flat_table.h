@@ -0,0 +1,124 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef FLAT_TABLE_H_
+#define FLAT_TABLE_H_
+#include <stddef.h>
+
+#include "list.h"
+
+/**
+ * @class flat_slot
+ * @brief O pozitie dintr-o tabela cu adresare deschisa.
+ */
+typedef struct {
+	/** hashul complet al cheii, comparat inaintea cheii propriu-zise */
+	unsigned int hash;
+	/** distanta fata de pozitia ideala + 1 (0 inseamna pozitie libera) */
+	unsigned int distance;
+	/** nodul care contine perechea (NULL daca elementul a fost mutat in alta
+	 * tabela) */
+	list *node;
+} flat_slot;
+
+/**
+ * @class flat_table
+ * @brief Tabela de dispersie cu adresare deschisa (Robin Hood hashing).
+ *
+ * Hashul fiecarui element este retinut direct in array, deci la o cautare
+ * nodurile sunt accesate doar cand hashurile coincid.
+ */
+typedef struct {
+	/** pozitiile tabelei */
+	flat_slot *slots;
+	/** numarul de pozitii (putere a lui 2) */
+	size_t capacity;
+	/** cu cat se shifteaza hashul ca sa se obtina pozitia ideala */
+	unsigned int shift;
+	/** valoare amestecata in hash, diferita pentru fiecare tabela */
+	unsigned int seed;
+} flat_table;
+
+/**
+ * @relates flat_table
+ * @brief Aloca o tabela goala.
+ *
+ * @param capacity numarul minim de pozitii (se rotunjeste la o putere a lui 2)
+ *
+ * @return tabela alocata
+ */
+flat_table *flat_table_create(size_t capacity);
+
+/**
+ * @relates flat_table
+ * @brief Insereaza un nod. Tabela trebuie sa aiba cel putin o pozitie libera.
+ *
+ * @param table	tabela
+ * @param node	nodul care contine perechea (cheie, valoare)
+ */
+void flat_table_insert(flat_table *table, list *node);
+
+/**
+ * @relates flat_table
+ * @brief Cauta pozitia pe care se afla o cheie.
+ *
+ * @param table		tabela
+ * @param hash		hashul cheii
+ * @param key		cheia cautata
+ * @param key_size	dimensiunea cheii
+ *
+ * @return		pozitia pe care se afla cheia
+ * @retval NULL	cheia nu exista in tabela
+ */
+flat_slot *flat_table_find(flat_table *table, unsigned int hash, void *key,
+						   unsigned int key_size);
+
+/**
+ * @relates flat_table
+ * @brief Cauta pozitia pe care se afla un anumit nod.
+ *
+ * @param table	tabela
+ * @param node	nodul cautat
+ *
+ * @return		pozitia pe care se afla nodul
+ * @retval NULL	nodul nu exista in tabela
+ */
+flat_slot *flat_table_find_node(flat_table *table, list *node);
+
+/**
+ * @relates flat_table
+ * @brief Aduce in cache pozitia ideala a unui hash, inaintea unei cautari.
+ *
+ * @param table	tabela
+ * @param hash	hashul cheii
+ */
+void flat_table_prefetch_slot(flat_table *table, unsigned int hash);
+
+/**
+ * @relates flat_table
+ * @brief Aduce in cache nodul de pe pozitia ideala a unui hash, daca are
+ * acelasi hash. Pozitia ar trebui sa fie deja in cache
+ * (`flat_table_prefetch_slot`).
+ *
+ * @param table	tabela
+ * @param hash	hashul cheii
+ */
+void flat_table_prefetch_node(flat_table *table, unsigned int hash);
+
+/**
+ * @relates flat_table
+ * @brief Elibereaza o pozitie, mutand inapoi elementele care urmeaza dupa ea
+ * (backward shift), ca sa nu ramana goluri in secventele de probing.
+ *
+ * @param table	tabela
+ * @param slot	pozitia eliberata
+ */
+void flat_table_remove(flat_table *table, flat_slot *slot);
+
+/**
+ * @relates flat_table
+ * @brief Elibereaza tabela si nodurile ramase in ea.
+ *
+ * @param table tabela
+ */
+void flat_table_destroy(flat_table *table);
+
+#endif /* FLAT_TABLE_H_ */
@@ -0,0 +1,213 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hash_index.h"
+
+/** Prioritatea unui nod in treap (un amestec al hashului si al adresei). */
+static inline unsigned int hash_index_priority(list *node)
+{
+	unsigned int x = node->info.hash ^ (unsigned int)((uintptr_t)node >> 4);
+
+	x = ((x >> 16u) ^ x) * 0x45d9f3b;
+	x = ((x >> 16u) ^ x) * 0x45d9f3b;
+	return (x >> 16u) ^ x;
+}
+
+/** Verifica daca nodul `node` este inaintea perechii (hash, address). */
+static inline bool hash_index_less(list *node, unsigned int hash,
+								   uintptr_t address)
+{
+	if (node->info.hash != hash)
+		return node->info.hash < hash;
+	return (uintptr_t)node < address;
+}
+
+/**
+ * Imparte arborele in nodurile aflate inainte de (hash, address), respectiv
+ * restul nodurilor.
+ */
+static void hash_index_split(list *root, unsigned int hash, uintptr_t address,
+							 list **less, list **greater)
+{
+	if (!root) {
+		*less = NULL;
+		*greater = NULL;
+		return;
+	}
+
+	if (hash_index_less(root, hash, address)) {
+		hash_index_split(root->right, hash, address, &root->right, greater);
+		*less = root;
+	} else {
+		hash_index_split(root->left, hash, address, less, &root->left);
+		*greater = root;
+	}
+}
+
+/**
+ * Uneste 2 arbori, stiind ca toate nodurile din `less` sunt inaintea celor
+ * din `greater`.
+ */
+static list *hash_index_merge(list *less, list *greater)
+{
+	if (!less)
+		return greater;
+	if (!greater)
+		return less;
+
+	if (hash_index_priority(less) > hash_index_priority(greater)) {
+		less->right = hash_index_merge(less->right, greater);
+		return less;
+	}
+
+	greater->left = hash_index_merge(less, greater->left);
+	return greater;
+}
+
+void hash_index_insert(list **root, list *node)
+{
+	unsigned int hash = node->info.hash;
+	uintptr_t address = (uintptr_t)node;
+
+	/* Se coboara pana la locul in care nodul respecta prioritatea */
+	while (*root && hash_index_priority(*root) >= hash_index_priority(node)) {
+		if (hash_index_less(*root, hash, address))
+			root = &(*root)->right;
+		else
+			root = &(*root)->left;
+	}
+
+	hash_index_split(*root, hash, address, &node->left, &node->right);
+	*root = node;
+}
+
+void hash_index_remove(list **root, list *node)
+{
+	unsigned int hash = node->info.hash;
+	uintptr_t address = (uintptr_t)node;
+
+	while (*root != node) {
+		if (hash_index_less(*root, hash, address))
+			root = &(*root)->right;
+		else
+			root = &(*root)->left;
+	}
+
+	*root = hash_index_merge(node->left, node->right);
+	node->left = NULL;
+	node->right = NULL;
+}
+
+/** Insereaza pe rand nodurile unui subarbore. */
+static void hash_index_insert_all(list **root, list *node)
+{
+	if (!node)
+		return;
+
+	list *left = node->left;
+	list *right = node->right;
+
+	hash_index_insert(root, node);
+	hash_index_insert_all(root, left);
+	hash_index_insert_all(root, right);
+}
+
+list *hash_index_extract_range(list **root, unsigned int min_hash,
+							   unsigned int max_hash)
+{
+	list *less, *range, *greater;
+
+	/* Adresa 0 este inaintea oricarui nod, deci nodurile cu hashul egal cu
+	 * `max_hash` raman in afara intervalului (mai putin la `UINT_MAX`). */
+	hash_index_split(*root, min_hash, 0, &less, &range);
+	greater = NULL;
+	if (max_hash != UINT_MAX)
+		hash_index_split(range, max_hash, 0, &range, &greater);
+	*root = hash_index_merge(less, greater);
+
+	return range;
+}
+
+void hash_index_insert_range(list **root, list *range, unsigned int min_hash,
+							 unsigned int max_hash)
+{
+	list *less, *overlap, *greater;
+
+	if (!range)
+		return;
+
+	hash_index_split(*root, min_hash, 0, &less, &overlap);
+	greater = NULL;
+	if (max_hash != UINT_MAX)
+		hash_index_split(overlap, max_hash, 0, &overlap, &greater);
+
+	if (!overlap) {
+		*root = hash_index_merge(hash_index_merge(less, range), greater);
+		return;
+	}
+
+	*root = hash_index_merge(hash_index_merge(less, overlap), greater);
+	hash_index_insert_all(root, range);
+}
+
+size_t hash_index_count_range(list *root, unsigned int min_hash,
+							  unsigned int max_hash)
+{
+	if (!root)
+		return 0;
+
+	if (root->info.hash < min_hash)
+		return hash_index_count_range(root->right, min_hash, max_hash);
+	if (!hash_in_range(root->info.hash, min_hash, max_hash))
+		return hash_index_count_range(root->left, min_hash, max_hash);
+
+	return 1 + hash_index_count_range(root->left, min_hash, max_hash) +
+		   hash_index_count_range(root->right, min_hash, max_hash);
+}
+
+/**
+ * Parcurge in ordine nodurile cu hashul in interval, numarand `*count` noduri,
+ * apoi cauta primul nod cu hashul diferit de al ultimului numarat. Intoarce
+ * true cand limita a fost gasita (in `*bound`).
+ */
+static bool hash_index_find_bound(list *node, unsigned int min_hash,
+								  unsigned int max_hash, size_t *count,
+								  unsigned int *last_hash, unsigned int *bound)
+{
+	if (!node)
+		return false;
+
+	unsigned int hash = node->info.hash;
+	if (hash < min_hash)
+		return hash_index_find_bound(node->right, min_hash, max_hash, count,
+									 last_hash, bound);
+
+	if (hash_index_find_bound(node->left, min_hash, max_hash, count,
+							  last_hash, bound))
+		return true;
+
+	if (hash >= max_hash || (!*count && hash != *last_hash)) {
+		*bound = hash < max_hash ? hash : max_hash;
+		return true;
+	}
+
+	if (*count)
+		--*count;
+	*last_hash = hash;
+
+	return hash_index_find_bound(node->right, min_hash, max_hash, count,
+								 last_hash, bound);
+}
+
+unsigned int hash_index_range_bound(list *root, unsigned int min_hash,
+									unsigned int max_hash, size_t count)
+{
+	unsigned int last_hash = min_hash;
+	unsigned int bound;
+
+	if (!hash_index_find_bound(root, min_hash, max_hash, &count, &last_hash,
+							   &bound))
+		return max_hash;
+	return bound;
+}
@@ -0,0 +1,105 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef HASH_INDEX_H_
+#define HASH_INDEX_H_
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "list.h"
+
+/**
+ * @file hash_index.h
+ * @brief Index ordonat dupa hashul cheilor, peste nodurile unui hashtable.
+ *
+ * Indexul este un treap ale carui legaturi (`left`, `right`) sunt retinute
+ * direct in noduri, deci nu aloca memorie. Cheia de ordonare este perechea
+ * (hash, adresa nodului), iar prioritatea este derivata din aceasta, asa ca
+ * arborele are inaltime logaritmica in medie.
+ *
+ * Intervalele de hashuri sunt de forma `[min_hash, max_hash)`, cu exceptia
+ * celor care se termina la `UINT_MAX`: acestea il contin si pe `UINT_MAX`,
+ * altfel cheile cu acest hash nu ar intra in niciun interval.
+ */
+
+/**
+ * @brief Verifica daca un hash se afla intr-un interval (vezi mai sus).
+ *
+ * @param hash		hashul
+ * @param min_hash	inceputul intervalului
+ * @param max_hash	sfarsitul intervalului (exclusiv, mai putin `UINT_MAX`)
+ */
+static inline bool hash_in_range(unsigned int hash, unsigned int min_hash,
+								 unsigned int max_hash)
+{
+	return hash >= min_hash && (hash < max_hash || max_hash == UINT_MAX);
+}
+
+/**
+ * @brief Adauga un nod in index.
+ *
+ * @param[in, out]	root	radacina indexului
+ * @param[in]		node	nodul adaugat
+ */
+void hash_index_insert(list **root, list *node);
+
+/**
+ * @brief Scoate un nod din index.
+ *
+ * @param[in, out]	root	radacina indexului
+ * @param[in]		node	nodul scos (trebuie sa existe in index)
+ */
+void hash_index_remove(list **root, list *node);
+
+/**
+ * @brief Scoate din index toate nodurile cu hashul in `[min_hash, max_hash)`.
+ *
+ * @param[in, out]	root		radacina indexului
+ * @param[in]		min_hash	hashul minim al nodurilor scoase
+ * @param[in]		max_hash	hashul maxim (exclusiv) al nodurilor scoase
+ *
+ * @return radacina unui index care contine exact nodurile scoase
+ */
+list *hash_index_extract_range(list **root, unsigned int min_hash,
+							   unsigned int max_hash);
+
+/**
+ * @brief Adauga in index toate nodurile unui alt index, care are hashurile in
+ * `[min_hash, max_hash)`. Daca indexul nu are deja noduri in acest interval,
+ * arborele este lipit intreg, altfel nodurile sunt inserate pe rand.
+ *
+ * @param[in, out]	root		radacina indexului
+ * @param[in]		range		radacina indexului adaugat
+ * @param[in]		min_hash	hashul minim al nodurilor adaugate
+ * @param[in]		max_hash	hashul maxim (exclusiv) al nodurilor adaugate
+ */
+void hash_index_insert_range(list **root, list *range, unsigned int min_hash,
+							 unsigned int max_hash);
+
+/**
+ * @brief Numara nodurile cu hashul in `[min_hash, max_hash)`.
+ *
+ * @param root		radacina indexului
+ * @param min_hash	hashul minim
+ * @param max_hash	hashul maxim (exclusiv)
+ */
+size_t hash_index_count_range(list *root, unsigned int min_hash,
+							  unsigned int max_hash);
+
+/**
+ * @brief Alege o limita `bound` astfel incat `[min_hash, bound)` sa contina
+ * cel putin `count` noduri (si toate nodurile cu acelasi hash ca ultimul
+ * dintre ele), pentru a imparti un interval in bucati de dimensiune limitata.
+ *
+ * @param root		radacina indexului
+ * @param min_hash	inceputul intervalului
+ * @param max_hash	sfarsitul (exclusiv) al intervalului
+ * @param count		numarul minim de noduri (cel putin 1)
+ *
+ * @return limita aleasa, sau `max_hash` daca intervalul are mai putin de
+ * `count` noduri
+ */
+unsigned int hash_index_range_bound(list *root, unsigned int min_hash,
+									unsigned int max_hash, size_t count);
+
+#endif /* HASH_INDEX_H_ */
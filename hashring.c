@@ -1,7 +1,20 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+
 #include "hashring.h"
 #include "utils.h"
 
+/** Alinierea array-ului de hashuri (o linie de cache) */
+#define LOOKUP_ALIGN 64
+
+/** Numarul minim de biti ai prefixelor din tabela de salt */
+#define JUMP_MIN_BITS 4
+/** Numarul maxim de biti ai prefixelor (tabela de 64 MiB); peste acesta,
+ * o cautare parcurge mai multe labeluri */
+#define JUMP_MAX_BITS 24
+
 int compare_servers(const void *a, const void *b)
 {
 	const hashring_entry *a_cast = a;
@@ -20,7 +33,7 @@ hashring_entry *find_server(hashring_entry *hashring, size_t hashring_size,
 
 	while (left <= right) {
 		size_t index = (left + right) / 2;
-		unsigned int hash = hash_function_servers(&hashring[index].label);
+		unsigned int hash = hashring[index].hash;
 
 		if (hash == target_hash)
 			return &hashring[index];
@@ -35,8 +48,7 @@ hashring_entry *find_server(hashring_entry *hashring, size_t hashring_size,
 			if (index == 0)
 				return &hashring[0];
 
-			unsigned int previous_hash =
-				hash_function_servers(&hashring[index - 1].label);
+			unsigned int previous_hash = hashring[index - 1].hash;
 
 			/* Hash-ul este cuprins intre cel al serverului
 			 * curent si hashul serverului anterior, deci
@@ -51,3 +63,117 @@ hashring_entry *find_server(hashring_entry *hashring, size_t hashring_size,
 	 * elementul revine primului server. */
 	return search_containing ? &hashring[0] : NULL;
 }
+
+/**
+ * Completeaza subarborele cu radacina `k` cu labelurile incepand de la
+ * pozitia `index`, in ordine. Intoarce prima pozitie nefolosita.
+ */
+static size_t hashring_lookup_fill(hashring_lookup *lookup,
+								   hashring_entry *hashring, size_t index,
+								   size_t k)
+{
+	if (k > lookup->size)
+		return index;
+
+	index = hashring_lookup_fill(lookup, hashring, index, 2 * k);
+	lookup->hashes[k] = hashring[index].hash;
+	lookup->positions[k] = index;
+	return hashring_lookup_fill(lookup, hashring, index + 1, 2 * k + 1);
+}
+
+void hashring_lookup_build(hashring_lookup *lookup, hashring_entry *hashring,
+						   size_t hashring_size)
+{
+	hashring_lookup_destroy(lookup);
+
+	lookup->size = hashring_size;
+	DIE(posix_memalign((void **)&lookup->hashes, LOOKUP_ALIGN,
+					   (hashring_size + 1) * sizeof(unsigned int)),
+		"failed posix_memalign() of hashring_lookup.hashes");
+	lookup->positions = malloc((hashring_size + 1) * sizeof(unsigned int));
+	DIE(!lookup->positions, "failed malloc() of hashring_lookup.positions");
+
+	hashring_lookup_fill(lookup, hashring, 0, 1);
+}
+
+void hashring_lookup_destroy(hashring_lookup *lookup)
+{
+	free(lookup->hashes);
+	free(lookup->positions);
+	lookup->hashes = NULL;
+	lookup->positions = NULL;
+	lookup->size = 0;
+}
+
+/** Cel mai mic hash cu prefixul `prefix`. */
+static inline unsigned int jump_prefix_start(const hashring_jump *jump,
+											 size_t prefix)
+{
+	return (unsigned long)prefix << (32 - jump->bits);
+}
+
+/** Numarul de intrari ale tabelei. */
+static inline size_t jump_table_size(const hashring_jump *jump)
+{
+	return (size_t)1 << jump->bits;
+}
+
+/** Completeaza tabela (cu dimensiunea deja aleasa) pentru un hashring. */
+static void jump_fill(hashring_jump *jump, hashring_entry *hashring,
+					  size_t hashring_size)
+{
+	size_t index = 0;
+	for (size_t prefix = 0; prefix < jump_table_size(jump); ++prefix) {
+		unsigned int start = jump_prefix_start(jump, prefix);
+		while (index < hashring_size && hashring[index].hash < start)
+			++index;
+		jump->table[prefix] = index;
+	}
+}
+
+void hashring_jump_build(hashring_jump *jump, hashring_entry *hashring,
+						 size_t hashring_size)
+{
+	/* Cel putin 4 intrari per label, pentru ca tabela sa poata fi
+	 * refolosita pana se dubleaza numarul labelurilor. */
+	unsigned int bits = JUMP_MIN_BITS;
+	while (bits < JUMP_MAX_BITS && ((size_t)1 << bits) < 4 * hashring_size)
+		++bits;
+
+	free(jump->table);
+	jump->bits = bits;
+	jump->table = malloc(jump_table_size(jump) * sizeof(unsigned int));
+	DIE(!jump->table, "failed malloc() of hashring_jump.table");
+
+	jump_fill(jump, hashring, hashring_size);
+}
+
+void hashring_jump_update(hashring_jump *jump, hashring_entry *hashring,
+						  size_t hashring_size)
+{
+	bool too_small = jump->bits < JUMP_MAX_BITS &&
+					 jump_table_size(jump) < 2 * hashring_size;
+	bool too_large = jump->bits > JUMP_MIN_BITS &&
+					 jump_table_size(jump) > 16 * hashring_size;
+
+	if (too_small || too_large)
+		hashring_jump_build(jump, hashring, hashring_size);
+	else
+		jump_fill(jump, hashring, hashring_size);
+}
+
+void hashring_jump_copy(hashring_jump *dest, const hashring_jump *src)
+{
+	dest->bits = src->bits;
+	dest->table = malloc(jump_table_size(src) * sizeof(unsigned int));
+	DIE(!dest->table, "failed malloc() of hashring_jump.table");
+
+	memcpy(dest->table, src->table, jump_table_size(src) * sizeof(unsigned int));
+}
+
+void hashring_jump_destroy(hashring_jump *jump)
+{
+	free(jump->table);
+	jump->table = NULL;
+	jump->bits = 0;
+}
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "instrument.h"
 #include "server.h"
 
 /**
@@ -50,4 +51,170 @@ int compare_servers(const void *a, const void *b);
 hashring_entry *find_server(hashring_entry *hashring, size_t hashring_size,
 							unsigned int target_hash, bool search_containing);
 
+/**
+ * @class hashring_lookup
+ * @brief Hashurile labelurilor de pe un hashring, intr-un array dens separat,
+ * in ordinea Eytzinger (nodurile unui arbore binar complet, pe niveluri).
+ *
+ * Primele niveluri ale arborelui, parcurse la fiecare cautare, ocupa cateva
+ * linii de cache, iar descendentii de pe 4 niveluri mai jos ai unui nod sunt
+ * consecutivi, deci pot fi adusi in cache din timp. Cautarea nu are ramificatii
+ * dependente de date.
+ */
+typedef struct {
+	/** numarul de labeluri */
+	size_t size;
+	/** hashurile, indexate de la 1 (fiii lui `k` sunt `2k` si `2k + 1`) */
+	unsigned int *hashes;
+	/** pozitia pe hashring a fiecarui hash din `hashes` */
+	unsigned int *positions;
+} hashring_lookup;
+
+/**
+ * @relates hashring_lookup
+ * @brief Reconstruieste indexul pentru un hashring. Indexul trebuie sa fie
+ * initializat cu zero inainte de prima folosire.
+ *
+ * @param lookup		indexul
+ * @param hashring		hashringul (sortat dupa hash)
+ * @param hashring_size	dimensiunea hashringului
+ */
+void hashring_lookup_build(hashring_lookup *lookup, hashring_entry *hashring,
+						   size_t hashring_size);
+
+/**
+ * @relates hashring_lookup
+ * @brief Cauta serverul caruia ii este repartizat un hash (echivalent cu
+ * `find_server(..., true)`).
+ *
+ * @param lookup	indexul
+ * @param hash		hashul cautat
+ *
+ * @return pozitia pe hashring a labelului gasit
+ */
+static inline size_t hashring_lookup_find(const hashring_lookup *lookup,
+										  unsigned int hash)
+{
+	size_t k = 1;
+
+	while (k <= lookup->size) {
+		/* 16 hashuri ocupa o linie de cache: descendentii de pe 4 niveluri
+		 * mai jos. */
+		__builtin_prefetch(lookup->hashes + 16 * k);
+		k = 2 * k + (lookup->hashes[k] < hash);
+	}
+
+	/* Fiecare nivel coborat dubleaza `k`. */
+	INSTRUMENT_COUNT(INSTRUMENT_RING_LOOKUPS, 1);
+	INSTRUMENT_COUNT(INSTRUMENT_RING_PROBES, 63 - __builtin_clzl(k));
+
+	/* Se urca pana la ultimul nod din care s-a mers la stanga, adica primul
+	 * hash mai mare sau egal cu cel cautat. */
+	k >>= __builtin_ctzl(~k) + 1;
+
+	/* Daca nu exista, hashul revine primului label. */
+	return k ? lookup->positions[k] : 0;
+}
+
+/**
+ * @relates hashring_lookup
+ * @brief Elibereaza memoria indexului.
+ *
+ * @param lookup indexul
+ */
+void hashring_lookup_destroy(hashring_lookup *lookup);
+
+/**
+ * @class hashring_jump
+ * @brief Tabela de salt a unui hashring: pentru fiecare prefix de `bits` biti
+ * al unui hash, pozitia primului label cu hashul cel putin egal cu cel mai mic
+ * hash cu acel prefix. O cautare citeste o intrare din tabela si, de obicei,
+ * 1-2 labeluri consecutive.
+ *
+ * Tabela are intre 2 si 16 intrari pentru fiecare label si este recompletata
+ * in intregime, pe loc, dupa fiecare schimbare a hashringului: inserarea unui
+ * label muta pozitiile tuturor labelurilor de dupa el, deci se schimba si
+ * intrarile de dupa predecesorul lui, nu doar cele din intervalul labelului.
+ * Completarea costa O(2^bits + labeluri), adica O(labeluri), ca si inserarea
+ * in hashring. Doar cand numarul labelurilor iese din aceste limite, tabela se
+ * reconstruieste cu alta dimensiune.
+ */
+typedef struct {
+	/** numarul de biti ai prefixului (0 daca tabela nu exista) */
+	unsigned int bits;
+	/** pozitiile, cate una pentru fiecare prefix */
+	unsigned int *table;
+} hashring_jump;
+
+/**
+ * @relates hashring_jump
+ * @brief Reconstruieste tabela pentru un hashring, alegandu-i dimensiunea.
+ *
+ * @param jump			tabela
+ * @param hashring		hashringul (sortat dupa hash)
+ * @param hashring_size	dimensiunea hashringului
+ */
+void hashring_jump_build(hashring_jump *jump, hashring_entry *hashring,
+						 size_t hashring_size);
+
+/**
+ * @relates hashring_jump
+ * @brief Actualizeaza tabela dupa o schimbare a hashringului (oricate labeluri
+ * inserate sau sterse), recompletand-o in intregime, printr-o singura
+ * parcurgere a tabelei si a hashringului. Tabela este realocata doar daca
+ * numarul labelurilor a iesit din limite.
+ *
+ * @param jump			tabela
+ * @param hashring		hashringul, dupa schimbare
+ * @param hashring_size	dimensiunea hashringului, dupa schimbare
+ */
+void hashring_jump_update(hashring_jump *jump, hashring_entry *hashring,
+						  size_t hashring_size);
+
+/**
+ * @relates hashring_jump
+ * @brief Copiaza o tabela (pentru o copie a hashringului).
+ *
+ * @param dest	tabela in care se copiaza (neinitializata)
+ * @param src	tabela copiata
+ */
+void hashring_jump_copy(hashring_jump *dest, const hashring_jump *src);
+
+/**
+ * @relates hashring_jump
+ * @brief Cauta serverul caruia ii este repartizat un hash (echivalent cu
+ * `find_server(..., true)`).
+ *
+ * @param jump			tabela
+ * @param hashring		hashringul
+ * @param hashring_size	dimensiunea hashringului
+ * @param hash			hashul cautat
+ *
+ * @return pozitia pe hashring a labelului gasit
+ */
+static inline size_t hashring_jump_find(const hashring_jump *jump,
+										hashring_entry *hashring,
+										size_t hashring_size,
+										unsigned int hash)
+{
+	size_t first = jump->table[(unsigned long)hash >> (32 - jump->bits)];
+	size_t index = first;
+
+	while (index < hashring_size && hashring[index].hash < hash)
+		++index;
+
+	INSTRUMENT_COUNT(INSTRUMENT_RING_LOOKUPS, 1);
+	INSTRUMENT_COUNT(INSTRUMENT_RING_PROBES, index - first + 1);
+
+	return index < hashring_size ? index : 0;
+}
+
+/**
+ * @relates hashring_jump
+ * @brief Elibereaza memoria tabelei.
+ *
+ * @param jump tabela
+ */
+void hashring_jump_destroy(hashring_jump *jump);
+
 #endif /* HASHRING_H_ */
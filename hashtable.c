@@ -1,91 +1,818 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "flat_table.h"
+#include "hash_index.h"
 #include "hashtable.h"
+#include "instrument.h"
 #include "list.h"
 #include "utils.h"
 
+/** Numarul de bucketuri mutate in tabela noua la fiecare operatie */
+#define REHASH_STEP 4
+
+/** Factorul cu care se inmulteste/imparte numarul de bucketuri */
+#define RESIZE_FACTOR 2
+
+static inline bool ht_is_rehashing(hashtable *ht)
+{
+	return ht->old_num_buckets != 0;
+}
+
+/**
+ * Intoarce bucketul in care se afla (sau ar trebui inserata) o cheie cu
+ * hashul dat. Cat timp se face redimensionarea, bucketurile vechi care nu au
+ * fost inca mutate raman valabile.
+ */
+static list **ht_get_bucket(hashtable *ht, unsigned int hash)
+{
+	if (ht_is_rehashing(ht)) {
+		size_t old_index = hash % ht->old_num_buckets;
+		if (old_index >= ht->rehash_index)
+			return &ht->old_buckets[old_index];
+	}
+
+	return &ht->buckets[hash % ht->num_buckets];
+}
+
+/**
+ * Cauta pozitia unei chei intr-un hashtable cu adresare deschisa. Tabela
+ * veche nu se modifica pe durata redimensionarii (elementele mutate raman
+ * marcate cu nodul NULL), deci cautarea in ea ramane corecta.
+ *
+ * @param[in]	ht			hashtable-ul
+ * @param[in]	key			cheia cautata
+ * @param[in]	key_size	dimensiunea cheii
+ * @param[in]	hash		hashul cheii
+ * @param[out]	in_old		daca elementul a fost gasit in tabela veche
+ */
+static flat_slot *ht_find_slot(hashtable *ht, void *key, unsigned int key_size,
+							   unsigned int hash, bool *in_old)
+{
+	*in_old = false;
+	if (ht_is_rehashing(ht)) {
+		flat_slot *slot = flat_table_find(ht->old_table, hash, key, key_size);
+		if (slot) {
+			*in_old = true;
+			return slot;
+		}
+	}
+
+	return flat_table_find(ht->table, hash, key, key_size);
+}
+
+/** Elibereaza o tabela cu adresare deschisa, fara nodurile din ea. */
+static void ht_free_flat_table(void *table)
+{
+	free(((flat_table *)table)->slots);
+	free(table);
+}
+
+static void ht_free_node(void *node)
+{
+	list_free_node(node);
+}
+
+/**
+ * Elibereaza memoria care ar putea fi vazuta de cititorii concurenti: pe loc
+ * daca acestia nu exista, altfel dupa ce toti au terminat cautarile curente.
+ */
+static void ht_release(hashtable *ht, void *ptr, void (*free_func)(void *))
+{
+	if (ht->reclaimer)
+		epoch_retire(ht->reclaimer, ptr, free_func);
+	else
+		free_func(ptr);
+}
+
+/** Publica tabelele curente pentru cititorii concurenti. */
+static void ht_publish_view(hashtable *ht)
+{
+	if (!ht->reclaimer)
+		return;
+
+	ht_view *view = malloc(sizeof(ht_view));
+	DIE(!view, "failed malloc() of ht_view");
+
+	view->num_buckets = ht->num_buckets;
+	view->buckets = ht->buckets;
+	view->table = ht->table;
+	view->old_num_buckets = ht->old_num_buckets;
+	view->old_buckets = ht->old_buckets;
+	view->old_table = ht->old_table;
+
+	ht_view *old_view = ht->view;
+	__atomic_store_n(&ht->view, view, __ATOMIC_RELEASE);
+	if (old_view)
+		epoch_retire(ht->reclaimer, old_view, free);
+}
+
+/** Incheie redimensionarea, eliberand tabela veche. */
+static void ht_finish_rehash(hashtable *ht)
+{
+	void *old_table = ht->old_table;
+	void *old_buckets = ht->old_buckets;
+
+	ht->old_table = NULL;
+	ht->old_buckets = NULL;
+	ht->old_num_buckets = 0;
+	ht->rehash_index = 0;
+	ht_publish_view(ht);
+
+	if (ht->engine == HT_ENGINE_FLAT)
+		ht_release(ht, old_table, ht_free_flat_table);
+	else
+		ht_release(ht, old_buckets, free);
+}
+
 /**
- * Calculeaza hashul cheii, folosind functia corespunzatoare
- * hashtable-ului.
+ * Muta cel mult `steps` bucketuri (sau pozitii ocupate, pentru tabelele cu
+ * adresare deschisa) din tabela veche in cea noua. Cand nu mai sunt elemente
+ * de mutat, tabela veche este eliberata.
  */
-static unsigned int ht_compute_hash(hashtable *ht, void *key)
+static void ht_rehash_step(hashtable *ht, size_t steps)
 {
-	return ht->hash_func(key) % ht->num_buckets;
+	while (steps && ht->rehash_index < ht->old_num_buckets) {
+		size_t index = ht->rehash_index++;
+
+		if (ht->engine == HT_ENGINE_FLAT) {
+			flat_slot *slot = &ht->old_table->slots[index];
+			if (!slot->node)
+				continue;
+
+			flat_table_insert(ht->table, slot->node);
+			slot->node = NULL;
+			--steps;
+			continue;
+		}
+
+		list *node = ht->old_buckets[index];
+		ht->old_buckets[index] = NULL;
+
+		/* Bucketurile goale nu se numara, ca sa se garanteze progresul */
+		if (!node)
+			continue;
+
+		while (node) {
+			list *next = node->next;
+			unsigned int hash = node->info.hash;
+
+			list_push(&ht->buckets[hash % ht->num_buckets], node);
+			node = next;
+		}
+		--steps;
+	}
+
+	if (ht->rehash_index == ht->old_num_buckets)
+		ht_finish_rehash(ht);
 }
 
-hashtable *ht_create(unsigned int num_buckets,
-					 unsigned int (*hash_func)(void *),
-					 int (*compare_func)(void *, void *),
-					 void (*destructor_func)(void *, void *))
+/**
+ * Porneste redimensionarea hashtable-ului la `num_buckets` bucketuri.
+ * Elementele sunt mutate treptat, la operatiile urmatoare.
+ */
+static void ht_start_rehash(hashtable *ht, unsigned int num_buckets)
+{
+	ht->old_num_buckets = ht->num_buckets;
+	ht->rehash_index = 0;
+	ht->num_buckets = num_buckets;
+
+	if (ht->engine == HT_ENGINE_FLAT) {
+		ht->old_table = ht->table;
+		ht->table = flat_table_create(num_buckets);
+	} else {
+		list **buckets = calloc(num_buckets, sizeof(list *));
+		DIE(!buckets, "failed malloc() of hashtable.buckets");
+
+		ht->old_buckets = ht->buckets;
+		ht->buckets = buckets;
+	}
+
+	ht_publish_view(ht);
+}
+
+/**
+ * Verifica daca factorul de incarcare a iesit din limite si, daca este cazul,
+ * incepe marirea sau micsorarea hashtable-ului.
+ */
+static void ht_check_resize(hashtable *ht)
+{
+	double load_factor = ht_load_factor(ht);
+
+	/* Nu se incepe o noua redimensionare pana nu se termina cea curenta.
+	 * O tabela cu adresare deschisa nu are voie insa sa se umple, asa ca
+	 * mutarea se termina pe loc daca tabela noua a ajuns la limita. */
+	if (ht_is_rehashing(ht)) {
+		if (ht->engine != HT_ENGINE_FLAT ||
+			load_factor <= ht->max_load_factor)
+			return;
+		ht_rehash_step(ht, ht->old_num_buckets);
+	}
+
+	if (load_factor > ht->max_load_factor) {
+		ht_start_rehash(ht, ht->num_buckets * RESIZE_FACTOR);
+		return;
+	}
+
+	/* Se micsoreaza doar cand tabela ar ramane, si dupa, sub jumatate din
+	 * factorul maxim, ca sa nu se oscileze intre cele 2 dimensiuni. */
+	unsigned int smaller = ht->num_buckets / RESIZE_FACTOR;
+	if (smaller >= ht->min_buckets &&
+		load_factor * RESIZE_FACTOR < ht->max_load_factor / RESIZE_FACTOR)
+		ht_start_rehash(ht, smaller);
+}
+
+/** Adauga cheia si valoarea unui nod la totalurile hashtable-ului. */
+static inline void ht_count_node(hashtable *ht, list *node)
+{
+	ht->key_bytes += node->info.key_size;
+	ht->value_bytes += dict_data_size(list_data(node));
+}
+
+/** Scade cheia si valoarea unui nod din totalurile hashtable-ului. */
+static inline void ht_uncount_node(hashtable *ht, list *node)
+{
+	ht->key_bytes -= node->info.key_size;
+	ht->value_bytes -= dict_data_size(list_data(node));
+}
+
+/** Adauga un nod in tabela hashtable-ului (fara index). */
+static void ht_link_node(hashtable *ht, list *node)
+{
+	if (ht->engine == HT_ENGINE_FLAT)
+		flat_table_insert(ht->table, node);
+	else
+		list_push(ht_get_bucket(ht, node->info.hash), node);
+}
+
+/** Scoate un nod din tabela hashtable-ului (fara index). */
+static void ht_unlink_node(hashtable *ht, list *node)
+{
+	if (ht->engine != HT_ENGINE_FLAT) {
+		list_extract_node(ht_get_bucket(ht, node->info.hash), node);
+		return;
+	}
+
+	/* Tabela veche ramane neschimbata pana la terminarea mutarii. */
+	if (ht_is_rehashing(ht)) {
+		flat_slot *slot = flat_table_find_node(ht->old_table, node);
+		if (slot) {
+			slot->node = NULL;
+			return;
+		}
+	}
+
+	flat_table_remove(ht->table, flat_table_find_node(ht->table, node));
+}
+
+hashtable *ht_create(ht_engine engine, unsigned int num_buckets,
+					 double max_load_factor)
 {
 	hashtable *ht = malloc(sizeof(hashtable));
 	DIE(!ht, "failed malloc() of hashtable");
 
-	ht->num_buckets = num_buckets;
-	ht->buckets = calloc(num_buckets, sizeof(list *));
-	DIE(!ht->buckets, "failed malloc() of hashtable.buckets");
+	ht->engine = engine;
+	ht->buckets = NULL;
+	ht->table = NULL;
+	if (engine == HT_ENGINE_FLAT) {
+		ht->table = flat_table_create(num_buckets);
+		ht->num_buckets = ht->table->capacity;
+	} else {
+		ht->num_buckets = num_buckets;
+		ht->buckets = calloc(num_buckets, sizeof(list *));
+		DIE(!ht->buckets, "failed malloc() of hashtable.buckets");
+	}
 
-	ht->hash_func = hash_func;
-	ht->compare_func = compare_func;
-	ht->destructor_func = destructor_func;
+	ht->min_buckets = ht->num_buckets;
+	ht->max_load_factor = max_load_factor;
+	ht->size = 0;
+	ht->key_bytes = 0;
+	ht->value_bytes = 0;
+	ht->index = NULL;
+
+	ht->old_buckets = NULL;
+	ht->old_table = NULL;
+	ht->old_num_buckets = 0;
+	ht->rehash_index = 0;
+
+	ht->allocator = slab_create();
+	ht->reclaimer = NULL;
+	ht->view = NULL;
 
 	return ht;
 }
 
-void ht_store_item(hashtable *ht, void *key, void *value)
+/**
+ * Scoate din tabela si din index nodul cu cheia data, daca exista. Nodul nu
+ * este eliberat.
+ */
+static list *ht_extract_item(hashtable *ht, void *key, unsigned int key_size,
+							 unsigned int hash)
 {
-	unsigned int hash = ht_compute_hash(ht, key);
-	list *new_node = list_create_node(key, value);
-	list_push(&ht->buckets[hash], new_node);
+	list *item_node;
+	if (ht->engine == HT_ENGINE_FLAT) {
+		bool in_old;
+		flat_slot *slot = ht_find_slot(ht, key, key_size, hash, &in_old);
+		if (!slot)
+			return NULL;
+
+		item_node = slot->node;
+		/* Tabela veche ramane neschimbata pana la terminarea mutarii. */
+		if (in_old)
+			slot->node = NULL;
+		else
+			flat_table_remove(ht->table, slot);
+	} else {
+		item_node =
+			list_extract_item(ht_get_bucket(ht, hash), key, key_size, hash);
+		if (!item_node)
+			return NULL;
+	}
+
+	hash_index_remove(&ht->index, item_node);
+	ht_uncount_node(ht, item_node);
+	--ht->size;
+	return item_node;
 }
 
-void *ht_retrieve_item(hashtable *ht, void *key)
+/** Cauta nodul cu cheia data, fara sa-l scoata din tabela. */
+static list *ht_find_node(hashtable *ht, void *key, unsigned int key_size,
+						  unsigned int hash)
 {
-	unsigned int hash = ht_compute_hash(ht, key);
-	return list_get_item(ht->buckets[hash], key, ht->compare_func);
+	if (ht->engine == HT_ENGINE_FLAT) {
+		bool in_old;
+		flat_slot *slot = ht_find_slot(ht, key, key_size, hash, &in_old);
+		return slot ? slot->node : NULL;
+	}
+
+	list *node = *ht_get_bucket(ht, hash);
+	INSTRUMENT_COUNT(INSTRUMENT_CHAIN_LOOKUPS, 1);
+	while (node && !dict_entry_has_key(&node->info, key, key_size, hash)) {
+		INSTRUMENT_COUNT(INSTRUMENT_CHAIN_STEPS, 1);
+		node = node->next;
+	}
+	return node;
 }
 
-void ht_remove_item(hashtable *ht, void *key)
+/**
+ * Inlocuieste pe loc valoarea unui nod, daca noua valoare incape in blocul
+ * acestuia si il ocupa cel putin pe jumatate (altfel un nod nou, mai mic,
+ * ar elibera memorie).
+ */
+static bool ht_replace_value(hashtable *ht, list *node, void *value,
+							 unsigned int value_size)
 {
-	unsigned int hash = ht_compute_hash(ht, key);
-	list *item_node =
-		list_extract_item(&ht->buckets[hash], key, ht->compare_func);
+	size_t block = slab_block_size(node);
+	size_t needed = list_record_size(node->info.key_size, value_size);
 
-	ht->destructor_func(item_node->info.key, item_node->info.data);
-	free(item_node);
+	if (needed > block || 2 * needed <= block)
+		return false;
+
+	char *data = list_data(node);
+	uint32_t size = value_size;
+
+	ht->value_bytes = ht->value_bytes - dict_data_size(data) + value_size;
+	memcpy(data - sizeof(size), &size, sizeof(size));
+	memmove(data, value, value_size);
+	data[value_size] = '\0';
+	return true;
 }
 
-void ht_transfer_items(hashtable *dest, hashtable *src, unsigned int min_hash,
-					   unsigned int max_hash)
+void ht_store_item(hashtable *ht, void *key, unsigned int key_size,
+				   unsigned int hash, void *value, unsigned int value_size)
 {
-	for (size_t i = 0; i < src->num_buckets; ++i) {
-		if (!src->buckets[i])
-			continue;
+	if (ht_is_rehashing(ht))
+		ht_rehash_step(ht, REHASH_STEP);
+
+	/* Cititorii concurenti ar putea citi valoarea veche chiar acum. */
+	if (!ht->reclaimer) {
+		list *node = ht_find_node(ht, key, key_size, hash);
+		if (node && ht_replace_value(ht, node, value, value_size))
+			return;
+	}
+
+	/* Valoarea veche a cheii este inlocuita. Daca ar ramane ambele noduri,
+	 * ordinea lor (deci si valoarea gasita) s-ar schimba la redimensionari
+	 * si transferuri. */
+	list *old_node = ht_extract_item(ht, key, key_size, hash);
+	if (old_node)
+		ht_release(ht, old_node, ht_free_node);
+
+	list *new_node = list_create_node(ht->allocator, key, key_size, hash,
+									  value, value_size);
+	/* Un cititor concurent care gaseste nodul trebuie sa-l vada complet. */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	ht_link_node(ht, new_node);
+	hash_index_insert(&ht->index, new_node);
+
+	++ht->size;
+	ht->key_bytes += key_size;
+	ht->value_bytes += value_size;
+	ht_check_resize(ht);
+}
+
+void *ht_retrieve_item(hashtable *ht, void *key, unsigned int key_size,
+					   unsigned int hash)
+{
+	if (ht_is_rehashing(ht))
+		ht_rehash_step(ht, REHASH_STEP);
+
+	if (ht->engine == HT_ENGINE_FLAT) {
+		bool in_old;
+		flat_slot *slot = ht_find_slot(ht, key, key_size, hash, &in_old);
+		return slot ? list_data(slot->node) : NULL;
+	}
+
+	return list_get_item(*ht_get_bucket(ht, hash), key, key_size, hash);
+}
+
+void *ht_lookup_item(hashtable *ht, void *key, unsigned int key_size,
+					 unsigned int hash)
+{
+	ht_view *view = __atomic_load_n(&ht->view, __ATOMIC_ACQUIRE);
+
+	/* Un element aflat in mutare poate fi in oricare dintre tabele. */
+	if (ht->engine == HT_ENGINE_FLAT) {
+		flat_slot *slot = NULL;
+		if (view->old_table)
+			slot = flat_table_find(view->old_table, hash, key, key_size);
+		if (!slot)
+			slot = flat_table_find(view->table, hash, key, key_size);
 
-		list *accepted = NULL;
-		list *rejected = NULL;
-		list_split(src->buckets[i], &accepted, &rejected, min_hash, max_hash);
+		list *node = slot ? __atomic_load_n(&slot->node, __ATOMIC_RELAXED)
+						  : NULL;
+		return node ? list_data(node) : NULL;
+	}
+
+	void *item = NULL;
+	if (view->old_buckets)
+		item = list_get_item(view->old_buckets[hash % view->old_num_buckets],
+							 key, key_size, hash);
+	if (!item)
+		item = list_get_item(view->buckets[hash % view->num_buckets], key,
+							 key_size, hash);
+
+	return item;
+}
+
+void ht_prefetch_bucket(hashtable *ht, unsigned int hash)
+{
+	if (ht->engine != HT_ENGINE_FLAT) {
+		__builtin_prefetch(ht_get_bucket(ht, hash));
+		return;
+	}
+
+	if (ht_is_rehashing(ht))
+		flat_table_prefetch_slot(ht->old_table, hash);
+	flat_table_prefetch_slot(ht->table, hash);
+}
+
+void ht_prefetch_node(hashtable *ht, unsigned int hash)
+{
+	if (ht->engine != HT_ENGINE_FLAT) {
+		list *node = *ht_get_bucket(ht, hash);
+		if (node)
+			__builtin_prefetch(node);
+		return;
+	}
+
+	if (ht_is_rehashing(ht))
+		flat_table_prefetch_node(ht->old_table, hash);
+	flat_table_prefetch_node(ht->table, hash);
+}
+
+bool ht_remove_item(hashtable *ht, void *key, unsigned int key_size,
+					unsigned int hash)
+{
+	if (ht_is_rehashing(ht))
+		ht_rehash_step(ht, REHASH_STEP);
+
+	list *item_node = ht_extract_item(ht, key, key_size, hash);
+	if (!item_node)
+		return false;
+
+	ht_release(ht, item_node, ht_free_node);
+	ht_check_resize(ht);
+	return true;
+}
+
+/**
+ * Mareste hashtable-ul dintr-o data, astfel incat sa poata primi `size`
+ * elemente fara alte redimensionari.
+ */
+static void ht_reserve(hashtable *ht, size_t size)
+{
+	unsigned int num_buckets = ht->num_buckets;
+	while (size > num_buckets * ht->max_load_factor)
+		num_buckets *= RESIZE_FACTOR;
+
+	if (num_buckets == ht->num_buckets)
+		return;
+
+	if (ht_is_rehashing(ht))
+		ht_rehash_step(ht, ht->old_num_buckets);
+	ht_start_rehash(ht, num_buckets);
+}
+
+/** Numara nodurile unui subarbore al indexului. */
+static size_t ht_count_subtree(list *node)
+{
+	if (!node)
+		return 0;
+
+	return 1 + ht_count_subtree(node->left) + ht_count_subtree(node->right);
+}
+
+/**
+ * Muta din `src` in `dest` nodurile dintr-un subarbore al indexului. Fiecare
+ * inregistrare este copiata in slabul destinatiei, ca memoria sa fie tinuta
+ * la zi pentru fiecare hashtable, iar copiile sunt adaugate in `*moved`.
+ */
+static void ht_move_subtree(hashtable *dest, hashtable *src, list *node,
+							list **moved)
+{
+	if (!node)
+		return;
+
+	ht_move_subtree(dest, src, node->left, moved);
+	ht_move_subtree(dest, src, node->right, moved);
+
+	/* Copia este legata inainte de scoaterea originalului, deci cheia se
+	 * gaseste tot timpul in cel putin unul dintre hashtable-uri. */
+	list *copy = list_copy_node(dest->allocator, node);
+	ht_link_node(dest, copy);
+	ht_count_node(dest, copy);
+	hash_index_insert(moved, copy);
+
+	ht_unlink_node(src, node);
+	ht_uncount_node(src, node);
+	ht_release(src, node, ht_free_node);
+}
+
+size_t ht_transfer_items(hashtable *dest, hashtable *src,
+						 unsigned int min_hash, unsigned int max_hash)
+{
+	hash_range range = {min_hash, max_hash};
+
+	return ht_transfer_ranges(dest, src, &range, 1);
+}
+
+size_t ht_transfer_ranges(hashtable *dest, hashtable *src,
+						  const hash_range *ranges, size_t count)
+{
+	/* Elementele sunt deja unde trebuie (ar fi si periculos sa se insereze in
+	 * tabela care este parcursa). */
+	if (dest == src || !count)
+		return 0;
+
+	list *single, **moved = &single;
+	if (count > 1) {
+		moved = malloc(count * sizeof(list *));
+		DIE(!moved, "failed malloc() of transferred ranges");
+	}
 
-		/* Elementele care au hashul corespunzator sunt inserate
-		 * in `dest`, iar restul se reintorc in bucket */
-		src->buckets[i] = rejected;
-		while (accepted) {
-			dict_entry pair = accepted->info;
-			ht_store_item(dest, pair.key, pair.data);
+	/* Indexul ordonat dupa hash da direct elementele transferate, deci nu se
+	 * parcurg deloc elementele care raman in `src`. */
+	size_t transferred = 0;
+	for (size_t i = 0; i < count; ++i) {
+		moved[i] = hash_index_extract_range(&src->index, ranges[i].min_hash,
+											ranges[i].max_hash);
+		transferred += ht_count_subtree(moved[i]);
+	}
 
-			list *oldptr = accepted;
-			accepted = accepted->next;
-			free(oldptr);
+	if (transferred) {
+		ht_reserve(dest, dest->size + transferred);
+
+		/* Copiile din fiecare interval formeaza un subarbore nou, care trece
+		 * intreg in indexul destinatiei. */
+		for (size_t i = 0; i < count; ++i) {
+			list *copies = NULL;
+			ht_move_subtree(dest, src, moved[i], &copies);
+			hash_index_insert_range(&dest->index, copies, ranges[i].min_hash,
+									ranges[i].max_hash);
 		}
+
+		dest->size += transferred;
+		src->size -= transferred;
+		ht_check_resize(src);
 	}
+
+	if (moved != &single)
+		free(moved);
+	return transferred;
+}
+
+/** Copiaza in `dest` obiectele dintr-un subarbore al indexului. */
+static void ht_copy_subtree(hashtable *dest, list *node)
+{
+	if (!node)
+		return;
+
+	ht_copy_subtree(dest, node->left);
+	void *data = list_data(node);
+	ht_store_item(dest, list_key(node), node->info.key_size,
+				  node->info.hash, data, dict_data_size(data));
+	ht_copy_subtree(dest, node->right);
+}
+
+size_t ht_copy_ranges(hashtable *dest, hashtable *src,
+					  const hash_range *ranges, size_t count)
+{
+	if (dest == src)
+		return 0;
+
+	size_t copied = 0;
+	for (size_t i = 0; i < count; ++i)
+		copied += hash_index_count_range(src->index, ranges[i].min_hash,
+										 ranges[i].max_hash);
+	if (!copied)
+		return 0;
+
+	ht_reserve(dest, dest->size + copied);
+	for (size_t i = 0; i < count; ++i) {
+		/* Subarborele scos este pus la loc intreg, fiindca intervalul
+		 * ramane gol in `src`. */
+		list *range = hash_index_extract_range(
+			&src->index, ranges[i].min_hash, ranges[i].max_hash);
+		ht_copy_subtree(dest, range);
+		hash_index_insert_range(&src->index, range, ranges[i].min_hash,
+								ranges[i].max_hash);
+	}
+
+	return copied;
+}
+
+/** Scoate din tabela si elibereaza nodurile unui subarbore al indexului. */
+static void ht_release_subtree(hashtable *ht, list *node)
+{
+	if (!node)
+		return;
+
+	ht_release_subtree(ht, node->left);
+	ht_release_subtree(ht, node->right);
+
+	ht_unlink_node(ht, node);
+	ht_uncount_node(ht, node);
+	ht_release(ht, node, ht_free_node);
+}
+
+size_t ht_remove_ranges(hashtable *ht, const hash_range *ranges, size_t count)
+{
+	size_t removed = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		list *range = hash_index_extract_range(&ht->index, ranges[i].min_hash,
+											   ranges[i].max_hash);
+		removed += ht_count_subtree(range);
+		ht_release_subtree(ht, range);
+	}
+
+	if (removed) {
+		ht->size -= removed;
+		ht_check_resize(ht);
+	}
+	return removed;
+}
+
+/** Parcurge in ordine un subarbore al indexului. */
+static void ht_visit_subtree(list *node,
+							 void (*func)(dict_entry *entry, void *arg),
+							 void *arg)
+{
+	if (!node)
+		return;
+
+	ht_visit_subtree(node->left, func, arg);
+	func(&node->info, arg);
+	ht_visit_subtree(node->right, func, arg);
+}
+
+void ht_for_each(hashtable *ht, void (*func)(dict_entry *entry, void *arg),
+				 void *arg)
+{
+	ht_visit_subtree(ht->index, func, arg);
+}
+
+size_t ht_count_range(hashtable *ht, unsigned int min_hash,
+					  unsigned int max_hash)
+{
+	return hash_index_count_range(ht->index, min_hash, max_hash);
+}
+
+unsigned int ht_range_bound(hashtable *ht, unsigned int min_hash,
+							unsigned int max_hash, size_t count)
+{
+	return hash_index_range_bound(ht->index, min_hash, max_hash, count);
+}
+
+size_t ht_size(hashtable *ht)
+{
+	return ht->size;
+}
+
+double ht_load_factor(hashtable *ht)
+{
+	return (double)ht->size / ht->num_buckets;
+}
+
+void ht_memory_usage(hashtable *ht, size_t *used, size_t *reserved)
+{
+	*used = ht->allocator->used;
+	*reserved = ht->allocator->reserved;
+}
+
+/** Cel mai lung bucket dintr-un array de bucketuri. */
+static size_t ht_longest_bucket(list **buckets, unsigned int num_buckets)
+{
+	size_t longest = 0;
+
+	for (unsigned int i = 0; i < num_buckets; ++i) {
+		size_t length = 0;
+		for (list *node = buckets[i]; node; node = node->next)
+			++length;
+		if (length > longest)
+			longest = length;
+	}
+
+	return longest;
+}
+
+/** Cea mai lunga secventa de sondare dintr-o tabela cu adresare deschisa. */
+static size_t ht_longest_probe(flat_table *table)
+{
+	size_t longest = 0;
+
+	for (size_t i = 0; i < table->capacity; ++i)
+		if (table->slots[i].distance > longest)
+			longest = table->slots[i].distance;
+
+	return longest;
+}
+
+void ht_get_stats(hashtable *ht, ht_stats *stats)
+{
+	stats->size = ht->size;
+	stats->key_bytes = ht->key_bytes;
+	stats->value_bytes = ht->value_bytes;
+	stats->node_bytes = ht->size * list_record_size(0, 0);
+
+	if (ht->engine == HT_ENGINE_FLAT) {
+		stats->table_bytes = ht->table->capacity * sizeof(flat_slot);
+		stats->longest_chain = ht_longest_probe(ht->table);
+		if (ht->old_table) {
+			size_t longest = ht_longest_probe(ht->old_table);
+			stats->table_bytes += ht->old_table->capacity * sizeof(flat_slot);
+			if (longest > stats->longest_chain)
+				stats->longest_chain = longest;
+		}
+		return;
+	}
+
+	stats->table_bytes =
+		((size_t)ht->num_buckets + ht->old_num_buckets) * sizeof(list *);
+	stats->longest_chain = ht_longest_bucket(ht->buckets, ht->num_buckets);
+	if (ht->old_buckets) {
+		size_t longest =
+			ht_longest_bucket(ht->old_buckets, ht->old_num_buckets);
+		if (longest > stats->longest_chain)
+			stats->longest_chain = longest;
+	}
+}
+
+void ht_set_reclaimer(hashtable *ht, epoch *reclaimer)
+{
+	ht->reclaimer = reclaimer;
+	ht_publish_view(ht);
+}
+
+void ht_enable_locking(hashtable *ht)
+{
+	slab_enable_locking(ht->allocator);
 }
 
 void ht_destroy(hashtable *ht)
 {
-	for (size_t i = 0; i < ht->num_buckets; ++i)
-		list_destroy(ht->buckets[i], ht->destructor_func);
-	free(ht->buckets);
+	if (ht->engine == HT_ENGINE_FLAT) {
+		if (ht->old_table)
+			flat_table_destroy(ht->old_table);
+		flat_table_destroy(ht->table);
+	} else {
+		for (size_t i = 0; i < ht->old_num_buckets; ++i)
+			list_destroy(ht->old_buckets[i]);
+		free(ht->old_buckets);
+
+		for (size_t i = 0; i < ht->num_buckets; ++i)
+			list_destroy(ht->buckets[i]);
+		free(ht->buckets);
+	}
+
+	/* Chunkurile slabului sunt eliberate toate odata; raman doar cele care
+	 * contin noduri retrase, inca vizibile cititorilor concurenti. */
+	slab_destroy(ht->allocator);
+	free(ht->view);
 	free(ht);
 }
@@ -1,88 +1,398 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
 #ifndef HASHTABLE_H_
 #define HASHTABLE_H_
+#include <stdbool.h>
 #include <stddef.h>
 
+#include "epoch.h"
+#include "flat_table.h"
 #include "list.h"
+#include "slab.h"
+
+/**
+ * @brief Modul in care hashtable-ul isi organizeaza elementele.
+ */
+typedef enum {
+	/** array de bucketuri, fiecare fiind o lista inlantuita */
+	HT_ENGINE_CHAINED,
+	/** adresare deschisa, elementele fiind retinute direct in array */
+	HT_ENGINE_FLAT,
+} ht_engine;
+
+/**
+ * @brief Un interval de hashuri, `[min_hash, max_hash)`.
+ */
+typedef struct {
+	/** hashul minim */
+	unsigned int min_hash;
+	/** hashul maxim (exclusiv) */
+	unsigned int max_hash;
+} hash_range;
+
+/**
+ * @class ht_view
+ * @brief Tabelele unui hashtable, asa cum le vad cititorii concurenti.
+ *
+ * Un view nu se modifica dupa publicare; la fiecare inceput sau sfarsit de
+ * redimensionare se publica unul nou, deci un cititor nu poate combina un
+ * array cu dimensiunea altuia.
+ */
+typedef struct {
+	/** numarul de bucketuri din `buckets` */
+	unsigned int num_buckets;
+	/** bucketurile (pentru `HT_ENGINE_CHAINED`) */
+	list **buckets;
+	/** tabela (pentru `HT_ENGINE_FLAT`) */
+	flat_table *table;
+	/** numarul de bucketuri din `old_buckets` */
+	unsigned int old_num_buckets;
+	/** bucketurile vechi, sau NULL */
+	list **old_buckets;
+	/** tabela veche, sau NULL */
+	flat_table *old_table;
+} ht_view;
+
+/**
+ * @brief Ocuparea unui hashtable, calculata de `ht_get_stats`.
+ */
+typedef struct {
+	/** numarul de elemente */
+	size_t size;
+	/** suma dimensiunilor cheilor (in bytes) */
+	size_t key_bytes;
+	/** suma lungimilor valorilor (in bytes) */
+	size_t value_bytes;
+	/** memoria nodurilor, in afara de chei si valori: antetul, lungimea
+	 * valorii si terminatorul ei (in bytes) */
+	size_t node_bytes;
+	/** memoria bucketurilor sau a pozitiilor tabelei, inclusiv a celei vechi
+	 * in timpul unei redimensionari (in bytes) */
+	size_t table_bytes;
+	/** cel mai lung bucket (sau cea mai lunga secventa de sondare, pentru
+	 * `HT_ENGINE_FLAT`) */
+	size_t longest_chain;
+} ht_stats;
 
 /**
  * @class hashtable
  * @brief O tabela de dispersie care poate retine elemente generice.
+ *
+ * Cheile si valorile sunt copiate byte cu byte, in acelasi bloc cu nodul care
+ * le contine, alocat dintr-un slab propriu al hashtable-ului.
+ *
+ * Hashul cheilor este dat de apelant si retinut langa fiecare element, deci
+ * o cheie nu este hash-uita din nou la redimensionari sau transferuri.
+ *
+ * Tabela se redimensioneaza automat in functie de factorul de incarcare, iar
+ * elementele sunt mutate treptat in noile bucketuri, cate putin la fiecare
+ * operatie, ca sa nu existe o pauza lunga la o singura cerere.
  */
 typedef struct hashtable {
-	/** numarul de bucketuri pe care le are hashtableul */
+	/** modul de organizare a elementelor */
+	ht_engine engine;
+	/** numarul de bucketuri (sau de pozitii, pentru `HT_ENGINE_FLAT`) pe
+	 * care le are hashtableul */
 	unsigned int num_buckets;
-	/** bucketurile hashtableului */
+	/** bucketurile hashtableului (pentru `HT_ENGINE_CHAINED`) */
 	list **buckets;
+	/** tabela cu adresare deschisa (pentru `HT_ENGINE_FLAT`) */
+	flat_table *table;
+	/** numarul minim de bucketuri sub care nu se micsoreaza tabela */
+	unsigned int min_buckets;
+
+	/** numarul de elemente stocate */
+	size_t size;
+	/** suma dimensiunilor cheilor stocate (in bytes) */
+	size_t key_bytes;
+	/** suma lungimilor valorilor stocate (in bytes) */
+	size_t value_bytes;
+	/** radacina indexului care ordoneaza nodurile dupa hashul cheii */
+	list *index;
+	/** factorul de incarcare peste care tabela se mareste */
+	double max_load_factor;
+
+	/** bucketurile care inca se muta in tabela noua (sau NULL, daca
+	 * hashtableul nu se redimensioneaza) */
+	list **old_buckets;
+	/** echivalentul lui `old_buckets` pentru `HT_ENGINE_FLAT` */
+	flat_table *old_table;
+	/** numarul de bucketuri al tabelei vechi (0 daca hashtableul nu se
+	 * redimensioneaza) */
+	unsigned int old_num_buckets;
+	/** primul bucket din tabela veche care nu a fost inca mutat */
+	size_t rehash_index;
+
+	/** alocatorul din care se iau nodurile (impreuna cu cheile si valorile
+	 * copiate in ele) */
+	slab *allocator;
 
-	/** functia de hash a cheilor */
-	unsigned int (*hash_func)(void *key);
-	/** functia de comparare a cheilor */
-	int (*compare_func)(void *key1, void *key2);
-	/** functia de eliberare a cheilor si valorilor */
-	void (*destructor_func)(void *key, void *data);
+	/** domeniul prin care se elibereaza memoria vizibila cititorilor
+	 * concurenti (NULL daca nu exista astfel de cititori) */
+	epoch *reclaimer;
+	/** tabelele curente, publicate pentru cititorii concurenti */
+	ht_view *view;
 } hashtable;
 
 /**
  * @relates hashtable
  * @brief Creeaza si initializaeaza un hashtable.
  *
- * @param num_buckets 		numarul de bucketuri ale hashtable-ului
- * @param hash_func 		functia de hash a cheilor
- * @param compare_func 		functia de comparare a cheilor
- * @param destructor_func	functia de eliberare a cheilor si valorilor
+ * @param engine			modul de organizare a elementelor
+ * @param num_buckets 		numarul initial (si minim) de bucketuri ale
+ *							hashtable-ului
+ * @param max_load_factor	numarul mediu de elemente dintr-un bucket peste
+ *							care hashtable-ul se mareste
 
  * @return Hashtable-ul creat
  */
-hashtable *ht_create(unsigned int num_buckets,
-					 unsigned int (*hash_func)(void *key),
-					 int (*compare_func)(void *key1, void *key2),
-					 void (*destructor_func)(void *key, void *data));
+hashtable *ht_create(ht_engine engine, unsigned int num_buckets,
+					 double max_load_factor);
 
 /**
  * @relates hashtable
- * @brief Insereaza in hashtable o noua pereche (cheie, valoare).
+ * @brief Insereaza in hashtable o noua pereche (cheie, valoare). Daca cheia
+ * exista deja, valoarea ei este inlocuita: pe loc, in blocul nodului, daca
+ * noua valoare incape in acesta fara sa iroseasca mai mult de jumatate din el
+ * (si nu exista cititori concurenti, care ar putea citi valoarea veche),
+ * altfel printr-un nod nou.
  *
- * @param ht 	hashtable-ul in care se insereaza
- * @param key 	cheia la care se face insertia
- * @param value	valoarea inserata
+ * @param ht 			hashtable-ul in care se insereaza
+ * @param key 			cheia la care se face insertia
+ * @param key_size		dimensiunea cheii
+ * @param hash			hashul cheii
+ * @param value			valoarea inserata (poate contine bytes nuli)
+ * @param value_size	dimensiunea valorii; la copia ei se adauga un `'\0'`
  */
-void ht_store_item(hashtable *ht, void *key, void *value);
+void ht_store_item(hashtable *ht, void *key, unsigned int key_size,
+				   unsigned int hash, void *value, unsigned int value_size);
 
 /**
  * @relates hashtable
  * @brief Returneaza informatia stocata la cheia data.
  *
- * @param ht 	hashtable-ul din care se cauta
- * @param key 	cheia cautata
+ * @param ht 		hashtable-ul din care se cauta
+ * @param key 		cheia cautata
+ * @param key_size	dimensiunea cheii
+ * @param hash		hashul cheii
+ *
+ * @return		valoarea (cu lungimea data de `dict_data_size`)
+ * @retval NULL	cheia nu exista
+ */
+void *ht_retrieve_item(hashtable *ht, void *key, unsigned int key_size,
+					   unsigned int hash);
+
+/**
+ * @relates hashtable
+ * @brief Cauta informatia stocata la cheia data, fara sa modifice hashtable-ul.
+ * Poate fi apelata din alt thread decat cel care modifica hashtable-ul, daca
+ * acesta are un `reclaimer` si apelantul se afla intr-o sectiune critica a
+ * lui. Rezultatul poate fi gresit daca hashtable-ul se modifica in timpul
+ * cautarii, deci trebuie validat de apelant.
+ *
+ * @param ht 		hashtable-ul din care se cauta
+ * @param key 		cheia cautata
+ * @param key_size	dimensiunea cheii
+ * @param hash		hashul cheii
  */
-void *ht_retrieve_item(hashtable *ht, void *key);
+void *ht_lookup_item(hashtable *ht, void *key, unsigned int key_size,
+					 unsigned int hash);
 
 /**
  * @relates hashtable
- * @brief Sterge din hashtable elementul cu cheia data.
+ * @brief Aduce in cache bucketul (sau pozitia) unei chei, ca o cautare
+ * ulterioara a ei sa nu astepte dupa memorie. Impreuna cu
+ * `ht_prefetch_node`, permite intercalarea cautarilor mai multor chei.
  *
- * @param ht 	hashtable-ul din care se sterge
- * @param key 	cheia elementului de sters
+ * @param ht	hashtable-ul
+ * @param hash	hashul cheii
  */
-void ht_remove_item(hashtable *ht, void *key);
+void ht_prefetch_bucket(hashtable *ht, unsigned int hash);
+
+/**
+ * @relates hashtable
+ * @brief Aduce in cache primul nod din bucketul unei chei. Bucketul ar trebui
+ * sa fie deja in cache (`ht_prefetch_bucket`).
+ *
+ * @param ht	hashtable-ul
+ * @param hash	hashul cheii
+ */
+void ht_prefetch_node(hashtable *ht, unsigned int hash);
+
+/**
+ * @relates hashtable
+ * @brief Sterge din hashtable elementul cu cheia data (daca exista).
+ *
+ * @param ht 		hashtable-ul din care se sterge
+ * @param key 		cheia elementului de sters
+ * @param key_size	dimensiunea cheii
+ * @param hash		hashul cheii
+ *
+ * @return daca elementul a existat
+ */
+bool ht_remove_item(hashtable *ht, void *key, unsigned int key_size,
+					unsigned int hash);
 
 /**
  * @relates hashtable
  * @brief Transfera obiectele stocate dintr-un hashtable in altul, in functie
- * de hashul acsetora.
+ * de hashul acsetora. Costul depinde doar de numarul de obiecte transferate,
+ * nu si de cele care raman in `src`. Obiectele sunt copiate in memoria lui
+ * `dest`, iar originalele eliberate din `src`.
  *
  * @param dest		hashtable-ul destinatie
  * @param src		hashtable-ul original
  * @param min_hash	hashul minim pe care il au obiectele transferate
  * @param max_hash	hashul maxim pe care il au obiectele transferate
+ *
+ * @return numarul de obiecte transferate
+ */
+size_t ht_transfer_items(hashtable *dest, hashtable *src,
+						 unsigned int min_hash, unsigned int max_hash);
+
+/**
+ * @relates hashtable
+ * @brief Transfera deodata obiectele din mai multe intervale de hashuri:
+ * `dest` este redimensionat si `src` verificat o singura data, indiferent de
+ * numarul intervalelor.
+ *
+ * @param dest		hashtable-ul destinatie
+ * @param src		hashtable-ul original
+ * @param ranges	intervalele, disjuncte
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte transferate
+ */
+size_t ht_transfer_ranges(hashtable *dest, hashtable *src,
+						  const hash_range *ranges, size_t count);
+
+/**
+ * @relates hashtable
+ * @brief Copiaza obiectele din mai multe intervale de hashuri, fara sa le
+ * scoata din `src`. Cheile care exista deja in `dest` sunt inlocuite.
+ *
+ * @param dest		hashtable-ul destinatie
+ * @param src		hashtable-ul original
+ * @param ranges	intervalele, disjuncte
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte copiate
+ */
+size_t ht_copy_ranges(hashtable *dest, hashtable *src,
+					  const hash_range *ranges, size_t count);
+
+/**
+ * @relates hashtable
+ * @brief Sterge obiectele din mai multe intervale de hashuri. Costul depinde
+ * doar de numarul de obiecte sterse.
+ *
+ * @param ht		hashtable-ul
+ * @param ranges	intervalele, disjuncte
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte sterse
+ */
+size_t ht_remove_ranges(hashtable *ht, const hash_range *ranges, size_t count);
+
+/**
+ * @relates hashtable
+ * @brief Apeleaza o functie pentru fiecare element, in ordinea hashurilor.
+ * Functia nu trebuie sa modifice hashtable-ul.
+ *
+ * @param ht	hashtable-ul
+ * @param func	functia apelata, cu elementul si `arg`
+ * @param arg	argument dat mai departe functiei
+ */
+void ht_for_each(hashtable *ht, void (*func)(dict_entry *entry, void *arg),
+				 void *arg);
+
+/**
+ * @relates hashtable
+ * @brief Numara elementele cu hashul in `[min_hash, max_hash)`.
+ *
+ * @param ht		hashtable-ul
+ * @param min_hash	hashul minim
+ * @param max_hash	hashul maxim (exclusiv)
+ */
+size_t ht_count_range(hashtable *ht, unsigned int min_hash,
+					  unsigned int max_hash);
+
+/**
+ * @relates hashtable
+ * @brief Alege o limita `bound` astfel incat `[min_hash, bound)` sa contina
+ * aproximativ `count` elemente (vezi `hash_index_range_bound`).
+ *
+ * @param ht		hashtable-ul
+ * @param min_hash	inceputul intervalului
+ * @param max_hash	sfarsitul (exclusiv) al intervalului
+ * @param count		numarul dorit de elemente (cel putin 1)
+ */
+unsigned int ht_range_bound(hashtable *ht, unsigned int min_hash,
+							unsigned int max_hash, size_t count);
+
+/**
+ * @relates hashtable
+ * @brief Intoarce numarul de elemente stocate in hashtable.
+ *
+ * @param ht hashtable-ul
+ */
+size_t ht_size(hashtable *ht);
+
+/**
+ * @relates hashtable
+ * @brief Intoarce factorul de incarcare curent al hashtable-ului (numarul mediu
+ * de elemente dintr-un bucket).
+ *
+ * @param ht hashtable-ul
+ */
+double ht_load_factor(hashtable *ht);
+
+/**
+ * @relates hashtable
+ * @brief Intoarce memoria ocupata de blocurile alocate din slabul
+ * hashtable-ului, respectiv memoria rezervata de acesta.
+ *
+ * @param[in]	ht			hashtable-ul
+ * @param[out]	used		memoria ocupata (in bytes)
+ * @param[out]	reserved	memoria rezervata (in bytes)
+ */
+void ht_memory_usage(hashtable *ht, size_t *used, size_t *reserved);
+
+/**
+ * @relates hashtable
+ * @brief Calculeaza ocuparea hashtable-ului. Numarul de elemente si bytes
+ * ai cheilor si valorilor sunt tinuti la zi la fiecare operatie; restul
+ * sunt calculate acum (cel mai lung bucket, parcurgand toata tabela).
+ *
+ * @param[in]	ht		hashtable-ul
+ * @param[out]	stats	ocuparea sa
+ */
+void ht_get_stats(hashtable *ht, ht_stats *stats);
+
+/**
+ * @relates hashtable
+ * @brief Permite cautari concurente cu `ht_lookup_item`. De acum inainte,
+ * memoria pe care o pot vedea cititorii (noduri sterse, tabele vechi) este
+ * eliberata prin `reclaimer`.
+ *
+ * @param ht		hashtable-ul
+ * @param reclaimer	domeniul in care se retrage memoria
+ */
+void ht_set_reclaimer(hashtable *ht, epoch *reclaimer);
+
+/**
+ * @relates hashtable
+ * @brief Permite ca hashtable-ul sa fie modificat din mai multe threaduri,
+ * pe rand (sincronizarea intre operatii este facuta de apelant). Nodurile
+ * mutate in alte hashtable-uri pot fi eliberate de acestea in paralel.
+ *
+ * @param ht hashtable-ul
  */
-void ht_transfer_items(hashtable *dest, hashtable *src, unsigned int min_hash,
-					   unsigned int max_hash);
+void ht_enable_locking(hashtable *ht);
 
 /**
  * @relates hashtable
- * @brief Sterge hashtable-ul si toate resursele alocate de acesta.
+ * @brief Sterge hashtable-ul si toate resursele alocate de acesta. Niciun
+ * cititor concurent nu mai trebuie sa il poata accesa.
  *
  * @param ht hashtable-ul de eliberat
  */
@@ -0,0 +1,200 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _DEFAULT_SOURCE
+#include "instrument.h"
+
+#ifdef INSTRUMENT
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils.h"
+
+/** Numarul de bucketuri ale valorilor mici, retinute exact */
+#define HISTOGRAM_SUB_COUNT (1u << HISTOGRAM_SUB_BITS)
+/** Numarul de bucketuri ale fiecarei puteri a lui 2 de dupa acestea */
+#define HISTOGRAM_HALF_COUNT (HISTOGRAM_SUB_COUNT / 2)
+
+static histogram histograms[INSTRUMENT_NUM_HISTOGRAMS];
+static uint64_t counters[INSTRUMENT_NUM_COUNTERS];
+
+/** Setat de handlerul semnalului, pana la urmatorul `instrument_poll` */
+static volatile sig_atomic_t dump_requested;
+
+static const struct {
+	/** numele operatiei */
+	const char *name;
+	/** unitatea valorilor */
+	const char *unit;
+} histogram_names[INSTRUMENT_NUM_HISTOGRAMS] = {
+	[INSTRUMENT_STORE] = {"store", "ns"},
+	[INSTRUMENT_RETRIEVE] = {"retrieve", "ns"},
+	[INSTRUMENT_REMOVE] = {"remove", "ns"},
+	[INSTRUMENT_ADD_SERVER] = {"add_server", "ns"},
+	[INSTRUMENT_REMOVE_SERVER] = {"remove_server", "ns"},
+	[INSTRUMENT_TRANSFER] = {"transfer", "ns"},
+	[INSTRUMENT_REBALANCE_KEYS] = {"rebalance_keys", "keys"},
+};
+
+static const char *counter_names[INSTRUMENT_NUM_COUNTERS] = {
+	[INSTRUMENT_RING_LOOKUPS] = "ring_lookups",
+	[INSTRUMENT_RING_PROBES] = "ring_probes",
+	[INSTRUMENT_CHAIN_LOOKUPS] = "chain_lookups",
+	[INSTRUMENT_CHAIN_STEPS] = "chain_steps",
+	[INSTRUMENT_MOVED_KEYS] = "moved_keys",
+};
+
+/**
+ * Valorile mai mici decat `HISTOGRAM_SUB_COUNT` au cate un bucket; celelalte
+ * sunt impartite, pentru fiecare putere a lui 2, in `HISTOGRAM_HALF_COUNT`
+ * bucketuri egale, dupa primii `HISTOGRAM_SUB_BITS` biti.
+ */
+static size_t histogram_index(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_COUNT)
+		return value;
+
+	unsigned int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS + 1;
+	return shift * HISTOGRAM_HALF_COUNT + (value >> shift);
+}
+
+/** Cea mai mare valoare care cade in bucketul dat. */
+static uint64_t histogram_bucket_max(size_t index)
+{
+	if (index < HISTOGRAM_SUB_COUNT)
+		return index;
+
+	unsigned int shift = index / HISTOGRAM_HALF_COUNT - 1;
+	uint64_t mantissa = index - shift * HISTOGRAM_HALF_COUNT;
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void histogram_record(histogram *hist, uint64_t value)
+{
+	__atomic_fetch_add(&hist->counts[histogram_index(value)], 1,
+					   __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->total, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+	uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	while (value > max &&
+		   !__atomic_compare_exchange_n(&hist->max, &max, value, true,
+										__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+uint64_t histogram_quantile(const histogram *hist, double quantile)
+{
+	uint64_t total = __atomic_load_n(&hist->total, __ATOMIC_RELAXED);
+	uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	uint64_t rank = (uint64_t)(quantile * total + 0.5);
+	uint64_t seen = 0;
+
+	if (!rank)
+		rank = 1;
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		seen += __atomic_load_n(&hist->counts[i], __ATOMIC_RELAXED);
+		if (seen >= rank) {
+			uint64_t value = histogram_bucket_max(i);
+			return value < max ? value : max;
+		}
+	}
+
+	return max;
+}
+
+static uint64_t instrument_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+instrument_span instrument_begin(void)
+{
+	return (instrument_span){
+		.start = instrument_now(),
+		.moved = __atomic_load_n(&counters[INSTRUMENT_MOVED_KEYS],
+								 __ATOMIC_RELAXED),
+	};
+}
+
+void instrument_end(instrument_histogram which, const instrument_span *span)
+{
+	histogram_record(&histograms[which], instrument_now() - span->start);
+}
+
+void instrument_end_rebalance(instrument_histogram which,
+							  const instrument_span *span)
+{
+	instrument_end(which, span);
+
+	/* Adaugarile si stergerile de servere sunt serializate, deci diferenta
+	 * contine doar mutarile lor (si pasii mutarilor treptate din alte
+	 * threaduri, daca exista). */
+	uint64_t moved =
+		__atomic_load_n(&counters[INSTRUMENT_MOVED_KEYS], __ATOMIC_RELAXED);
+	histogram_record(&histograms[INSTRUMENT_REBALANCE_KEYS],
+					 moved - span->moved);
+}
+
+void instrument_count(instrument_counter which, uint64_t value)
+{
+	__atomic_fetch_add(&counters[which], value, __ATOMIC_RELAXED);
+}
+
+void instrument_dump(FILE *file)
+{
+	for (int i = 0; i < INSTRUMENT_NUM_HISTOGRAMS; ++i) {
+		const histogram *hist = &histograms[i];
+		const char *unit = histogram_names[i].unit;
+		uint64_t total = __atomic_load_n(&hist->total, __ATOMIC_RELAXED);
+		uint64_t sum = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+
+		fprintf(file,
+				"op=%s count=%llu mean_%s=%.1f p50_%s=%llu p99_%s=%llu "
+				"p999_%s=%llu max_%s=%llu\n",
+				histogram_names[i].name, (unsigned long long)total, unit,
+				total ? (double)sum / total : 0.0, unit,
+				(unsigned long long)histogram_quantile(hist, 0.5), unit,
+				(unsigned long long)histogram_quantile(hist, 0.99), unit,
+				(unsigned long long)histogram_quantile(hist, 0.999), unit,
+				(unsigned long long)__atomic_load_n(&hist->max,
+													__ATOMIC_RELAXED));
+	}
+
+	for (int i = 0; i < INSTRUMENT_NUM_COUNTERS; ++i)
+		fprintf(file, "counter=%s value=%llu\n", counter_names[i],
+				(unsigned long long)__atomic_load_n(&counters[i],
+													__ATOMIC_RELAXED));
+	fflush(file);
+}
+
+static void instrument_signal_handler(int signum)
+{
+	(void)signum;
+	dump_requested = 1;
+}
+
+void instrument_dump_on_signal(int signum)
+{
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = instrument_signal_handler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	DIE(sigaction(signum, &action, NULL), "failed sigaction()");
+}
+
+void instrument_poll(FILE *file)
+{
+	if (!dump_requested)
+		return;
+
+	dump_requested = 0;
+	instrument_dump(file);
+}
+
+#endif /* INSTRUMENT */
@@ -0,0 +1,192 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef INSTRUMENT_H_
+#define INSTRUMENT_H_
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @file instrument.h
+ * @brief Masurarea operatiilor load balancerului, compilata doar cu
+ * `-DINSTRUMENT` (`make INSTRUMENT=1`).
+ *
+ * Latenta fiecarei operatii este retinuta intr-o histograma in stilul HDR:
+ * bucketuri liniare in interiorul fiecarei puteri a lui 2, deci orice valoare
+ * e aproximata cu o eroare relativa de cel mult `1 / 2^(HISTOGRAM_SUB_BITS -
+ * 1)`. Histogramele si contoarele sunt actualizate cu operatii atomice, fara
+ * lockuri, deci pot fi folosite din mai multe threaduri.
+ *
+ * Fara `INSTRUMENT`, macro-urile de mai jos nu genereaza niciun cod.
+ */
+
+/** Cate bucketuri are fiecare putere a lui 2 (logaritmic) */
+#define HISTOGRAM_SUB_BITS 6
+/** Numarul de bucketuri necesare pentru orice valoare pe 64 de biti */
+#define HISTOGRAM_BUCKETS                                                      \
+	((66 - HISTOGRAM_SUB_BITS) << (HISTOGRAM_SUB_BITS - 1))
+
+/**
+ * @brief Histogramele masurate.
+ */
+typedef enum {
+	/** `loader_store` (cu `--pipeline`, stocarea pe server, in worker) */
+	INSTRUMENT_STORE,
+	/** `loader_retrieve` (cu `--pipeline`, cautarea pe server, in worker) */
+	INSTRUMENT_RETRIEVE,
+	/** `loader_remove` */
+	INSTRUMENT_REMOVE,
+	/** `loader_add_server` */
+	INSTRUMENT_ADD_SERVER,
+	/** `loader_remove_server` */
+	INSTRUMENT_REMOVE_SERVER,
+	/** `transfer_items` si `transfer_ranges` */
+	INSTRUMENT_TRANSFER,
+	/** obiectele mutate la fiecare adaugare sau stergere de server */
+	INSTRUMENT_REBALANCE_KEYS,
+	/** numarul de histograme */
+	INSTRUMENT_NUM_HISTOGRAMS,
+} instrument_histogram;
+
+/**
+ * @brief Contoarele de evenimente.
+ */
+typedef enum {
+	/** cautari pe hashring */
+	INSTRUMENT_RING_LOOKUPS,
+	/** labeluri (sau noduri ale indexului) citite de cautarile pe hashring */
+	INSTRUMENT_RING_PROBES,
+	/** cautari de chei in bucketuri sau in tabele cu adresare deschisa */
+	INSTRUMENT_CHAIN_LOOKUPS,
+	/** noduri sau pozitii parcurse de cautarile de chei */
+	INSTRUMENT_CHAIN_STEPS,
+	/** obiecte mutate intre servere (transferate sau copiate) */
+	INSTRUMENT_MOVED_KEYS,
+	/** numarul de contoare */
+	INSTRUMENT_NUM_COUNTERS,
+} instrument_counter;
+
+/**
+ * @class histogram
+ * @brief Distributia unor valori (latente in nanosecunde, numere de obiecte).
+ */
+typedef struct {
+	/** cate valori au cazut in fiecare bucket */
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	/** numarul de valori */
+	uint64_t total;
+	/** suma valorilor */
+	uint64_t sum;
+	/** cea mai mare valoare */
+	uint64_t max;
+} histogram;
+
+/**
+ * @brief Inceputul unei operatii masurate.
+ */
+typedef struct {
+	/** momentul inceperii (in nanosecunde) */
+	uint64_t start;
+	/** valoarea lui `INSTRUMENT_MOVED_KEYS` la inceput */
+	uint64_t moved;
+} instrument_span;
+
+#ifdef INSTRUMENT
+
+/**
+ * @relates histogram
+ * @brief Adauga o valoare in histograma.
+ *
+ * @param hist	histograma
+ * @param value	valoarea
+ */
+void histogram_record(histogram *hist, uint64_t value);
+
+/**
+ * @relates histogram
+ * @brief Intoarce o valoare sub care se afla o fractiune data din valorile
+ * histogramei (capatul de sus al bucketului ei, cel mult maximul).
+ *
+ * @param hist		histograma
+ * @param quantile	fractiunea (intre 0 si 1)
+ */
+uint64_t histogram_quantile(const histogram *hist, double quantile);
+
+/**
+ * @brief Incepe masurarea unei operatii.
+ *
+ * @return momentul inceperii si obiectele mutate pana atunci
+ */
+instrument_span instrument_begin(void);
+
+/**
+ * @brief Termina masurarea unei operatii, adaugand-i durata in histograma ei.
+ *
+ * @param which	histograma operatiei
+ * @param span	rezultatul lui `instrument_begin`
+ */
+void instrument_end(instrument_histogram which, const instrument_span *span);
+
+/**
+ * @brief Termina masurarea unei adaugari sau stergeri de server, retinand si
+ * cate obiecte au fost mutate intre timp (`INSTRUMENT_REBALANCE_KEYS`).
+ *
+ * @param which	histograma operatiei
+ * @param span	rezultatul lui `instrument_begin`
+ */
+void instrument_end_rebalance(instrument_histogram which,
+							  const instrument_span *span);
+
+/**
+ * @brief Aduna o valoare la un contor.
+ *
+ * @param which	contorul
+ * @param value	valoarea adunata
+ */
+void instrument_count(instrument_counter which, uint64_t value);
+
+/**
+ * @brief Scrie toate histogramele si contoarele, cate o linie de perechi
+ * `cheie=valoare` pentru fiecare.
+ *
+ * @param file fisierul in care se scrie
+ */
+void instrument_dump(FILE *file);
+
+/**
+ * @brief Cere scrierea masuratorilor (prin `instrument_poll`) la primirea
+ * unui semnal.
+ *
+ * @param signum semnalul
+ */
+void instrument_dump_on_signal(int signum);
+
+/**
+ * @brief Scrie masuratorile daca a fost primit semnalul dat la
+ * `instrument_dump_on_signal`. Scrierea nu se face direct din handlerul
+ * semnalului, pentru ca `fprintf` nu poate fi apelat de acolo.
+ *
+ * @param file fisierul in care se scrie
+ */
+void instrument_poll(FILE *file);
+
+#define INSTRUMENT_BEGIN(span) instrument_span span = instrument_begin()
+#define INSTRUMENT_END(which, span) instrument_end(which, &(span))
+#define INSTRUMENT_END_REBALANCE(which, span)                                  \
+	instrument_end_rebalance(which, &(span))
+#define INSTRUMENT_COUNT(which, value) instrument_count(which, value)
+#define INSTRUMENT_DUMP(file) instrument_dump(file)
+#define INSTRUMENT_DUMP_ON_SIGNAL(signum) instrument_dump_on_signal(signum)
+#define INSTRUMENT_POLL(file) instrument_poll(file)
+
+#else
+
+#define INSTRUMENT_BEGIN(span)
+#define INSTRUMENT_END(which, span)
+#define INSTRUMENT_END_REBALANCE(which, span)
+#define INSTRUMENT_COUNT(which, value)
+#define INSTRUMENT_DUMP(file)
+#define INSTRUMENT_DUMP_ON_SIGNAL(signum)
+#define INSTRUMENT_POLL(file)
+
+#endif /* INSTRUMENT */
+
+#endif /* INSTRUMENT_H_ */
@@ -0,0 +1,283 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <string.h>
+
+#include "keys.h"
+#include "utils.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+/** Daca se poate compila o varianta AVX2, aleasa la rulare */
+#define KEYS_AVX2 1
+#endif
+
+#define PRIME64_1 0x9e3779b185ebca87ull
+#define PRIME32_1 0x9e3779b1u
+
+/** Cheile pana la aceasta lungime sunt citite in cel mult 2 cuvinte */
+#define SHORT_KEY 16
+/** Cheile pana la aceasta lungime sunt citite in perechi de blocuri de 16
+ * bytes, de la ambele capete */
+#define MEDIUM_KEY 128
+
+/** Cheile lungi sunt procesate pe benzi de cate 64 de bytes (8 cuvinte) */
+#define STRIPE_LEN 64
+/** Dupa cate benzi se amesteca acumulatorii */
+#define STRIPES_PER_BLOCK 16
+
+/** Constante amestecate in cheie; benzile unui bloc folosesc ferestre
+ * deplasate cu cate un cuvant, iar ultimele 8 amesteca acumulatorii. */
+static const uint64_t secret[24] = {
+	0x2cb0f69f4abea221ull, 0x9417034723148989ull, 0xdd555950609dfe03ull,
+	0xdbafb150deb12800ull, 0x7e789b2e6c442cb6ull, 0xf41e5636c7e4f8c4ull,
+	0x0959d150f8fba7e4ull, 0xa97316f13cdb9eeaull, 0x74cd8258f9520068ull,
+	0x55c74a62e116868bull, 0xd2f4c799a2023cbdull, 0xdf98cb79a37b51b9ull,
+	0x396f5885524f3905ull, 0xaf1d56386ca3b276ull, 0xa9ffbe6b5104e85aull,
+	0x6bd0c51b9fd533b3ull, 0x980ce91c50ab4b56ull, 0x28ac395780fe62c5ull,
+	0x768912e3a6bcedc7ull, 0x50b3e8c9332c7c88ull, 0xce3bbfe520bd47daull,
+	0xcba6c8e8e0bb7c4full, 0xbf194db8434a346dull, 0x7d8f2a7b60416d7full,
+};
+
+/**
+ * Aduna in acumulatori `stripes` benzi consecutive; banda `i` foloseste
+ * constantele de la `keys + i`.
+ */
+typedef void (*accumulate_func)(uint64_t *acc, const unsigned char *data,
+								size_t stripes, const uint64_t *keys);
+
+static inline uint64_t read64(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t read32(const unsigned char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/** Inmulteste 2 cuvinte si combina cele 2 jumatati ale produsului. */
+static inline uint64_t mum(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 product = (unsigned __int128)a * b;
+	return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+	uint64_t lo_lo = (a & 0xffffffffu) * (b & 0xffffffffu);
+	uint64_t hi_lo = (a >> 32) * (b & 0xffffffffu);
+	uint64_t lo_hi = (a & 0xffffffffu) * (b >> 32);
+	uint64_t hi_hi = (a >> 32) * (b >> 32);
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+	uint64_t lo = (cross << 32) | (lo_lo & 0xffffffffu);
+	uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+	return lo ^ hi;
+#endif
+}
+
+static inline uint64_t avalanche(uint64_t h)
+{
+	h ^= h >> 37;
+	h *= 0x165667919e3779f9ull;
+	return h ^ (h >> 32);
+}
+
+#ifndef __SSE2__
+static void accumulate_scalar(uint64_t *acc, const unsigned char *data,
+							  size_t stripes, const uint64_t *keys)
+{
+	for (size_t s = 0; s < stripes; ++s, data += STRIPE_LEN) {
+		for (int i = 0; i < 8; ++i) {
+			uint64_t word = read64(data + 8 * i);
+			uint64_t mixed = word ^ keys[s + i];
+
+			acc[i ^ 1] += word;
+			acc[i] += (mixed & 0xffffffffu) * (mixed >> 32);
+		}
+	}
+}
+#else
+static void accumulate_sse2(uint64_t *acc, const unsigned char *data,
+							size_t stripes, const uint64_t *keys)
+{
+	__m128i lanes[4];
+
+	for (int j = 0; j < 4; ++j)
+		lanes[j] = _mm_loadu_si128((const __m128i *)(acc + 2 * j));
+
+	for (size_t s = 0; s < stripes; ++s, data += STRIPE_LEN) {
+		for (int j = 0; j < 4; ++j) {
+			__m128i word = _mm_loadu_si128((const __m128i *)(data + 16 * j));
+			__m128i key =
+				_mm_loadu_si128((const __m128i *)(keys + s + 2 * j));
+			__m128i mixed = _mm_xor_si128(word, key);
+			/* Jumatatea de sus a fiecarui cuvant, mutata jos */
+			__m128i high = _mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1));
+			__m128i product = _mm_mul_epu32(mixed, high);
+			/* Fiecare cuvant se aduna in acumulatorul vecin */
+			__m128i swapped = _mm_shuffle_epi32(word, _MM_SHUFFLE(1, 0, 3, 2));
+
+			lanes[j] =
+				_mm_add_epi64(lanes[j], _mm_add_epi64(product, swapped));
+		}
+	}
+
+	for (int j = 0; j < 4; ++j)
+		_mm_storeu_si128((__m128i *)(acc + 2 * j), lanes[j]);
+}
+#endif
+
+#ifdef KEYS_AVX2
+__attribute__((target("avx2"))) static void
+accumulate_avx2(uint64_t *acc, const unsigned char *data, size_t stripes,
+				const uint64_t *keys)
+{
+	__m256i lanes[2];
+
+	for (int j = 0; j < 2; ++j)
+		lanes[j] = _mm256_loadu_si256((const __m256i *)(acc + 4 * j));
+
+	for (size_t s = 0; s < stripes; ++s, data += STRIPE_LEN) {
+		for (int j = 0; j < 2; ++j) {
+			__m256i word =
+				_mm256_loadu_si256((const __m256i *)(data + 32 * j));
+			__m256i key =
+				_mm256_loadu_si256((const __m256i *)(keys + s + 4 * j));
+			__m256i mixed = _mm256_xor_si256(word, key);
+			__m256i high =
+				_mm256_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1));
+			__m256i product = _mm256_mul_epu32(mixed, high);
+			__m256i swapped =
+				_mm256_shuffle_epi32(word, _MM_SHUFFLE(1, 0, 3, 2));
+
+			lanes[j] = _mm256_add_epi64(lanes[j],
+										_mm256_add_epi64(product, swapped));
+		}
+	}
+
+	for (int j = 0; j < 2; ++j)
+		_mm256_storeu_si256((__m256i *)(acc + 4 * j), lanes[j]);
+}
+#endif
+
+/** Alege cea mai rapida varianta suportata de procesor. */
+static accumulate_func choose_accumulate(void)
+{
+#ifdef KEYS_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return accumulate_avx2;
+#endif
+#ifdef __SSE2__
+	return accumulate_sse2;
+#else
+	return accumulate_scalar;
+#endif
+}
+
+/** Amesteca bitii de sus ai acumulatorilor in cei de jos, dupa un bloc. */
+static inline void scramble(uint64_t *acc)
+{
+	for (int i = 0; i < 8; ++i) {
+		acc[i] ^= acc[i] >> 47;
+		acc[i] ^= secret[16 + i];
+		acc[i] *= PRIME32_1;
+	}
+}
+
+static uint64_t hash_short(const unsigned char *p, size_t len)
+{
+	uint64_t a = 0, b = 0;
+
+	if (len >= 4) {
+		/* 2 sau 4 cuvinte de 32 de biti, suprapuse pe mijloc */
+		size_t middle = (len >> 3) << 2;
+		a = (read32(p) << 32) | read32(p + middle);
+		b = (read32(p + len - 4) << 32) | read32(p + len - 4 - middle);
+	} else if (len) {
+		a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+			p[len - 1];
+	}
+
+	return mum(mum(a ^ secret[0], b ^ secret[1]) ^ secret[2],
+			   len ^ secret[3]);
+}
+
+static uint64_t hash_medium(const unsigned char *p, size_t len)
+{
+	uint64_t h = len * PRIME64_1;
+
+	/* Perechi de blocuri de 16 bytes, de la ambele capete spre mijloc */
+	for (size_t i = 0; i < (len + 31) / 32; ++i) {
+		const unsigned char *front = p + 16 * i;
+		const unsigned char *back = p + len - 16 * (i + 1);
+		const uint64_t *keys = secret + 4 * i;
+
+		h += mum(read64(front) ^ keys[0], read64(front + 8) ^ keys[1]);
+		h += mum(read64(back) ^ keys[2], read64(back + 8) ^ keys[3]);
+	}
+
+	return avalanche(h);
+}
+
+static uint64_t hash_long(const unsigned char *p, size_t len)
+{
+	static accumulate_func accumulate;
+	accumulate_func func = __atomic_load_n(&accumulate, __ATOMIC_RELAXED);
+
+	if (!func) {
+		/* Toate threadurile aleg aceeasi functie. */
+		func = choose_accumulate();
+		__atomic_store_n(&accumulate, func, __ATOMIC_RELAXED);
+	}
+
+	size_t total = len;
+	uint64_t acc[8] = {
+		PRIME32_1, PRIME64_1, secret[0], secret[1],
+		secret[2], secret[3], secret[4], PRIME64_1 ^ PRIME32_1,
+	};
+
+	/* Ultima banda (posibil incompleta) e procesata separat, suprapusa peste
+	 * cea anterioara. */
+	size_t stripes = (len - 1) / STRIPE_LEN;
+	for (; stripes >= STRIPES_PER_BLOCK; stripes -= STRIPES_PER_BLOCK) {
+		func(acc, p, STRIPES_PER_BLOCK, secret);
+		scramble(acc);
+		p += STRIPES_PER_BLOCK * STRIPE_LEN;
+		len -= STRIPES_PER_BLOCK * STRIPE_LEN;
+	}
+	func(acc, p, stripes, secret);
+	func(acc, p + len - STRIPE_LEN, 1, secret + 9);
+
+	uint64_t h = total * PRIME64_1;
+	for (int i = 0; i < 4; ++i)
+		h += mum(acc[2 * i] ^ secret[2 * i + 1],
+				 acc[2 * i + 1] ^ secret[2 * i + 2]);
+
+	return avalanche(h);
+}
+
+unsigned int key_hash_bytes(const void *key, size_t len)
+{
+	const unsigned char *p = key;
+	uint64_t h;
+
+	if (len <= SHORT_KEY)
+		h = hash_short(p, len);
+	else if (len <= MEDIUM_KEY)
+		h = hash_medium(p, len);
+	else
+		h = hash_long(p, len);
+
+	return (unsigned int)(h ^ (h >> 32));
+}
+
+unsigned int key_hash(key_hash_mode mode, const char *key)
+{
+	if (mode == KEY_HASH_FAST)
+		return key_hash_bytes(key, strlen(key));
+	return hash_function_key((void *)key);
+}
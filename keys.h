@@ -0,0 +1,114 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef KEYS_H_
+#define KEYS_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @file keys.h
+ * @brief Hashuri si comparatii de chei.
+ */
+
+/** Lungimea maxima a cheilor comparate inline de `keys_equal` */
+#define KEYS_INLINE_COMPARE 32
+
+/**
+ * @brief Functia cu care se calculeaza hashul cheilor. Hashul decide serverul
+ * pe care ajunge o cheie, deci toate cheile unui load balancer trebuie sa
+ * foloseasca aceeasi functie.
+ */
+typedef enum {
+	/** djb2, byte cu byte (`hash_function_key`), modul compatibil */
+	KEY_HASH_DJB2,
+	/** functie care proceseaza cheia pe cuvinte de 64 de biti, iar pe
+	 * cheile lungi pe benzi de 64 de bytes, cu SSE2/AVX2 daca procesorul le
+	 * suporta */
+	KEY_HASH_FAST,
+} key_hash_mode;
+
+/**
+ * @brief Calculeaza hashul unei chei de lungime cunoscuta cu functia
+ * `KEY_HASH_FAST`. Rezultatul nu depinde de setul de instructiuni folosit.
+ *
+ * @param key	cheia
+ * @param len	lungimea cheii (in bytes)
+ *
+ * @return hashul calculat
+ */
+unsigned int key_hash_bytes(const void *key, size_t len);
+
+/**
+ * @brief Calculeaza hashul unui string cu functia aleasa.
+ *
+ * @param mode	functia de hash
+ * @param key	cheia (terminata cu '\0')
+ *
+ * @return hashul calculat
+ */
+unsigned int key_hash(key_hash_mode mode, const char *key);
+
+/**
+ * @brief Compara 2 chei cu aceeasi lungime (lungimile, retinute separat, se
+ * compara inainte). Cheile scurte sunt comparate inline, din cel mult 2 citiri
+ * (suprapuse) de 8 sau 16 bytes, fara apel de functie; cheile mai lungi de
+ * `KEYS_INLINE_COMPARE` bytes sunt comparate cu `memcmp`, care foloseste deja
+ * instructiuni vectoriale.
+ *
+ * @param a		prima cheie
+ * @param b		a 2-a cheie
+ * @param size	lungimea comuna a cheilor
+ *
+ * @return daca cheile sunt egale
+ */
+static inline bool keys_equal(const void *a, const void *b, size_t size)
+{
+	const unsigned char *x = a, *y = b;
+
+	if (size > KEYS_INLINE_COMPARE)
+		return memcmp(x, y, size) == 0;
+
+#ifdef __SSE2__
+	if (size >= 16) {
+		__m128i front = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)x),
+									   _mm_loadu_si128((const __m128i *)y));
+		__m128i back = _mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i *)(x + size - 16)),
+			_mm_loadu_si128((const __m128i *)(y + size - 16)));
+		return _mm_movemask_epi8(_mm_and_si128(front, back)) == 0xffff;
+	}
+#else
+	if (size >= 16)
+		return memcmp(x, y, size) == 0;
+#endif
+
+	if (size >= 8) {
+		uint64_t u, v, p, q;
+		memcpy(&u, x, 8);
+		memcpy(&v, y, 8);
+		memcpy(&p, x + size - 8, 8);
+		memcpy(&q, y + size - 8, 8);
+		return !((u ^ v) | (p ^ q));
+	}
+	if (size >= 4) {
+		uint32_t u, v, p, q;
+		memcpy(&u, x, 4);
+		memcpy(&v, y, 4);
+		memcpy(&p, x + size - 4, 4);
+		memcpy(&q, y + size - 4, 4);
+		return !((u ^ v) | (p ^ q));
+	}
+
+	for (size_t i = 0; i < size; ++i) {
+		if (x[i] != y[i])
+			return false;
+	}
+	return true;
+}
+
+#endif /* KEYS_H_ */
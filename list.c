@@ -1,19 +1,51 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
+#include "instrument.h"
 #include "list.h"
-#include "utils.h"
 
-list *list_create_node(void *key, void *value)
+list *list_create_node(slab *allocator, void *key, unsigned int key_size,
+					   unsigned int hash, void *value, unsigned int value_size)
 {
-	list *node = malloc(sizeof(list));
-	DIE(!node, "failed malloc() of list");
+	list *node = slab_alloc(allocator, list_record_size(key_size, value_size));
+	uint32_t size = value_size;
 
-	node->info.key = key;
-	node->info.data = value;
+	node->info.hash = hash;
+	node->info.key_size = key_size;
+
+	char *data = list_data(node);
+	memcpy(list_key(node), key, key_size);
+	memcpy(data - sizeof(size), &size, sizeof(size));
+	memcpy(data, value, value_size);
+	data[value_size] = '\0';
 
 	node->next = NULL;
+	node->left = NULL;
+	node->right = NULL;
 	return node;
 }
 
+list *list_copy_node(slab *allocator, list *node)
+{
+	size_t size = list_node_size(node);
+	list *copy = slab_alloc(allocator, size);
+
+	memcpy(copy, node, size);
+	copy->next = NULL;
+	copy->left = NULL;
+	copy->right = NULL;
+	return copy;
+}
+
+void list_free_node(list *node)
+{
+	slab_free(node);
+}
+
+size_t list_node_size(list *node)
+{
+	return list_record_size(node->info.key_size,
+							dict_data_size(list_data(node)));
+}
+
 void list_push(list **l, list *node)
 {
 	if (!*l) {
@@ -26,25 +58,30 @@ void list_push(list **l, list *node)
 	*l = node;
 }
 
-void *list_get_item(list *l, void *key, int (*compare_func)(void *, void *))
+void *list_get_item(list *l, void *key, unsigned int key_size,
+					unsigned int hash)
 {
+	INSTRUMENT_COUNT(INSTRUMENT_CHAIN_LOOKUPS, 1);
 	while (l) {
-		if (compare_func(l->info.key, key) == 0)
-			return l->info.data;
+		INSTRUMENT_COUNT(INSTRUMENT_CHAIN_STEPS, 1);
+		if (dict_entry_has_key(&l->info, key, key_size, hash))
+			return list_data(l);
 		l = l->next;
 	}
 
 	return NULL;
 }
 
-list *list_extract_item(list **l, void *key,
-						int (*compare_func)(void *, void *))
+list *list_extract_item(list **l, void *key, unsigned int key_size,
+						unsigned int hash)
 {
 	list *prev = NULL;
 	list *curr = *l;
 
+	INSTRUMENT_COUNT(INSTRUMENT_CHAIN_LOOKUPS, 1);
 	while (curr) {
-		if (compare_func(curr->info.key, key) == 0) {
+		INSTRUMENT_COUNT(INSTRUMENT_CHAIN_STEPS, 1);
+		if (dict_entry_has_key(&curr->info, key, key_size, hash)) {
 			if (prev)
 				prev->next = curr->next;
 			else
@@ -59,28 +96,33 @@ list *list_extract_item(list **l, void *key,
 	return NULL;
 }
 
-void list_split(list *src, list **accepted, list **rejected,
-				unsigned int min_hash, unsigned int max_hash)
+bool list_extract_node(list **l, list *node)
 {
-	while (src) {
-		list *curr = src;
-		src = src->next;
-
-		unsigned int hash = hash_function_key(curr->info.key);
-		if (min_hash <= hash && hash < max_hash)
-			list_push(accepted, curr);
-		else
-			list_push(rejected, curr);
+	list *prev = NULL;
+	list *curr = *l;
+
+	while (curr) {
+		if (curr == node) {
+			if (prev)
+				prev->next = curr->next;
+			else
+				*l = curr->next;
+			return true;
+		}
+
+		prev = curr;
+		curr = curr->next;
 	}
+
+	return false;
 }
 
-void list_destroy(list *l, void (*destructor_func)(void *, void *))
+void list_destroy(list *l)
 {
 	while (l) {
 		list *next = l->next;
 
-		destructor_func(l->info.key, l->info.data);
-		free(l);
+		list_free_node(l);
 		l = next;
 	}
 }
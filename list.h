@@ -1,40 +1,183 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
 #ifndef LIST_H_
 #define LIST_H_
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "keys.h"
+#include "slab.h"
 
 /**
  * @class dict_entry
- * @brief O pereche (cheie, valoare) stocata intr-un hashtable.
+ * @brief Antetul unei perechi (cheie, valoare) stocate intr-un hashtable.
+ *
+ * Perechea este o inregistrare compacta, copiata imediat dupa nodul de lista:
+ * cheia (`key_size` bytes), lungimea valorii (pe 4 bytes), valoarea si un
+ * `'\0'` dupa ea. Lungimea fiind retinuta separat, valoarea poate contine
+ * si bytes nuli, iar `'\0'`-ul final o face utilizabila si ca sir de
+ * caractere.
  */
 typedef struct {
-	/** cheia stocata */
-	void *key;
-	/** informatiile asociate cheii */
-	void *data;
+	/** hashul cheii, calculat o singura data, la prima stocare */
+	unsigned int hash;
+	/** dimensiunea cheii (in bytes) */
+	unsigned int key_size;
 } dict_entry;
 
 /**
  * @class list
  * @brief Nod al unei liste simplu inlantuite.
+ *
+ * Nodul este si intrarea din indexul ordonat dupa hash al hashtable-ului
+ * (vezi `hash_index.h`). Cheia si valoarea sunt copiate in acelasi bloc de
+ * memorie, imediat dupa nod (vezi `dict_entry`).
  */
 typedef struct list {
 	/** informatia stocata (perechi cheie, valoare) */
 	dict_entry info;
 	/** referinta la urmatorul element din lista */
 	struct list *next;
+	/** subarborii din indexul ordonat dupa hash */
+	struct list *left, *right;
 } list;
 
 /**
  * @relates list
- * @brief Aloca un nod nou.
+ * @brief Intoarce cheia stocata in nod, aflata imediat dupa acesta.
+ *
+ * @param node nodul
+ */
+static inline char *list_key(const list *node)
+{
+	return (char *)(node + 1);
+}
+
+/**
+ * @relates list
+ * @brief Intoarce valoarea stocata in nod (urmata de un `'\0'`).
+ *
+ * @param node nodul
+ */
+static inline char *list_data(const list *node)
+{
+	return list_key(node) + node->info.key_size + sizeof(uint32_t);
+}
+
+/**
+ * @relates dict_entry
+ * @brief Intoarce cheia intrarii (vezi `list_key`; intrarea este primul camp
+ * al nodului).
+ *
+ * @param entry intrarea
+ */
+static inline char *dict_entry_key(const dict_entry *entry)
+{
+	return list_key((const list *)entry);
+}
+
+/**
+ * @relates dict_entry
+ * @brief Intoarce valoarea intrarii (vezi `list_data`).
+ *
+ * @param entry intrarea
+ */
+static inline char *dict_entry_data(const dict_entry *entry)
+{
+	return list_data((const list *)entry);
+}
+
+/**
+ * @relates dict_entry
+ * @brief Intoarce lungimea unei valori stocate, din prefixul aflat inaintea
+ * ei.
+ *
+ * @param data valoarea, asa cum a fost intoarsa de `dict_entry_data`
+ */
+static inline unsigned int dict_data_size(const void *data)
+{
+	uint32_t size;
+
+	memcpy(&size, (const char *)data - sizeof(size), sizeof(size));
+	return size;
+}
+
+/**
+ * @relates dict_entry
+ * @brief Verifica daca intrarea are o anumita cheie. Hashul si dimensiunea
+ * sunt comparate inaintea cheii propriu-zise.
+ *
+ * @param entry		intrarea verificata
+ * @param key		cheia cautata
+ * @param key_size	dimensiunea cheii cautate
+ * @param hash		hashul cheii cautate
+ */
+static inline bool dict_entry_has_key(const dict_entry *entry, const void *key,
+									  unsigned int key_size, unsigned int hash)
+{
+	return entry->hash == hash && entry->key_size == key_size &&
+		   keys_equal(dict_entry_key(entry), key, key_size);
+}
+
+/**
+ * @relates list
+ * @brief Calculeaza dimensiunea inregistrarii unei perechi (cheie, valoare),
+ * inclusiv nodul care o precede.
  *
- * @param key 	cheia noului nod
- * @param value valoarea noului nod
+ * @param key_size		dimensiunea cheii
+ * @param value_size	dimensiunea valorii
+ */
+static inline size_t list_record_size(unsigned int key_size,
+									  unsigned int value_size)
+{
+	return sizeof(list) + key_size + sizeof(uint32_t) + value_size + 1;
+}
+
+/**
+ * @relates list
+ * @brief Aloca un nod nou, care contine copii ale cheii si valorii.
+ *
+ * @param allocator		alocatorul din care se ia memoria nodului
+ * @param key 			cheia noului nod
+ * @param key_size		dimensiunea cheii
+ * @param hash			hashul cheii
+ * @param value 		valoarea noului nod
+ * @param value_size	dimensiunea valorii (fara un eventual `'\0'` final,
+ * 						care este adaugat oricum)
  *
  * @return	adresa noului nod
  */
-list *list_create_node(void *key, void *value);
+list *list_create_node(slab *allocator, void *key, unsigned int key_size,
+					   unsigned int hash, void *value, unsigned int value_size);
+
+/**
+ * @relates list
+ * @brief Copiaza inregistrarea unui nod (cheia, valoarea si hashul) intr-un
+ * bloc nou, fara legaturile acestuia.
+ *
+ * @param allocator		alocatorul din care se ia memoria copiei
+ * @param node			nodul copiat
+ *
+ * @return	adresa copiei
+ */
+list *list_copy_node(slab *allocator, list *node);
+
+/**
+ * @relates list
+ * @brief Elibereaza un nod (impreuna cu cheia si valoarea sa).
+ *
+ * @param node nodul eliberat
+ */
+void list_free_node(list *node);
+
+/**
+ * @relates list
+ * @brief Calculeaza dimensiunea blocului de memorie al unui nod.
+ *
+ * @param node nodul
+ */
+size_t list_node_size(list *node);
 
 /**
  * @relates list
@@ -49,52 +192,50 @@ void list_push(list **l, list *node);
  * @relates list
  * @brief Cauta in lista un element cu o cheie data.
  *
- * @param l 			lista in care se cauta
- * @param key 			cheia cautata
- * @param compare_func	functia de comparare a cheilor
+ * @param l 		lista in care se cauta
+ * @param key 		cheia cautata
+ * @param key_size	dimensiunea cheii
+ * @param hash		hashul cheii
  *
  * @return		valoarea asociata cheii
  * @retval NULL	nu exista un element cu acea cheie
  */
-void *list_get_item(list *l, void *key,
-					int (*compare_func)(void *key1, void *key2));
+void *list_get_item(list *l, void *key, unsigned int key_size,
+					unsigned int hash);
 
 /**
  * @relates list
  * @brief Extrage un element cu o anumita cheie, eliminandu-l din lista.
  *
- * @param[in, out] 	l				lista
- * @param[in] 		key				cheia elementului cautat
- * @param[in] 		compare_func	functia de comparare a cheilor
+ * @param[in, out] 	l			lista
+ * @param[in] 		key			cheia elementului cautat
+ * @param[in] 		key_size	dimensiunea cheii
+ * @param[in] 		hash		hashul cheii
 
  * @return		nodul de lista care contine elementul cautat
  * @retval NULL nu a fost gasit elementul cautat
  */
-list *list_extract_item(list **l, void *key,
-						int (*compare_func)(void *key1, void *key2));
+list *list_extract_item(list **l, void *key, unsigned int key_size,
+						unsigned int hash);
 
 /**
  * @relates list
- * @brief Imparte lista data in alte 2 liste, in functie de hashurile cheilor
- * elementelor.
+ * @brief Scoate un nod dat din lista.
  *
- * @param[in]	src			lista originala
- * @param[out]	accepted	lista cu elementele care au hashul cuprins intre
- *							`min_hash` si `max_hash`
- * @param[out]	rejected	lista cu elementele ramase
- * @param[in]	min_hash	valoarea minima a hashului
- * @param[in]	max_hash	valoarea maxima a hashului
+ * @param[in, out]	l		lista
+ * @param[in]		node	nodul scos
+
+ * @retval true		nodul a fost scos
+ * @retval false	nodul nu se afla in lista
  */
-void list_split(list *src, list **accepted, list **rejected,
-				unsigned int min_hash, unsigned int max_hash);
+bool list_extract_node(list **l, list *node);
 
 /**
  * @relates list
  * @brief Elibereaza lista si toate elementele pe care le contine.
  *
- * @param l					lista
- * @param destructor_func	functia de eliberare a datelor stocate
+ * @param l lista
  */
-void list_destroy(list *l, void (*destructor_func)(void *key, void *data));
+void list_destroy(list *l);
 
 #endif /* LIST_H_ */
@@ -1,20 +1,136 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "epoch.h"
+#include "hash_index.h"
 #include "hashring.h"
 #include "hashtable.h"
+#include "instrument.h"
+#include "keys.h"
 #include "load_balancer.h"
+#include "placement.h"
 #include "server.h"
 #include "utils.h"
 
-/** De cate ori e replicat fiecare server */
-#define REPLICA_NUM 3
+/** Numarul implicit de labeluri ale unui server cu ponderea 1 */
+#define DEFAULT_VIRTUAL_NODES 3
+
+/** Labelul `nth` al serverului `id` este, daca e liber, `nth * LABEL_STRIDE +
+ * id` */
+#define LABEL_STRIDE 100000
+
+/** Multiplicatorul cu care se cauta un label liber (cu un increment impar,
+ * generatorul trece prin toate cele 2^32 labeluri) */
+#define LABEL_PROBE_MULTIPLIER 2654435761u
 
 /** Pragul de umplere/golire la care se redimensioneaza hashringul */
 #define REALLOC_FACTOR 2
 
+/** Cu cate chei inainte sunt aduse in cache nodurile cheilor dintr-un grup
+ * (bucketurile sunt aduse cu inca atatea chei inainte) */
+#define BATCH_PREFETCH_DISTANCE 8
+
+/** Cate obiecte se muta la fiecare operatie, cat timp hashringul se
+ * rebalanseaza */
+#define REBALANCE_STEP 64
+
+/** Dimensiunea initiala a directorului cheilor mutate de pe servere pline */
+#define DISPLACED_BUCKETS 64
+#define DISPLACED_LOAD_FACTOR 1.0
+
+/**
+ * @brief O copie a hashringului, care nu se mai modifica dupa publicare (in
+ * afara de `previous`, sters la terminarea mutarilor).
+ */
+typedef struct hashring_snapshot {
+	/** hashringul dinaintea schimbarii in curs, ale carui servere pot inca
+	 * detine obiectele care se muta (NULL daca nu se muta obiecte) */
+	struct hashring_snapshot *previous;
+	/** numarul de labeluri */
+	size_t size;
+	/** indexul de cautare al labelurilor */
+	hashring_lookup lookup;
+	/** tabela de salt (daca e folosita in locul indexului) */
+	hashring_jump jump;
+	/** labelurile, sortate dupa hash */
+	hashring_entry entries[];
+} hashring_snapshot;
+
+/**
+ * @brief Un server din load balancer, impreuna cu labelurile sale.
+ */
+typedef struct {
+	/** id-ul serverului */
+	int id;
+	/** ponderea serverului */
+	unsigned int weight;
+	/** numarul de labeluri */
+	size_t num_labels;
+	/** labelurile de pe hashring */
+	unsigned int *labels;
+	/** serverul */
+	server_memory *server;
+	/** numarul de cautari servite (cu replici) */
+	size_t reads;
+} server_info;
+
+/**
+ * @brief Un interval de hashuri mutat intre 2 servere la o schimbare a
+ * hashringului.
+ */
+typedef struct {
+	/** serverul destinatie */
+	server_memory *dest;
+	/** serverul sursa */
+	server_memory *src;
+	/** hashurile mutate */
+	hash_range range;
+} ring_move;
+
+/** Operatie aplicata deodata pe mai multe intervale de hashuri, intre 2
+ * servere (`transfer_ranges`, `copy_ranges`, `remove_ranges`). */
+typedef size_t (*range_func)(server_memory *dest, server_memory *src,
+							 const hash_range *ranges, size_t count);
+
+/**
+ * @brief O cheie dintr-un grup procesat de `loader_store_batch` sau
+ * `loader_retrieve_batch`.
+ */
+typedef struct {
+	/** serverul caruia ii revine cheia */
+	server_memory *server;
+	/** id-ul serverului */
+	int server_id;
+	/** hashul cheii */
+	unsigned int hash;
+	/** pozitia cheii in grup */
+	size_t index;
+} batch_entry;
+
+/**
+ * @brief Un interval de hashuri ale carui obiecte inca trebuie mutate intre 2
+ * servere. O intrare fara `dest` marcheaza un server sters, eliberat dupa ce
+ * se termina mutarile de dinaintea ei.
+ */
+typedef struct migration {
+	/** serverul destinatie (NULL pentru un server sters) */
+	server_memory *dest;
+	/** serverul sursa */
+	server_memory *src;
+	/** primul hash care nu a fost inca mutat */
+	unsigned int min_hash;
+	/** sfarsitul (exclusiv) al intervalului */
+	unsigned int max_hash;
+
+	/** urmatoarea mutare, care se face dupa aceasta */
+	struct migration *next;
+} migration;
+
 struct load_balancer {
 	/** vector circular care retine etichetele
 		asociate serverelor din load balancer */
@@ -23,165 +139,1749 @@ struct load_balancer {
 	size_t hashring_capacity;
 	/** numarul de servere existente pe hashring */
 	size_t hashring_size;
+	/** indexul de cautare al hashringului (daca nu exista cititori
+	 * concurenti, care folosesc indexul copiei publicate) */
+	hashring_lookup lookup;
+	/** tabela de salt a hashringului, actualizata la fiecare schimbare a
+	 * acestuia (`table` e NULL daca nu e folosita) */
+	hashring_jump jump;
+
+	/** serverele, sortate dupa id */
+	server_info *servers;
+	/** numarul de servere */
+	size_t num_servers;
+	/** dimensiunea alocata a lui `servers` */
+	size_t servers_capacity;
+	/** suma ponderilor serverelor */
+	unsigned long total_weight;
+	/** numarul de labeluri ale unui server cu ponderea 1 */
+	unsigned int virtual_nodes;
+	/** strategia care repartizeaza cheile, daca nu se foloseste hashringul
+	 * (`PLACEMENT_RING`) */
+	placement placement;
+	/** pe cate servere distincte, consecutive pe hashring, se afla fiecare
+	 * obiect */
+	size_t replicas;
+	/** replicile unei chei, gasite la ultima operatie (`replicas` labeluri) */
+	hashring_entry **replica_set;
+
+	/** modul de stocare folosit de serverele nou adaugate */
+	ht_engine storage_engine;
+	/** functia de hash a cheilor */
+	key_hash_mode key_hash;
+
+	/** domeniul prin care se elibereaza memoria vizibila cititorilor
+	 * concurenti (NULL daca acestia nu sunt activati) */
+	epoch *reclaimer;
+	/** copia hashringului vazuta de cititorii concurenti */
+	hashring_snapshot *snapshot;
+
+	/** daca load balancerul poate fi modificat din mai multe threaduri */
+	bool locking;
+	/** serializeaza adaugarile si stergerile de servere */
+	pthread_mutex_t ring_lock;
+
+	/** daca obiectele se muta treptat dupa schimbarile hashringului */
+	bool online_rebalancing;
+	/** mutarile ramase, in ordinea in care se fac */
+	migration *migrations;
+	/** ultima mutare din lista */
+	migration *last_migration;
+	/** numarul de intervale mutate complet */
+	size_t completed_ranges;
+	/** numarul de obiecte mutate treptat */
+	size_t moved_keys;
+
+	/** daca niciun server nu poate primi mai mult de `(1 + epsilon)` ori
+	 * media obiectelor per server */
+	bool bounded;
+	/** cat poate depasi un server media */
+	double epsilon;
+	/** numarul total de obiecte (doar cu incarcarea limitata) */
+	size_t num_keys;
+	/** serverul pe care a ajuns fiecare obiect stocat pe alt server decat
+	 * cel caruia ii revine (cheie -> id) */
+	hashtable *displaced;
 };
 
 /**
- * @brief Calculeaza labelul replicii `id` a labelului `nth`.
+ * @brief Cauta pozitia labelului caruia ii revine un hash, prin tabela de
+ * salt daca exista, altfel prin indexul Eytzinger.
+ */
+static inline size_t ring_find(hashring_entry *hashring, size_t size,
+							   const hashring_lookup *lookup,
+							   const hashring_jump *jump, unsigned int hash)
+{
+	if (jump->table)
+		return hashring_jump_find(jump, hashring, size, hash);
+	return hashring_lookup_find(lookup, hash);
+}
+
+/** Pozitia primului label cu hashul cel putin `hash` (`size` daca nu
+ * exista). */
+static size_t ring_lower_bound(hashring_entry *hashring, size_t size,
+							   unsigned int hash)
+{
+	size_t left = 0, right = size;
+
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+		if (hashring[middle].hash < hash)
+			left = middle + 1;
+		else
+			right = middle;
+	}
+
+	return left;
+}
+
+/**
+ * @brief Gaseste primele `count` servere distincte de pe hashring, in sensul
+ * acelor de ceasornic, incepand cu labelul `index`.
+ *
+ * @return numarul de servere gasite (mai mic daca nu exista destule)
+ */
+static size_t ring_successors(hashring_entry *hashring, size_t size,
+							  size_t index, size_t count,
+							  hashring_entry **found)
+{
+	size_t num_found = 0;
+
+	for (size_t step = 0; step < size && num_found < count; ++step) {
+		hashring_entry *entry = &hashring[(index + step) % size];
+
+		size_t i = 0;
+		while (i < num_found && found[i]->server != entry->server)
+			++i;
+		if (i == num_found)
+			found[num_found++] = entry;
+	}
+
+	return num_found;
+}
+
+/** Compara 2 mutari dupa servere, apoi dupa interval. */
+static int compare_ring_moves(const void *a, const void *b)
+{
+	const ring_move *x = a, *y = b;
+
+	if (x->src != y->src)
+		return (uintptr_t)x->src < (uintptr_t)y->src ? -1 : 1;
+	if (x->dest != y->dest)
+		return (uintptr_t)x->dest < (uintptr_t)y->dest ? -1 : 1;
+	if (x->range.min_hash != y->range.min_hash)
+		return x->range.min_hash < y->range.min_hash ? -1 : 1;
+	return 0;
+}
+
+/** Gaseste labelul caruia ii revine un hash pe o copie a hashringului. */
+static inline hashring_entry *snapshot_find(hashring_snapshot *snapshot,
+											unsigned int hash)
+{
+	return &snapshot->entries[ring_find(snapshot->entries, snapshot->size,
+										&snapshot->lookup, &snapshot->jump,
+										hash)];
+}
+
+/** Elibereaza o copie a hashringului, impreuna cu indexul ei. */
+static void free_snapshot(void *ptr)
+{
+	hashring_snapshot *snapshot = ptr;
+
+	hashring_lookup_destroy(&snapshot->lookup);
+	hashring_jump_destroy(&snapshot->jump);
+	free(snapshot);
+}
+
+/**
+ * @brief Reconstruieste indexul de cautare dupa o schimbare a hashringului.
+ * Pentru cititorii concurenti, publica o copie a hashringului, cu indexul ei.
+ * Copia nu se mai modifica, deci poate fi parcursa fara lock.
+ *
+ * @param main		load balancerul
+ * @param moving	daca urmeaza sa se mute obiecte: pana la
+ *					`loader_finish_moves`, copia le spune cititorilor sa caute
+ *					si pe hashringul anterior
+ */
+static void loader_publish_ring(load_balancer *main, bool moving)
+{
+	if (main->jump.table)
+		hashring_jump_update(&main->jump, main->hashring, main->hashring_size);
+
+	if (!main->reclaimer) {
+		/* Tabela de salt este deja actualizata. */
+		if (!main->jump.table)
+			hashring_lookup_build(&main->lookup, main->hashring,
+								  main->hashring_size);
+		return;
+	}
+
+	hashring_snapshot *snapshot =
+		malloc(sizeof(hashring_snapshot) +
+			   main->hashring_size * sizeof(hashring_entry));
+	DIE(!snapshot, "failed malloc() of hashring_snapshot");
+
+	snapshot->size = main->hashring_size;
+	memcpy(snapshot->entries, main->hashring,
+		   main->hashring_size * sizeof(hashring_entry));
+	snapshot->lookup = (hashring_lookup){0};
+	snapshot->jump = (hashring_jump){0};
+	if (main->jump.table)
+		hashring_jump_copy(&snapshot->jump, &main->jump);
+	else
+		hashring_lookup_build(&snapshot->lookup, snapshot->entries,
+							  snapshot->size);
+
+	hashring_snapshot *old_snapshot = main->snapshot;
+	snapshot->previous = moving ? old_snapshot : NULL;
+	__atomic_store_n(&main->snapshot, snapshot, __ATOMIC_RELEASE);
+	if (old_snapshot && !moving)
+		epoch_retire(main->reclaimer, old_snapshot, free_snapshot);
+}
+
+/**
+ * @brief Dupa mutarea obiectelor, cititorii concurenti nu mai trebuie sa caute
+ * si pe hashringul anterior, care este retras.
+ */
+static void loader_finish_moves(load_balancer *main)
+{
+	if (!main->reclaimer || !main->snapshot->previous)
+		return;
+
+	hashring_snapshot *previous = main->snapshot->previous;
+	__atomic_store_n(&main->snapshot->previous, NULL, __ATOMIC_RELEASE);
+	epoch_retire(main->reclaimer, previous, free_snapshot);
+}
+
+/**
+ * @brief Incepe o schimbare a hashringului. Schimbarile sunt facute pe rand,
+ * pe hashringul propriu load balancerului, care nu e vazut de celelalte
+ * operatii.
+ */
+static inline void ring_lock(load_balancer *main)
+{
+	if (main->locking)
+		pthread_mutex_lock(&main->ring_lock);
+}
+
+static inline void ring_unlock(load_balancer *main)
+{
+	if (main->locking)
+		pthread_mutex_unlock(&main->ring_lock);
+
+	if (main->reclaimer)
+		epoch_collect(main->reclaimer);
+}
+
+/**
+ * @brief Blocheaza serverele implicate intr-o schimbare a hashringului, pana
+ * la terminarea mutarilor, pentru celelalte threaduri care le modifica (nu si
+ * pentru cititori, vezi `server_hold`). Serverele care apar de mai multe ori
+ * sunt blocate o singura data.
+ *
+ * @return numarul de servere distincte, ramase la inceputul lui `servers`
+ */
+static size_t lock_servers(server_memory **servers, size_t count)
+{
+	size_t distinct = 0;
+	for (size_t i = 0; i < count; ++i) {
+		size_t j = 0;
+		while (j < distinct && servers[j] != servers[i])
+			++j;
+		if (j < distinct)
+			continue;
+
+		servers[distinct++] = servers[i];
+		server_hold(servers[i]);
+	}
+
+	return distinct;
+}
+
+static void unlock_servers(server_memory **servers, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		server_release(servers[i]);
+}
+
+static void free_server_callback(void *server)
+{
+	free_server_memory(server);
+}
+
+/** Pozitia (in `servers`) serverului cu un id, sau pe care ar fi inserat. */
+static size_t loader_server_index(load_balancer *main, int server_id)
+{
+	size_t left = 0, right = main->num_servers;
+
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+		if (main->servers[middle].id < server_id)
+			left = middle + 1;
+		else
+			right = middle;
+	}
+
+	return left;
+}
+
+/** Gaseste serverul cu un id (NULL daca nu exista). */
+static server_info *loader_find_info(load_balancer *main, int server_id)
+{
+	size_t index = loader_server_index(main, server_id);
+
+	if (index < main->num_servers && main->servers[index].id == server_id)
+		return &main->servers[index];
+	return NULL;
+}
+
+/** Verifica daca un label se afla deja pe hashring. */
+static bool loader_has_label(load_balancer *main, unsigned int label)
+{
+	unsigned int hash = hash_function_servers(&label);
+	size_t index = ring_lower_bound(main->hashring, main->hashring_size, hash);
+
+	/* Functia de hash e bijectiva, deci labelurile diferite au hashuri
+	 * diferite. */
+	return index < main->hashring_size && main->hashring[index].hash == hash;
+}
+
+/** Adauga un server in director, pastrandu-l sortat dupa id. */
+static void loader_insert_info(load_balancer *main, server_info info)
+{
+	if (main->num_servers == main->servers_capacity) {
+		main->servers_capacity =
+			main->servers_capacity ? REALLOC_FACTOR * main->servers_capacity
+								   : 1;
+		main->servers = realloc(main->servers, main->servers_capacity *
+												   sizeof(server_info));
+		DIE(!main->servers, "failed realloc() of load_balancer.servers");
+	}
+
+	size_t index = loader_server_index(main, info.id);
+	memmove(&main->servers[index + 1], &main->servers[index],
+			(main->num_servers - index) * sizeof(server_info));
+	main->servers[index] = info;
+	++main->num_servers;
+	main->total_weight += info.weight;
+}
+
+/** Sterge serverul de pe pozitia `index` din director. */
+static void loader_erase_info(load_balancer *main, size_t index)
+{
+	main->total_weight -= main->servers[index].weight;
+	free(main->servers[index].labels);
+
+	--main->num_servers;
+	memmove(&main->servers[index], &main->servers[index + 1],
+			(main->num_servers - index) * sizeof(server_info));
+}
+
+/**
+ * @brief Genereaza labelurile unui server nou. Labelul `nth` este
+ * `nth * LABEL_STRIDE + id` (ca inainte de ponderi), iar daca acesta e deja
+ * folosit (de exemplu, pentru id-uri de peste `LABEL_STRIDE`), se cauta
+ * pseudo-aleator altul, pana se gaseste unul liber.
+ */
+static unsigned int *loader_make_labels(load_balancer *main, int server_id,
+										size_t count)
+{
+	unsigned int *labels = malloc(count * sizeof(unsigned int));
+	DIE(!labels && count, "failed malloc() of server_info.labels");
+
+	for (size_t nth = 0; nth < count; ++nth) {
+		unsigned int label =
+			(unsigned int)(nth * LABEL_STRIDE) + (unsigned int)server_id;
+
+		for (;;) {
+			size_t i = 0;
+			while (i < nth && labels[i] != label)
+				++i;
+			if (i == nth && !loader_has_label(main, label))
+				break;
+
+			label = label * LABEL_PROBE_MULTIPLIER + 1;
+		}
+
+		labels[nth] = label;
+	}
+
+	return labels;
+}
+
+load_balancer *init_load_balancer()
+{
+	load_balancer *lb = malloc(sizeof(load_balancer));
+	DIE(!lb, "failed malloc() of load_balancer");
+
+	lb->hashring_capacity = DEFAULT_VIRTUAL_NODES;
+	lb->hashring_size = 0;
+	lb->servers = NULL;
+	lb->num_servers = 0;
+	lb->servers_capacity = 0;
+	lb->total_weight = 0;
+	lb->virtual_nodes = DEFAULT_VIRTUAL_NODES;
+	placement_init(&lb->placement, PLACEMENT_RING);
+	lb->replicas = 1;
+	lb->replica_set = NULL;
+	lb->lookup = (hashring_lookup){0};
+	lb->jump = (hashring_jump){0};
+	lb->storage_engine = HT_ENGINE_CHAINED;
+	lb->key_hash = KEY_HASH_DJB2;
+	lb->reclaimer = NULL;
+	lb->snapshot = NULL;
+	lb->locking = false;
+	lb->online_rebalancing = false;
+	lb->migrations = NULL;
+	lb->last_migration = NULL;
+	lb->completed_ranges = 0;
+	lb->moved_keys = 0;
+	lb->bounded = false;
+	lb->epsilon = 0;
+	lb->num_keys = 0;
+	lb->displaced = NULL;
+
+	lb->hashring = calloc(lb->hashring_capacity, sizeof(hashring_entry));
+	DIE(!lb->hashring, "failed malloc() of load_balancer.hashring");
+
+	return lb;
+}
+
+void loader_set_storage_engine(load_balancer *main, ht_engine engine)
+{
+	main->storage_engine = engine;
+}
+
+void loader_set_virtual_nodes(load_balancer *main, unsigned int count)
+{
+	DIE(!count, "a server needs at least one label");
+	main->virtual_nodes = count;
+}
+
+void loader_set_key_hash(load_balancer *main, key_hash_mode mode)
+{
+	/* Cheile deja stocate au fost repartizate dupa vechea functie. */
+	DIE(main->num_servers && mode != main->key_hash,
+		"cannot change the key hash of a load balancer with servers");
+
+	main->key_hash = mode;
+}
+
+void loader_set_placement(load_balancer *main, placement_strategy strategy)
+{
+	if (strategy == main->placement.strategy)
+		return;
+	DIE(main->num_servers,
+		"cannot change the placement of a load balancer with servers");
+	DIE(strategy != PLACEMENT_RING &&
+			(main->reclaimer || main->jump.table || main->bounded),
+		"only the hashring supports this mode");
+
+	DIE(strategy != PLACEMENT_RING && main->replicas > 1,
+		"only the hashring supports this mode");
+
+	placement_init(&main->placement, strategy);
+}
+
+void loader_set_replicas(load_balancer *main, size_t count)
+{
+	DIE(!count, "an object needs at least one replica");
+	if (count == main->replicas)
+		return;
+	DIE(main->num_servers,
+		"cannot change the replicas of a load balancer with servers");
+	DIE(count > 1 && (main->reclaimer || main->online_rebalancing ||
+					  main->bounded ||
+					  main->placement.strategy != PLACEMENT_RING),
+		"replicas are only supported by the sequential hashring");
+
+	main->replicas = count;
+	main->replica_set =
+		realloc(main->replica_set, count * sizeof(hashring_entry *));
+	DIE(!main->replica_set, "failed malloc() of load_balancer.replica_set");
+}
+
+void loader_enable_concurrent_reads(load_balancer *main)
+{
+	if (main->reclaimer)
+		return;
+	DIE(main->online_rebalancing,
+		"online rebalancing does not support concurrent access");
+	DIE(main->bounded, "bounded loads do not support concurrent access");
+	DIE(main->placement.strategy != PLACEMENT_RING,
+		"only the hashring supports this mode");
+	DIE(main->replicas > 1,
+		"replicas are only supported by the sequential hashring");
+
+	main->reclaimer = epoch_create();
+	for (size_t i = 0; i < main->num_servers; ++i)
+		server_set_reclaimer(main->servers[i].server, main->reclaimer);
+
+	/* De acum se foloseste doar indexul copiilor publicate. */
+	hashring_lookup_destroy(&main->lookup);
+	loader_publish_ring(main, false);
+}
+
+void loader_enable_jump_table(load_balancer *main)
+{
+	if (main->jump.table)
+		return;
+	DIE(main->placement.strategy != PLACEMENT_RING,
+		"only the hashring supports this mode");
+
+	ring_lock(main);
+	hashring_jump_build(&main->jump, main->hashring, main->hashring_size);
+	hashring_lookup_destroy(&main->lookup);
+	loader_publish_ring(main, false);
+	ring_unlock(main);
+}
+
+void loader_enable_locking(load_balancer *main)
+{
+	if (main->locking)
+		return;
+
+	loader_enable_concurrent_reads(main);
+	DIE(pthread_mutex_init(&main->ring_lock, NULL),
+		"failed pthread_mutex_init() of load_balancer.ring_lock");
+
+	for (size_t i = 0; i < main->num_servers; ++i)
+		server_enable_locking(main->servers[i].server);
+
+	main->locking = true;
+}
+
+void loader_enable_online_rebalancing(load_balancer *main)
+{
+	DIE(main->reclaimer,
+		"online rebalancing does not support concurrent access");
+	DIE(main->bounded, "bounded loads do not support online rebalancing");
+	DIE(main->replicas > 1,
+		"replicas are only supported by the sequential hashring");
+	main->online_rebalancing = true;
+}
+
+void loader_enable_bounded_loads(load_balancer *main, double epsilon)
+{
+	DIE(main->reclaimer, "bounded loads do not support concurrent access");
+	DIE(main->online_rebalancing,
+		"bounded loads do not support online rebalancing");
+	DIE(epsilon < 0, "the load bound cannot be below the average");
+	DIE(main->placement.strategy != PLACEMENT_RING,
+		"only the hashring supports this mode");
+	DIE(main->replicas > 1,
+		"replicas are only supported by the sequential hashring");
+
+	main->epsilon = epsilon;
+	if (main->bounded)
+		return;
+
+	main->displaced = ht_create(HT_ENGINE_CHAINED, DISPLACED_BUCKETS,
+								DISPLACED_LOAD_FACTOR);
+	DIE(!main->displaced, "failed malloc() of load_balancer.displaced");
+
+	main->num_keys = 0;
+	for (size_t i = 0; i < main->num_servers; ++i)
+		main->num_keys += server_size(main->servers[i].server);
+	main->bounded = true;
+}
+
+/**
+ * @brief Numarul maxim de obiecte pe un server: `(1 + epsilon)` ori media
+ * ponderata cu ponderea serverului, rotunjit in sus (deci exista mereu un
+ * server sub limita).
+ */
+static size_t loader_capacity(load_balancer *main, unsigned int weight)
+{
+	double bound = (1 + main->epsilon) * main->num_keys * weight /
+				   main->total_weight;
+	size_t capacity = bound;
+
+	return capacity < bound ? capacity + 1 : capacity;
+}
+
+/** Gaseste serverul cu un anumit id. */
+static server_memory *loader_find_id(load_balancer *main, int server_id)
+{
+	return loader_find_info(main, server_id)->server;
+}
+
+/** Verifica daca un server mai poate primi obiecte noi. */
+static bool loader_has_room(load_balancer *main, hashring_entry *entry)
+{
+	server_info *info = loader_find_info(main, entry->id);
+
+	return server_size(entry->server) < loader_capacity(main, info->weight);
+}
+
+/**
+ * @brief Stocheaza un obiect nou pe serverul caruia ii revine sau, daca acesta
+ * e plin, pe primul server sub limita, in sensul acelor de ceasornic.
+ * Obiectele ajunse pe alt server sunt trecute in director.
+ *
+ * @return labelul serverului pe care a fost stocat obiectul
+ */
+static hashring_entry *loader_place(load_balancer *main, char *key,
+									unsigned int hash, char *value,
+									unsigned int value_size)
+{
+	size_t size = main->hashring_size;
+	size_t index = ring_find(main->hashring, size, &main->lookup, &main->jump,
+							 hash);
+	server_memory *owner = main->hashring[index].server;
+
+	size_t step = 0;
+	while (step < size &&
+		   !loader_has_room(main, &main->hashring[(index + step) % size]))
+		++step;
+	DIE(step == size, "no server below the load bound");
+
+	hashring_entry *server = &main->hashring[(index + step) % size];
+	if (server->server == owner) {
+		server_store(owner, key, hash, value, value_size);
+	} else {
+		server_store_displaced(server->server, key, hash, value, value_size);
+		ht_store_item(main->displaced, key, strlen(key) + 1, hash,
+					  &server->id, sizeof(server->id));
+	}
+
+	return server;
+}
+
+/**
+ * @brief Stocheaza un obiect fara ca serverul sa depaseasca limita. O cheie
+ * existenta este inlocuita pe serverul pe care se afla deja.
+ */
+static void loader_store_bounded(load_balancer *main, char *key,
+								 unsigned int hash, char *value,
+								 unsigned int value_size, int *server_id)
+{
+	hashring_entry *owner = &main->hashring[ring_find(
+		main->hashring, main->hashring_size, &main->lookup, &main->jump,
+		hash)];
+
+	if (server_retrieve(owner->server, key, hash)) {
+		server_store(owner->server, key, hash, value, value_size);
+		*server_id = owner->id;
+		return;
+	}
+
+	/* Id-ul e copiat imediat dupa cheie, deci poate sa nu fie aliniat. */
+	char *host = ht_retrieve_item(main->displaced, key, strlen(key) + 1, hash);
+	if (host) {
+		memcpy(server_id, host, sizeof(int));
+		server_store_displaced(loader_find_id(main, *server_id), key, hash,
+							   value, value_size);
+		return;
+	}
+
+	++main->num_keys;
+	*server_id = loader_place(main, key, hash, value, value_size)->id;
+}
+
+/** Cauta in director un obiect stocat pe alt server decat cel caruia ii
+ * revine. */
+static char *loader_retrieve_displaced(load_balancer *main, char *key,
+									   unsigned int hash, int *server_id)
+{
+	if (!ht_size(main->displaced))
+		return NULL;
+
+	char *host = ht_retrieve_item(main->displaced, key, strlen(key) + 1, hash);
+	if (!host)
+		return NULL;
+
+	memcpy(server_id, host, sizeof(int));
+	return server_retrieve_displaced(loader_find_id(main, *server_id), key,
+									 hash);
+}
+
+/** Sterge un obiect, de pe serverul caruia ii revine sau din director. */
+static bool loader_remove_bounded(load_balancer *main, char *key,
+								  unsigned int hash)
+{
+	hashring_entry *owner = &main->hashring[ring_find(
+		main->hashring, main->hashring_size, &main->lookup, &main->jump,
+		hash)];
+	bool removed = server_remove(owner->server, key, hash);
+
+	char *host = removed ? NULL
+						 : ht_retrieve_item(main->displaced, key,
+											strlen(key) + 1, hash);
+	if (host) {
+		int server_id;
+		memcpy(&server_id, host, sizeof(int));
+		removed = server_remove_displaced(loader_find_id(main, server_id),
+										  key, hash);
+		ht_remove_item(main->displaced, key, strlen(key) + 1, hash);
+	}
+
+	if (removed)
+		--main->num_keys;
+	return removed;
+}
+
+/** Stocheaza din nou, in limita, un obiect al unui server sters. */
+static void loader_replace_callback(dict_entry *entry, void *arg)
+{
+	load_balancer *main = arg;
+
+	char *key = dict_entry_key(entry);
+	char *data = dict_entry_data(entry);
+
+	ht_remove_item(main->displaced, key, entry->key_size, entry->hash);
+	loader_place(main, key, entry->hash, data, dict_data_size(data));
+}
+
+/**
+ * @brief Pune in coada mutarea obiectelor cu hashul in `[min_hash, max_hash)`
+ * din `src` in `dest`, facuta treptat, la operatiile urmatoare.
+ */
+static void loader_queue_move(load_balancer *main, server_memory *dest,
+							  server_memory *src, unsigned int min_hash,
+							  unsigned int max_hash)
+{
+	if (dest == src || min_hash >= max_hash)
+		return;
+
+	migration *move = malloc(sizeof(migration));
+	DIE(!move, "failed malloc() of migration");
+
+	move->dest = dest;
+	move->src = src;
+	move->min_hash = min_hash;
+	move->max_hash = max_hash;
+	move->next = NULL;
+
+	if (main->last_migration)
+		main->last_migration->next = move;
+	else
+		main->migrations = move;
+	main->last_migration = move;
+}
+
+/**
+ * @brief Elibereaza un server scos de pe hashring, dupa ce nu mai poate fi
+ * accesat de cititorii concurenti si nici de mutarile ramase.
+ */
+static void loader_release_server(load_balancer *main, server_memory *server)
+{
+	if (main->online_rebalancing) {
+		loader_queue_move(main, NULL, server, 0, 1);
+		return;
+	}
+
+	/* Cititorii concurenti pot inca sa caute pe serverul sters. */
+	if (main->reclaimer)
+		epoch_retire(main->reclaimer, server, free_server_callback);
+	else
+		free_server_memory(server);
+}
+
+size_t loader_rebalance_step(load_balancer *main, size_t max_keys)
+{
+	size_t moved = 0;
+
+	while (main->migrations && moved < max_keys) {
+		migration *move = main->migrations;
+
+		if (move->dest) {
+			/* Intervalul se muta pe bucati, ca fiecare pas sa fie scurt. */
+			unsigned int bound =
+				server_range_bound(move->src, move->min_hash, move->max_hash,
+								   max_keys - moved);
+
+			server_lock(move->dest);
+			server_lock(move->src);
+			moved += transfer_items(move->dest, move->src, move->min_hash,
+									bound);
+			server_unlock(move->src);
+			server_unlock(move->dest);
+
+			move->min_hash = bound;
+			if (bound != move->max_hash)
+				continue;
+			++main->completed_ranges;
+		} else {
+			free_server_memory(move->src);
+		}
+
+		main->migrations = move->next;
+		if (!main->migrations)
+			main->last_migration = NULL;
+		free(move);
+	}
+
+	main->moved_keys += moved;
+	return moved;
+}
+
+void loader_rebalance_progress(load_balancer *main,
+							   rebalance_progress *progress)
+{
+	progress->pending_ranges = 0;
+	progress->pending_servers = 0;
+	progress->remaining_keys = 0;
+	progress->completed_ranges = main->completed_ranges;
+	progress->moved_keys = main->moved_keys;
+
+	for (migration *move = main->migrations; move; move = move->next) {
+		if (!move->dest) {
+			++progress->pending_servers;
+			continue;
+		}
+
+		++progress->pending_ranges;
+		progress->remaining_keys +=
+			server_count_range(move->src, move->min_hash, move->max_hash);
+	}
+}
+
+/**
+ * @brief Cauta o cheie pe un server si, daca nu o gaseste, pe serverele de
+ * pe care inca se muta spre acesta intervale care contin hashul cheii. Se
+ * urmeaza doar mutarile de dinaintea lui `limit`, pentru ca obiectele trec
+ * prin mutari in ordinea acestora.
+ */
+static char *loader_find_moving(load_balancer *main, server_memory *server,
+								char *key, unsigned int hash, migration *limit)
+{
+	char *value = server_retrieve(server, key, hash);
+
+	for (migration *move = main->migrations; !value && move != limit;
+		 move = move->next) {
+		if (move->dest == server &&
+			hash_in_range(hash, move->min_hash, move->max_hash))
+			value = loader_find_moving(main, move->src, key, hash, move);
+	}
+
+	return value;
+}
+
+/**
+ * @brief Sterge copiile vechi ale unei chei de pe serverele de pe care
+ * aceasta inca s-ar muta spre `server`, pentru ca o valoare stocata acum sa
+ * nu fie acoperita de una mutata mai tarziu.
+ *
+ * @return daca a fost stearsa vreo copie
+ */
+static bool loader_drop_moving(load_balancer *main, server_memory *server,
+							   char *key, unsigned int hash, migration *limit)
+{
+	bool removed = false;
+
+	for (migration *move = main->migrations; move != limit;
+		 move = move->next) {
+		if (move->dest != server ||
+			!hash_in_range(hash, move->min_hash, move->max_hash))
+			continue;
+
+		removed |= server_remove(move->src, key, hash);
+		removed |= loader_drop_moving(main, move->src, key, hash, move);
+	}
+
+	return removed;
+}
+
+epoch_reader *loader_register_reader(load_balancer *main)
+{
+	return epoch_register(main->reclaimer);
+}
+
+void loader_unregister_reader(epoch_reader *reader)
+{
+	epoch_unregister(reader);
+}
+
+void loader_read_begin(load_balancer *main, epoch_reader *reader)
+{
+	epoch_enter(main->reclaimer, reader);
+}
+
+void loader_read_end(epoch_reader *reader)
+{
+	epoch_exit(reader);
+}
+
+void free_load_balancer(load_balancer *main)
+{
+	for (size_t i = 0; i < main->num_servers; ++i) {
+		free_server_memory(main->servers[i].server);
+		free(main->servers[i].labels);
+	}
+	free(main->servers);
+
+	if (main->reclaimer) {
+		free_snapshot(main->snapshot);
+		epoch_destroy(main->reclaimer);
+	}
+	hashring_lookup_destroy(&main->lookup);
+	hashring_jump_destroy(&main->jump);
+	placement_destroy(&main->placement);
+	free(main->replica_set);
+	if (main->bounded)
+		ht_destroy(main->displaced);
+	if (main->locking)
+		pthread_mutex_destroy(&main->ring_lock);
+
+	while (main->migrations) {
+		migration *move = main->migrations;
+		if (!move->dest)
+			free_server_memory(move->src);
+
+		main->migrations = move->next;
+		free(move);
+	}
+
+	free(main->hashring);
+	free(main);
+}
+
+/**
+ * @brief Gaseste serverul caruia ii revine un hash, pe hashring sau prin
+ * strategia de repartizare aleasa (fara cititori concurenti).
  */
-static inline unsigned int get_nth_replica(unsigned int id, int nth)
+static server_memory *loader_find_owner(load_balancer *main, unsigned int hash,
+										int *server_id)
 {
-	return nth * 1e5 + id;
+	if (main->placement.strategy != PLACEMENT_RING) {
+		placement_member *member = placement_find(&main->placement, hash);
+		*server_id = member->id;
+		return member->server;
+	}
+
+	hashring_entry *server = &main->hashring[ring_find(
+		main->hashring, main->hashring_size, &main->lookup, &main->jump, hash)];
+	*server_id = server->id;
+	return server->server;
 }
 
-load_balancer *init_load_balancer()
+/**
+ * @brief Gaseste si blocheaza serverul caruia ii revine un hash. Daca
+ * hashringul s-a schimbat pana la obtinerea lockului, serverul s-ar putea sa
+ * nu mai detina hashul, deci cautarea se reia.
+ */
+static server_memory *loader_lock_owner(load_balancer *main, unsigned int hash,
+										int *server_id)
 {
-	load_balancer *lb = malloc(sizeof(load_balancer));
-	DIE(!lb, "failed malloc() of load_balancer");
+	if (!main->reclaimer) {
+		server_memory *server = loader_find_owner(main, hash, server_id);
+		server_lock(server);
+		return server;
+	}
 
-	lb->hashring_capacity = REPLICA_NUM;
-	lb->hashring_size = 0;
+	for (;;) {
+		hashring_snapshot *snapshot =
+			__atomic_load_n(&main->snapshot, __ATOMIC_ACQUIRE);
+		hashring_entry *server = snapshot_find(snapshot, hash);
 
-	lb->hashring = calloc(lb->hashring_capacity, sizeof(hashring_entry));
-	DIE(!lb->hashring, "failed malloc() of load_balancer.hashring");
+		/* O schimbare care implica serverul il tine blocat pana termina
+		 * mutarile, iar noul hashring este publicat inainte de acestea. */
+		server_lock(server->server);
+		if (__atomic_load_n(&main->snapshot, __ATOMIC_ACQUIRE) == snapshot) {
+			*server_id = server->id;
+			return server->server;
+		}
+		server_unlock(server->server);
+	}
+}
 
-	return lb;
+/** Gaseste replicile unui hash, in `replica_set`, si le intoarce numarul. */
+static size_t loader_find_replicas(load_balancer *main, unsigned int hash)
+{
+	size_t index = ring_find(main->hashring, main->hashring_size,
+							 &main->lookup, &main->jump, hash);
+
+	return ring_successors(main->hashring, main->hashring_size, index,
+						   main->replicas, main->replica_set);
 }
 
-void free_load_balancer(load_balancer *main)
+void loader_store(load_balancer *main, char *key, char *value, int *server_id)
 {
-	for (size_t i = 0; i < main->hashring_size; ++i) {
-		hashring_entry *curr_entry = &main->hashring[i];
-		/* Serverul a fost deja sters */
-		if (!curr_entry->server)
-			continue;
+	loader_store_value(main, key, value, strlen(value), server_id);
+}
+
+/** Stocheaza un obiect (`loader_store_value`, fara masurare). */
+static void store_value(load_balancer *main, char *key, char *value,
+						size_t value_size, int *server_id)
+{
+	unsigned int hash = key_hash(main->key_hash, key);
+	if (main->bounded) {
+		loader_store_bounded(main, key, hash, value, value_size, server_id);
+		return;
+	}
+	if (main->replicas > 1) {
+		size_t count = loader_find_replicas(main, hash);
+		for (size_t i = 0; i < count; ++i)
+			server_store(main->replica_set[i]->server, key, hash, value,
+						 value_size);
+		*server_id = main->replica_set[0]->id;
+		return;
+	}
+	if (main->migrations)
+		loader_rebalance_step(main, REBALANCE_STEP);
+
+	server_memory *server = loader_lock_owner(main, hash, server_id);
+	if (main->migrations)
+		loader_drop_moving(main, server, key, hash, NULL);
+	server_store(server, key, hash, value, value_size);
+	server_unlock(server);
+}
+
+void loader_store_value(load_balancer *main, char *key, char *value,
+						size_t value_size, int *server_id)
+{
+	DIE(value_size > UINT32_MAX, "value too large");
+
+	INSTRUMENT_BEGIN(span);
+	store_value(main, key, value, value_size, server_id);
+	INSTRUMENT_END(INSTRUMENT_STORE, span);
+}
+
+size_t loader_value_size(char *value)
+{
+	return dict_data_size(value);
+}
 
-		free_server_memory(curr_entry->server);
-		curr_entry->server = NULL;
+server_memory *loader_route(load_balancer *main, char *key, unsigned int *hash,
+							int *server_id)
+{
+	DIE(main->reclaimer || main->online_rebalancing || main->replicas > 1 ||
+			main->bounded,
+		"keys have no fixed server in this mode");
+
+	*hash = key_hash(main->key_hash, key);
+	return loader_find_owner(main, *hash, server_id);
+}
 
-		/* Seteaza si celelalte replici ca fiind sterse */
-		for (int j = 0; j < REPLICA_NUM; ++j) {
-			unsigned int replica_label = get_nth_replica(curr_entry->id, j);
-			unsigned int replica_hash = hash_function_servers(&replica_label);
+/**
+ * @brief Cauta o cheie fara lock, concurent cu threadurile care modifica load
+ * balancerul. Noul hashring este publicat inaintea mutarii obiectelor, iar
+ * cat timp acestea se muta, o cheie este cautata intai pe serverul ei de pe
+ * hashringul anterior, apoi pe cel nou. Fiecare obiect ajunge pe serverul nou
+ * inainte sa fie scos de pe cel vechi, deci o cheie care lipseste de pe
+ * serverul vechi se afla deja pe cel nou. Daca intre timp s-a publicat alt
+ * hashring, cautarea se reia.
+ */
+static char *loader_lookup(load_balancer *main, char *key, unsigned int hash,
+						   int *server_id)
+{
+	for (;;) {
+		hashring_snapshot *snapshot =
+			__atomic_load_n(&main->snapshot, __ATOMIC_ACQUIRE);
+		hashring_snapshot *previous =
+			__atomic_load_n(&snapshot->previous, __ATOMIC_ACQUIRE);
+		hashring_entry *server = snapshot_find(snapshot, hash);
 
-			hashring_entry *replica = find_server(
-				main->hashring, main->hashring_size, replica_hash, false);
+		char *value = NULL;
+		if (previous) {
+			hashring_entry *old = snapshot_find(previous, hash);
+			if (old->server != server->server)
+				value = server_lookup(old->server, key, hash);
+		}
+		if (!value)
+			value = server_lookup(server->server, key, hash);
 
-			replica->server = NULL;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&main->snapshot, __ATOMIC_RELAXED) == snapshot) {
+			*server_id = server->id;
+			return value;
 		}
 	}
+}
 
-	free(main->hashring);
-	free(main);
+/** Cauta o cheie pe replica ei care a servit cele mai putine cautari. */
+static char *loader_retrieve_replica(load_balancer *main, char *key,
+									 unsigned int hash, int *server_id)
+{
+	size_t count = loader_find_replicas(main, hash);
+	server_info *least = loader_find_info(main, main->replica_set[0]->id);
+
+	for (size_t i = 1; i < count; ++i) {
+		server_info *info = loader_find_info(main, main->replica_set[i]->id);
+		if (info->reads < least->reads)
+			least = info;
+	}
+
+	++least->reads;
+	*server_id = least->id;
+	return server_retrieve(least->server, key, hash);
 }
 
-void loader_store(load_balancer *main, char *key, char *value, int *server_id)
+/** Cauta un obiect (`loader_retrieve`, fara masurare). */
+static char *retrieve_value(load_balancer *main, char *key, int *server_id)
 {
-	unsigned int hash = hash_function_key(key);
+	unsigned int hash = key_hash(main->key_hash, key);
+	if (main->reclaimer)
+		return loader_lookup(main, key, hash, server_id);
+	if (main->replicas > 1)
+		return loader_retrieve_replica(main, key, hash, server_id);
+	if (main->migrations)
+		loader_rebalance_step(main, REBALANCE_STEP);
 
-	hashring_entry *server =
-		find_server(main->hashring, main->hashring_size, hash, true);
-	*server_id = server->id;
-	server_store(server->server, key, value);
+	server_memory *server = loader_find_owner(main, hash, server_id);
+	char *value = loader_find_moving(main, server, key, hash, NULL);
+	if (!value && main->bounded)
+		value = loader_retrieve_displaced(main, key, hash, server_id);
+	return value;
 }
 
 char *loader_retrieve(load_balancer *main, char *key, int *server_id)
 {
-	unsigned int hash = hash_function_key(key);
+	INSTRUMENT_BEGIN(span);
+	char *value = retrieve_value(main, key, server_id);
+	INSTRUMENT_END(INSTRUMENT_RETRIEVE, span);
 
-	hashring_entry *server =
-		find_server(main->hashring, main->hashring_size, hash, true);
-	*server_id = server->id;
-	return server_retrieve(server->server, key);
+	return value;
 }
 
-void loader_add_server(load_balancer *main, int server_id)
+/** Sterge un obiect (`loader_remove`, fara masurare). */
+static bool remove_key(load_balancer *main, char *key)
 {
-	server_memory *server = init_server_memory();
+	unsigned int hash = key_hash(main->key_hash, key);
+	if (main->bounded)
+		return loader_remove_bounded(main, key, hash);
 
-	size_t server_count = main->hashring_size;
-	main->hashring_size += REPLICA_NUM;
+	bool removed = false;
+	if (main->replicas > 1) {
+		size_t count = loader_find_replicas(main, hash);
+		for (size_t i = 0; i < count; ++i)
+			removed |= server_remove(main->replica_set[i]->server, key, hash);
+		return removed;
+	}
+	if (main->migrations)
+		loader_rebalance_step(main, REBALANCE_STEP);
 
-	/* Se dubleaza capacitatea hashringului cand se umple. */
-	if (main->hashring_size > main->hashring_capacity) {
-		main->hashring_capacity *= REALLOC_FACTOR;
-		main->hashring = realloc(main->hashring, sizeof(hashring_entry) *
-													 main->hashring_capacity);
-		DIE(!main->hashring,
-			"failed realloc() (extending) of load_balancer.hashring");
+	int server_id;
+	server_memory *server = loader_lock_owner(main, hash, &server_id);
+	if (main->migrations)
+		removed = loader_drop_moving(main, server, key, hash, NULL);
+	removed |= server_remove(server, key, hash);
+	server_unlock(server);
+
+	return removed;
+}
+
+bool loader_remove(load_balancer *main, char *key)
+{
+	INSTRUMENT_BEGIN(span);
+	bool removed = remove_key(main, key);
+	INSTRUMENT_END(INSTRUMENT_REMOVE, span);
+
+	return removed;
+}
+
+/** Compara 2 chei dintr-un grup dupa server, apoi dupa pozitie. */
+static int compare_batch_entries(const void *a, const void *b)
+{
+	const batch_entry *x = a, *y = b;
+
+	if (x->server != y->server)
+		return (uintptr_t)x->server < (uintptr_t)y->server ? -1 : 1;
+	if (x->index != y->index)
+		return x->index < y->index ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Repartizeaza pe servere un grup de chei, sortandu-le dupa server
+ * (si, pe acelasi server, dupa pozitia din grup).
+ */
+static batch_entry *loader_plan_batch(load_balancer *main, char **keys,
+									  size_t count)
+{
+	batch_entry *batch = malloc(count * sizeof(batch_entry));
+	DIE(!batch && count, "failed malloc() of batch");
+
+	for (size_t i = 0; i < count; ++i)
+		batch[i].hash = key_hash(main->key_hash, keys[i]);
+
+	for (size_t i = 0; i < count; ++i) {
+		batch[i].server =
+			loader_find_owner(main, batch[i].hash, &batch[i].server_id);
+		batch[i].index = i;
 	}
 
-	for (int i = 0; i < REPLICA_NUM; ++i) {
-		unsigned int label = get_nth_replica(server_id, i);
-		unsigned int hash = hash_function_servers(&label);
+	qsort(batch, count, sizeof(batch_entry), compare_batch_entries);
+	return batch;
+}
 
-		hashring_entry new_label = {
-			.id = server_id,
-			.hash = hash,
-			.label = label,
-			.server = server,
-		};
+/**
+ * @brief Aduce in cache datele cheilor care urmeaza dupa cheia `i`: nodurile
+ * cheii de la distanta `BATCH_PREFETCH_DISTANCE` (al caror bucket a fost adus
+ * anterior), respectiv bucketurile celei de la distanta dubla.
+ */
+static inline void loader_prefetch_batch(batch_entry *batch, size_t count,
+										 size_t i)
+{
+	size_t node = i + BATCH_PREFETCH_DISTANCE;
+	size_t bucket = i + 2 * BATCH_PREFETCH_DISTANCE;
+
+	if (bucket < count)
+		server_prefetch_bucket(batch[bucket].server, batch[bucket].hash);
+	if (node < count)
+		server_prefetch_node(batch[node].server, batch[node].hash);
+}
+
+void loader_store_batch(load_balancer *main, char **keys, char **values,
+						size_t count, int *server_ids)
+{
+	if (main->reclaimer || main->migrations || main->bounded ||
+		main->replicas > 1) {
+		for (size_t i = 0; i < count; ++i)
+			loader_store(main, keys[i], values[i], &server_ids[i]);
+		return;
+	}
+
+	batch_entry *batch = loader_plan_batch(main, keys, count);
+	for (size_t i = 0; i < 2 * BATCH_PREFETCH_DISTANCE && i < count; ++i)
+		server_prefetch_bucket(batch[i].server, batch[i].hash);
+
+	for (size_t i = 0; i < count; ++i) {
+		loader_prefetch_batch(batch, count, i);
+
+		/* Serverul ramane blocat pe tot grupul sau de chei. */
+		if (!i || batch[i].server != batch[i - 1].server)
+			server_lock(batch[i].server);
+
+		size_t index = batch[i].index;
+		server_store(batch[i].server, keys[index], batch[i].hash,
+					 values[index], strlen(values[index]));
+		server_ids[index] = batch[i].server_id;
+
+		if (i + 1 == count || batch[i].server != batch[i + 1].server)
+			server_unlock(batch[i].server);
+	}
+
+	free(batch);
+}
+
+void loader_retrieve_batch(load_balancer *main, char **keys, size_t count,
+						   char **values, int *server_ids)
+{
+	if (main->reclaimer || main->migrations || main->bounded ||
+		main->replicas > 1) {
+		for (size_t i = 0; i < count; ++i)
+			values[i] = loader_retrieve(main, keys[i], &server_ids[i]);
+		return;
+	}
+
+	batch_entry *batch = loader_plan_batch(main, keys, count);
+	for (size_t i = 0; i < 2 * BATCH_PREFETCH_DISTANCE && i < count; ++i)
+		server_prefetch_bucket(batch[i].server, batch[i].hash);
+
+	for (size_t i = 0; i < count; ++i) {
+		loader_prefetch_batch(batch, count, i);
+
+		size_t index = batch[i].index;
+		values[index] =
+			server_retrieve(batch[i].server, keys[index], batch[i].hash);
+		server_ids[index] = batch[i].server_id;
+	}
+
+	free(batch);
+}
+
+/** Dintre 2 labeluri (oricare poate lipsi), il alege pe cel cu hashul mai
+ * mic. */
+static hashring_entry *ring_min(hashring_entry *a, hashring_entry *b)
+{
+	if (!a || !b)
+		return a ? a : b;
+	return a->hash < b->hash ? a : b;
+}
+
+/** Dintre 2 labeluri (oricare poate lipsi), il alege pe cel cu hashul mai
+ * mare. */
+static hashring_entry *ring_max(hashring_entry *a, hashring_entry *b)
+{
+	if (!a || !b)
+		return a ? a : b;
+	return a->hash > b->hash ? a : b;
+}
+
+/**
+ * @brief Aplica o operatie pe intervalele unor mutari, o singura data pentru
+ * fiecare pereche de servere, cu toate intervalele dintre acestea.
+ */
+static void apply_ranges(ring_move *moves, size_t count, range_func func)
+{
+	qsort(moves, count, sizeof(ring_move), compare_ring_moves);
+
+	hash_range *ranges = malloc(count * sizeof(hash_range));
+	DIE(!ranges && count, "failed malloc() of transferred ranges");
+
+	for (size_t i = 0, j; i < count; i = j) {
+		size_t num_ranges = 0;
+		for (j = i; j < count && moves[j].src == moves[i].src &&
+					moves[j].dest == moves[i].dest;
+			 ++j)
+			ranges[num_ranges++] = moves[j].range;
+
+		func(moves[i].dest, moves[i].src, ranges, num_ranges);
+	}
+
+	free(ranges);
+}
+
+/**
+ * Muta intervalele pe bucati de cel mult `REBALANCE_STEP` obiecte, cu
+ * serverele marcate ca modificate (`server_write_begin`) doar cat dureaza o
+ * bucata, deci cititorii concurenti nu asteapta tot transferul.
+ */
+static size_t transfer_ranges_stepwise(server_memory *dest, server_memory *src,
+									   const hash_range *ranges, size_t count)
+{
+	size_t moved = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		unsigned int min_hash = ranges[i].min_hash, bound;
+		do {
+			bound = server_range_bound(src, min_hash, ranges[i].max_hash,
+									   REBALANCE_STEP);
+
+			server_write_begin(dest);
+			server_write_begin(src);
+			moved += transfer_items(dest, src, min_hash, bound);
+			server_write_end(src);
+			server_write_end(dest);
+
+			min_hash = bound;
+		} while (bound != ranges[i].max_hash);
+	}
 
-		if (server_count == 0) {
-			main->hashring[0] = new_label;
-			++server_count;
+	return moved;
+}
+
+/** Sterge de pe `src` intervalele date (`dest` nu e folosit). */
+static size_t remove_ranges(server_memory *dest, server_memory *src,
+							const hash_range *ranges, size_t count)
+{
+	(void)dest;
+	return server_remove_ranges(src, ranges, count);
+}
+
+/**
+ * @brief Executa mutarile produse de o schimbare a hashringului: treptat, in
+ * ordinea in care au fost generate, sau, altfel, printr-un singur transfer
+ * pentru fiecare pereche de servere, cu toate intervalele dintre acestea (pe
+ * bucati, daca serverele pot fi citite concurent).
+ */
+static void loader_apply_moves(load_balancer *main, ring_move *moves,
+							   size_t count)
+{
+	if (main->online_rebalancing) {
+		for (size_t i = 0; i < count; ++i)
+			loader_queue_move(main, moves[i].dest, moves[i].src,
+							  moves[i].range.min_hash, moves[i].range.max_hash);
+		return;
+	}
+
+	apply_ranges(moves, count,
+				 main->reclaimer ? transfer_ranges_stepwise : transfer_ranges);
+}
+
+/**
+ * @brief Blocheaza serverele dintre care se muta obiecte la o schimbare a
+ * hashringului (vezi `lock_servers`).
+ *
+ * @return serverele blocate, de eliberat cu `unlock_servers`
+ */
+static server_memory **lock_moves(server_memory *server, ring_move *moves,
+								  size_t count, size_t *num_involved)
+{
+	server_memory **involved = malloc((2 * count + 1) * sizeof(void *));
+	DIE(!involved, "failed malloc() of involved servers");
+
+	involved[0] = server;
+	for (size_t i = 0; i < count; ++i) {
+		involved[2 * i + 1] = moves[i].src;
+		involved[2 * i + 2] = moves[i].dest;
+	}
+
+	*num_involved = lock_servers(involved, 2 * count + 1);
+	return involved;
+}
+
+/** Adauga o operatie pe un interval, unind-o cu ultima daca o continua. */
+static void push_range(ring_move *moves, size_t *count, server_memory *dest,
+					   server_memory *src, unsigned int min_hash,
+					   unsigned int max_hash)
+{
+	ring_move *last = *count ? &moves[*count - 1] : NULL;
+
+	if (last && last->dest == dest && last->src == src &&
+		last->range.max_hash == min_hash)
+		last->range.max_hash = max_hash;
+	else
+		moves[(*count)++] = (ring_move){dest, src, {min_hash, max_hash}};
+}
+
+/** Verifica daca un server se afla printre replicile gasite. */
+static bool has_replica(hashring_entry **replicas, size_t count,
+						server_memory *server)
+{
+	for (size_t i = 0; i < count; ++i) {
+		if (replicas[i]->server == server)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Reface replicile dupa o schimbare a hashringului. Fiecare interval
+ * dintre 2 labeluri consecutive (de pe oricare dintre cele 2 hashringuri)
+ * trebuie sa se afle pe primele `replicas` servere distincte care il urmeaza.
+ * Serverele care ies din replicile unui interval le cedeaza obiectele celor
+ * care intra, celelalte servere care intra primesc copii de la o replica
+ * ramasa, iar celelalte servere care ies le sterg.
+ *
+ * @param main		load balancerul, cu noul hashring
+ * @param old		hashringul dinainte de schimbare
+ * @param old_size	numarul de labeluri de pe `old`
+ * @param removed	serverul sters (eliberat ulterior), sau NULL
+ */
+static void loader_replicate(load_balancer *main, hashring_entry *old,
+							 size_t old_size, server_memory *removed)
+{
+	hashring_entry *ring = main->hashring;
+	size_t size = main->hashring_size, replicas = main->replicas;
+	if (!old_size || !size)
+		return;
+
+	size_t max_bounds = old_size + size + 1, max_ops = max_bounds * replicas;
+	unsigned int *bounds = malloc(max_bounds * sizeof(unsigned int));
+	hashring_entry **old_set = malloc(2 * replicas * sizeof(void *));
+	ring_move *copies = malloc(3 * max_ops * sizeof(ring_move));
+	DIE(!bounds || !old_set || !copies, "failed malloc() of the replicas");
+	hashring_entry **new_set = old_set + replicas;
+	ring_move *transfers = copies + max_ops, *removals = copies + 2 * max_ops;
+	size_t num_copies = 0, num_transfers = 0, num_removals = 0;
+
+	/* Capetele intervalelor sunt hashurile de pe ambele hashringuri. */
+	size_t num_bounds = 0;
+	for (size_t i = 0, j = 0; i < old_size || j < size;) {
+		if (j == size || (i < old_size && old[i].hash < ring[j].hash)) {
+			bounds[num_bounds++] = old[i++].hash;
+		} else {
+			/* Labelurile ramase apar pe ambele hashringuri. */
+			if (i < old_size && old[i].hash == ring[j].hash)
+				++i;
+			bounds[num_bounds++] = ring[j++].hash;
+		}
+	}
+	/* Ultimul interval revine, ca si primul, primului label. */
+	bounds[num_bounds++] = UINT_MAX;
+
+	for (size_t k = 0; k < num_bounds; ++k) {
+		unsigned int min_hash = k ? bounds[k - 1] : 0, max_hash = bounds[k];
+		if (min_hash >= max_hash)
 			continue;
+
+		size_t old_count = ring_successors(
+			old, old_size, ring_lower_bound(old, old_size, max_hash) % old_size,
+			replicas, old_set);
+		size_t new_count = ring_successors(
+			ring, size, ring_lower_bound(ring, size, max_hash) % size,
+			replicas, new_set);
+
+		server_memory *source = old_set[0]->server;
+		for (size_t i = 0; i < old_count; ++i) {
+			if (has_replica(new_set, new_count, old_set[i]->server)) {
+				source = old_set[i]->server;
+				break;
+			}
 		}
 
-		hashring_entry *neighbor =
-			find_server(main->hashring, server_count, hash, true);
-		size_t index = neighbor - main->hashring;
-		unsigned int min_hash;
-
-		if (index == 0) {
-			/* Chiar daca noul label preia obiecte de la primul
-			 * server, acesta e de fapt ultimul pe hashring */
-			if (main->hashring[0].hash < hash) {
-				min_hash = main->hashring[server_count - 1].hash;
-				main->hashring[server_count++] = new_label;
-				transfer_items(server, neighbor->server, min_hash, hash);
+		size_t leaving = 0;
+		for (size_t i = 0; i < new_count; ++i) {
+			server_memory *server = new_set[i]->server;
+			if (has_replica(old_set, old_count, server))
 				continue;
-			}
 
-			transfer_items(server, neighbor->server, 0, hash);
-			/* Devenind primul element de pe hashring, acesta va prelua toate
+			while (leaving < old_count &&
+				   has_replica(new_set, new_count, old_set[leaving]->server))
+				++leaving;
+			if (leaving < old_count)
+				push_range(transfers, &num_transfers, server,
+						   old_set[leaving++]->server, min_hash, max_hash);
+			else
+				push_range(copies, &num_copies, server, source, min_hash,
+						   max_hash);
+		}
+
+		for (; leaving < old_count; ++leaving) {
+			server_memory *server = old_set[leaving]->server;
+			if (server != removed &&
+				!has_replica(new_set, new_count, server))
+				push_range(removals, &num_removals, NULL, server, min_hash,
+						   max_hash);
+		}
+	}
+
+	/* Copiile se fac inainte ca sursele sa-si cedeze obiectele. */
+	apply_ranges(copies, num_copies, copy_ranges);
+	apply_ranges(transfers, num_transfers, transfer_ranges);
+	apply_ranges(removals, num_removals, remove_ranges);
+
+	free(bounds);
+	free(old_set);
+	free(copies);
+}
+
+/**
+ * @brief Adauga (daca `weight` e nenul) sau sterge un server din strategia de
+ * repartizare si muta obiectele sloturilor care si-au schimbat serverul.
+ * Sloturile consecutive mutate intre aceleasi 2 servere formeaza un singur
+ * interval. Ca pe hashring, intervalele nu contin capatul din dreapta, mai
+ * putin ultimul, care se termina la `UINT_MAX` (vezi `hash_in_range`).
+ */
+static void loader_move_slots(load_balancer *main, int server_id,
+							  unsigned int weight, server_memory *server)
+{
+	placement *place = &main->placement;
+	size_t slots = placement_slots(place);
+
+	/* Daca serverele nu au inca obiecte (de exemplu, la pornire), nu e nevoie
+	 * sa se caute sloturile mutate. */
+	bool empty = !main->migrations;
+	for (size_t i = 0; i < main->num_servers && empty; ++i)
+		empty = !server_size(main->servers[i].server);
+	if (empty) {
+		if (weight)
+			placement_add(place, server_id, weight, server, NULL);
+		else
+			placement_remove(place, server_id, NULL);
+		return;
+	}
+
+	placement_change *changes = malloc(slots * sizeof(placement_change));
+	ring_move *moves = malloc(slots * sizeof(ring_move));
+	DIE(!changes || !moves, "failed malloc() of the slot changes");
+
+	size_t num_changes =
+		weight ? placement_add(place, server_id, weight, server, changes)
+			   : placement_remove(place, server_id, changes);
+
+	size_t num_moves = 0;
+	for (size_t i = 0; i < num_changes; ++i) {
+		push_range(moves, &num_moves, changes[i].to, changes[i].from,
+				   placement_slot_start(place, changes[i].slot),
+				   placement_slot_start(place, changes[i].slot + 1));
+	}
+
+	loader_apply_moves(main, moves, num_moves);
+
+	free(changes);
+	free(moves);
+}
+
+/** Adauga un server (`loader_add_server`, fara masurare). */
+static void add_server(load_balancer *main, int server_id, unsigned int weight)
+{
+	DIE(!weight, "a server needs a positive weight");
+
+	server_memory *server = init_server_memory(main->storage_engine);
+	if (main->reclaimer)
+		server_set_reclaimer(server, main->reclaimer);
+	if (main->locking)
+		server_enable_locking(server);
+
+	ring_lock(main);
+	DIE(loader_find_info(main, server_id), "server already exists");
+
+	/* Strategiile fara hashring nu suporta cititori concurenti, deci nu e
+	 * nevoie de lockuri. */
+	if (main->placement.strategy != PLACEMENT_RING) {
+		loader_move_slots(main, server_id, weight, server);
+		loader_insert_info(main, (server_info){
+									 .id = server_id,
+									 .weight = weight,
+									 .server = server,
+								 });
+		ring_unlock(main);
+		return;
+	}
+
+	size_t num_labels = (size_t)weight * main->virtual_nodes;
+	unsigned int *labels = loader_make_labels(main, server_id, num_labels);
+
+	/* Labelurile noi, sortate dupa hash, si intervalele pe care le preiau */
+	hashring_entry *added = malloc(num_labels * sizeof(hashring_entry));
+	ring_move *moves = malloc(2 * num_labels * sizeof(ring_move));
+	DIE(!added || !moves, "failed malloc() of the added labels");
+
+	hashring_entry *old = main->hashring;
+	size_t old_size = main->hashring_size;
+	size_t num_added = 0, num_moves = 0;
+
+	/* Labelurile sunt adaugate pe rand, deci fiecare preia obiecte de la
+	 * vecinul sau de pe hashringul care le contine si pe cele anterioare. Se
+	 * calculeaza doar intervalele, care sunt mutate apoi deodata. */
+	for (size_t nth = 0; nth < num_labels; ++nth) {
+		hashring_entry label = {
+			.id = server_id,
+			.hash = hash_function_servers(&labels[nth]),
+			.label = labels[nth],
+			.server = server,
+		};
+
+		size_t old_next = ring_lower_bound(old, old_size, label.hash);
+		size_t new_next = ring_lower_bound(added, num_added, label.hash);
+		hashring_entry *next =
+			ring_min(old_next < old_size ? &old[old_next] : NULL,
+					 new_next < num_added ? &added[new_next] : NULL);
+		hashring_entry *prev =
+			ring_max(old_next ? &old[old_next - 1] : NULL,
+					 new_next ? &added[new_next - 1] : NULL);
+		hashring_entry *first = ring_min(old_size ? &old[0] : NULL,
+										 num_added ? &added[0] : NULL);
+		hashring_entry *last =
+			ring_max(old_size ? &old[old_size - 1] : NULL,
+					 num_added ? &added[num_added - 1] : NULL);
+
+		if (!first) {
+			/* Hashringul e gol. */
+		} else if (!next) {
+			/* Chiar daca noul label preia obiecte de la primul server, acesta
+			 * e de fapt ultimul pe hashring. */
+			moves[num_moves++] = (ring_move){
+				server, first->server, {last->hash, label.hash}};
+		} else if (!prev) {
+			/* Devenind primul element de pe hashring, acesta va prelua si
 			 * elementele care se aflau in primul server pentru ca aveau hashul
 			 * mai mare decat ultimul server. */
-			min_hash = main->hashring[server_count - 1].hash;
-			hash = UINT_MAX;
+			moves[num_moves++] =
+				(ring_move){server, next->server, {0, label.hash}};
+			moves[num_moves++] =
+				(ring_move){server, next->server, {last->hash, UINT_MAX}};
 		} else {
-			min_hash = main->hashring[index - 1].hash;
+			moves[num_moves++] =
+				(ring_move){server, next->server, {prev->hash, label.hash}};
 		}
 
-		transfer_items(server, neighbor->server, min_hash, hash);
+		/* Intervalele preluate de la celelalte labeluri noi raman pe loc. */
+		while (num_moves && moves[num_moves - 1].src == server)
+			--num_moves;
+
+		memmove(&added[new_next + 1], &added[new_next],
+				(num_added - new_next) * sizeof(hashring_entry));
+		added[new_next] = label;
+		++num_added;
+	}
+
+	/* Cu replici, obiectele se muta abia dupa interclasare, comparand
+	 * replicile de pe cele 2 hashringuri. */
+	hashring_entry *previous = NULL;
+	if (main->replicas > 1) {
+		num_moves = 0;
+		previous = malloc(old_size * sizeof(hashring_entry));
+		DIE(!previous && old_size, "failed malloc() of the previous hashring");
+		memcpy(previous, old, old_size * sizeof(hashring_entry));
+	}
+
+	/* Se blocheaza doar serverul nou si vecinii care ii cedeaza obiecte. */
+	size_t num_involved;
+	server_memory **involved =
+		lock_moves(server, moves, num_moves, &num_involved);
+
+	/* Se dubleaza capacitatea hashringului cand se umple. */
+	size_t size = old_size + num_added;
+	if (size > main->hashring_capacity) {
+		while (size > main->hashring_capacity)
+			main->hashring_capacity *= REALLOC_FACTOR;
+		main->hashring = realloc(main->hashring, sizeof(hashring_entry) *
+													 main->hashring_capacity);
+		DIE(!main->hashring,
+			"failed realloc() (extending) of load_balancer.hashring");
+	}
 
-		for (size_t j = server_count++; j > index; --j)
-			main->hashring[j] = main->hashring[j - 1];
+	/* Labelurile noi sunt interclasate cu cele vechi, de la sfarsit. */
+	for (size_t i = old_size, j = num_added, k = size; j;) {
+		if (i && main->hashring[i - 1].hash > added[j - 1].hash)
+			main->hashring[--k] = main->hashring[--i];
+		else
+			main->hashring[--k] = added[--j];
+	}
+	main->hashring_size = size;
 
-		main->hashring[index] = new_label;
+	loader_insert_info(main, (server_info){
+								 .id = server_id,
+								 .weight = weight,
+								 .num_labels = num_labels,
+								 .labels = labels,
+								 .server = server,
+							 });
+	if (previous) {
+		loader_replicate(main, previous, old_size, NULL);
+		free(previous);
 	}
+
+	/* Noul hashring este publicat inaintea mutarii, pe care cititorii nu o
+	 * asteapta (vezi `loader_lookup`). */
+	loader_publish_ring(main, num_moves);
+	loader_apply_moves(main, moves, num_moves);
+	loader_finish_moves(main);
+	unlock_servers(involved, num_involved);
+	ring_unlock(main);
+
+	free(involved);
+	free(added);
+	free(moves);
 }
 
-void loader_remove_server(load_balancer *main, int server_id)
+void loader_add_server(load_balancer *main, int server_id,
+					   unsigned int weight)
 {
-	hashring_entry neighbours[REPLICA_NUM];
-	for (int i = 0; i < REPLICA_NUM; ++i) {
-		unsigned int label = get_nth_replica(server_id, i);
-		unsigned int hash = hash_function_servers(&label);
+	INSTRUMENT_BEGIN(span);
+	add_server(main, server_id, weight);
+	INSTRUMENT_END_REBALANCE(INSTRUMENT_ADD_SERVER, span);
+}
+
+/** Sterge un server (`loader_remove_server`, fara masurare). */
+static void remove_server(load_balancer *main, int server_id)
+{
+	ring_lock(main);
+
+	size_t index = loader_server_index(main, server_id);
+	DIE(index == main->num_servers || main->servers[index].id != server_id,
+		"no server with this id");
 
-		hashring_entry *server_replica =
-			find_server(main->hashring, main->hashring_size, hash, false);
+	server_info info = main->servers[index];
+	server_memory *removed = info.server;
+	bool alone = main->num_servers == 1;
+
+	if (main->placement.strategy != PLACEMENT_RING) {
+		loader_move_slots(main, server_id, 0, removed);
+		loader_erase_info(main, index);
+		loader_release_server(main, removed);
+		ring_unlock(main);
+		return;
+	}
+
+	/* Un vecin pentru fiecare label, plus, eventual, cel care preia capatul
+	 * hashringului. */
+	hashring_entry *neighbours =
+		malloc((info.num_labels + 1) * sizeof(hashring_entry));
+	ring_move *moves = malloc((info.num_labels + 1) * sizeof(ring_move));
+	DIE(!neighbours || !moves, "failed malloc() of the removed labels");
+
+	size_t num_neighbours = 0;
+	for (size_t i = 0; i < info.num_labels && !alone; ++i) {
+		unsigned int hash = hash_function_servers(&info.labels[i]);
 
 		/* Cauta primul label vecin care nu face referire la acelasi server. */
-		size_t neighbour_index = server_replica - main->hashring + 1;
+		size_t neighbour_index =
+			ring_lower_bound(main->hashring, main->hashring_size, hash) + 1;
 		while (neighbour_index < main->hashring_size &&
-			   main->hashring[neighbour_index].id == server_id)
+			   main->hashring[neighbour_index].server == removed)
 			++neighbour_index;
 
 		/* Daca replica e ultimul element din hashring, elementele care raman
 		 * vor fi preluate de primul server diferit, indiferent de hash. */
 		if (neighbour_index == main->hashring_size) {
 			neighbour_index = 0;
-			while (main->hashring[neighbour_index].id == server_id)
+			while (main->hashring[neighbour_index].server == removed)
 				++neighbour_index;
 
 			neighbours[i] = main->hashring[neighbour_index];
@@ -189,41 +1889,133 @@ void loader_remove_server(load_balancer *main, int server_id)
 		} else {
 			neighbours[i] = main->hashring[neighbour_index];
 		}
+		++num_neighbours;
 	}
 
-	qsort(neighbours, REPLICA_NUM, sizeof(hashring_entry), compare_servers);
+	/* Primul label detine si hashurile de dupa ultimul label. Daca serverul
+	 * sters il are pe primul, dar nu si pe ultimul, niciun vecin de mai sus
+	 * nu acopera acest capat, care revine vecinului primului label. */
+	if (!alone && main->hashring[0].server == removed &&
+		main->hashring[main->hashring_size - 1].server != removed) {
+		size_t first = 0;
+		while (main->hashring[first].server == removed)
+			++first;
 
-	/* Transfera obiectele de pe serverul vechi la vecini. */
-	unsigned int hash = hash_function_servers(&server_id);
-	hashring_entry *server =
-		find_server(main->hashring, main->hashring_size, hash, false);
+		neighbours[num_neighbours] = main->hashring[first];
+		neighbours[num_neighbours++].hash = UINT_MAX;
+	}
+
+	/* Obiectele de sub hashul vecinului anterior au fost deja preluate. Cu
+	 * incarcarea limitata, obiectele sunt stocate din nou, pe rand, dupa
+	 * schimbarea hashringului. */
+	size_t num_moves = 0;
+	if (!alone && !main->bounded && main->replicas == 1) {
+		qsort(neighbours, num_neighbours, sizeof(hashring_entry),
+			  compare_servers);
 
-	for (int i = 0; i < REPLICA_NUM; ++i)
-		transfer_items(neighbours[i].server, server->server, 0,
-					   neighbours[i].hash);
+		for (size_t i = 0; i < num_neighbours; ++i) {
+			unsigned int min_hash = i ? neighbours[i - 1].hash : 0;
 
-	free_server_memory(server->server);
+			/* Labelurile cu acelasi vecin nu mai adauga nimic (iar
+			 * `[UINT_MAX, UINT_MAX)` nu ar fi gol). */
+			if (i && min_hash == neighbours[i].hash)
+				continue;
+			moves[num_moves++] = (ring_move){
+				neighbours[i].server, removed, {min_hash, neighbours[i].hash}};
+		}
+	}
 
-	/* Suprascrie labelurile vechi din hashring */
-	for (int i = 0; i < REPLICA_NUM; ++i) {
-		unsigned int label = get_nth_replica(server_id, i);
-		unsigned int hash = hash_function_servers(&label);
+	/* Se blocheaza doar serverul sters si vecinii care ii preiau obiectele. */
+	size_t num_involved;
+	server_memory **involved =
+		lock_moves(removed, moves, num_moves, &num_involved);
 
-		hashring_entry *server =
-			find_server(main->hashring, main->hashring_size, hash, false);
-		size_t index = server - main->hashring;
+	/* Cu replici, obiectele se refac dupa schimbarea hashringului. */
+	size_t old_size = main->hashring_size;
+	hashring_entry *previous = NULL;
+	if (main->replicas > 1) {
+		previous = malloc(old_size * sizeof(hashring_entry));
+		DIE(!previous, "failed malloc() of the previous hashring");
+		memcpy(previous, main->hashring, old_size * sizeof(hashring_entry));
+	}
 
-		--main->hashring_size;
-		for (size_t j = index; j < main->hashring_size; ++j)
-			main->hashring[j] = main->hashring[j + 1];
+	/* Sterge labelurile vechi din hashring */
+	size_t size = 0;
+	for (size_t i = 0; i < main->hashring_size; ++i) {
+		if (main->hashring[i].server != removed)
+			main->hashring[size++] = main->hashring[i];
 	}
+	main->hashring_size = size;
 
 	/* Se micsoreaza hashringul cand mai mult de jumatate e gol. */
-	if (main->hashring_size < main->hashring_capacity / REALLOC_FACTOR) {
-		main->hashring_capacity /= REALLOC_FACTOR;
+	if (size < main->hashring_capacity / REALLOC_FACTOR) {
+		while (size < main->hashring_capacity / REALLOC_FACTOR)
+			main->hashring_capacity /= REALLOC_FACTOR;
 		main->hashring = realloc(main->hashring, sizeof(hashring_entry) *
 													 main->hashring_capacity);
 		DIE(!main->hashring,
 			"failed realloc() (shrinking) of load_balancer.hashring");
 	}
+
+	loader_erase_info(main, index);
+	if (previous) {
+		loader_replicate(main, previous, old_size, removed);
+		free(previous);
+	}
+
+	loader_publish_ring(main, num_moves);
+	loader_apply_moves(main, moves, num_moves);
+	loader_finish_moves(main);
+	if (main->bounded && main->hashring_size)
+		server_for_each(removed, loader_replace_callback, main);
+	unlock_servers(involved, num_involved);
+	loader_release_server(main, removed);
+	ring_unlock(main);
+
+	free(involved);
+	free(neighbours);
+	free(moves);
+}
+
+void loader_remove_server(load_balancer *main, int server_id)
+{
+	INSTRUMENT_BEGIN(span);
+	remove_server(main, server_id);
+	INSTRUMENT_END_REBALANCE(INSTRUMENT_REMOVE_SERVER, span);
+}
+
+size_t loader_placement_memory(load_balancer *main)
+{
+	if (main->placement.strategy != PLACEMENT_RING)
+		return placement_memory(&main->placement);
+
+	size_t memory = main->hashring_capacity * sizeof(hashring_entry);
+	if (main->jump.table)
+		memory += ((size_t)1 << main->jump.bits) * sizeof(unsigned int);
+	else if (main->lookup.hashes)
+		memory += (main->lookup.size + 1) * 2 * sizeof(unsigned int);
+
+	return memory;
+}
+
+size_t loader_stats(load_balancer *main, loader_server_stats *stats,
+					size_t capacity)
+{
+	ring_lock(main);
+	size_t count = main->num_servers;
+
+	for (size_t i = 0; i < count && i < capacity; ++i) {
+		server_info *info = &main->servers[i];
+
+		stats[i].id = info->id;
+		stats[i].weight = info->weight;
+		stats[i].num_labels = info->num_labels;
+
+		server_lock(info->server);
+		server_get_stats(info->server, &stats[i].memory);
+		server_unlock(info->server);
+	}
+
+	ring_unlock(main);
+	return count;
 }
@@ -1,7 +1,11 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
 #ifndef LOAD_BALANCER_H_
 #define LOAD_BALANCER_H_
+#include <stdbool.h>
 
+#include "epoch.h"
+#include "keys.h"
+#include "placement.h"
 #include "server.h"
 
 /**
@@ -12,6 +16,36 @@
 struct load_balancer;
 typedef struct load_balancer load_balancer;
 
+/**
+ * @brief Progresul mutarii obiectelor dupa schimbarile hashringului.
+ */
+typedef struct {
+	/** intervalele de hashuri care inca se muta */
+	size_t pending_ranges;
+	/** intervalele mutate complet */
+	size_t completed_ranges;
+	/** obiectele mutate pana acum */
+	size_t moved_keys;
+	/** obiectele care mai trebuie mutate din intervalele ramase */
+	size_t remaining_keys;
+	/** serverele sterse, eliberate dupa terminarea mutarilor */
+	size_t pending_servers;
+} rebalance_progress;
+
+/**
+ * @brief Ocuparea unui server din load balancer (`loader_stats`).
+ */
+typedef struct {
+	/** id-ul serverului */
+	int id;
+	/** ponderea serverului */
+	unsigned int weight;
+	/** numarul de labeluri de pe hashring */
+	size_t num_labels;
+	/** obiectele si memoria serverului */
+	server_stats memory;
+} loader_server_stats;
+
 /**
  * @relates load_balancer
  * @brief Aloca si initializeaza un load balancer.
@@ -20,6 +54,211 @@ typedef struct load_balancer load_balancer;
  */
 load_balancer *init_load_balancer();
 
+/**
+ * @relates load_balancer
+ * @brief Alege modul de stocare al serverelor adaugate de acum inainte.
+ * Serverele existente raman neschimbate, deci se pot compara cele 2 moduri
+ * pe acelasi hashring.
+ *
+ * @param main		load balancerul
+ * @param engine	modul de organizare a bazelor de date
+ */
+void loader_set_storage_engine(load_balancer *main, ht_engine engine);
+
+/**
+ * @relates load_balancer
+ * @brief Alege numarul de labeluri (noduri virtuale) de pe hashring ale unui
+ * server cu ponderea 1 (implicit 3), pentru serverele adaugate de acum inainte.
+ * Cu mai multe labeluri, obiectele se impart mai uniform intre servere.
+ *
+ * @param main	load balancerul
+ * @param count	numarul de labeluri per unitate de pondere
+ */
+void loader_set_virtual_nodes(load_balancer *main, unsigned int count);
+
+/**
+ * @relates load_balancer
+ * @brief Alege functia de hash a cheilor (implicit `KEY_HASH_DJB2`). Hashul
+ * decide serverul fiecarei chei, deci functia poate fi schimbata doar
+ * inainte de adaugarea primului server.
+ *
+ * @param main load balancerul
+ * @param mode functia de hash
+ */
+void loader_set_key_hash(load_balancer *main, key_hash_mode mode);
+
+/**
+ * @relates load_balancer
+ * @brief Alege strategia care repartizeaza cheile pe servere (implicit
+ * hashringul, `PLACEMENT_RING`), inainte de adaugarea primului server.
+ *
+ * Celelalte strategii (jump, Maglev, rendezvous) impart hashurile in sloturi,
+ * iar la adaugarea sau stergerea unui server muta exact sloturile care si-au
+ * schimbat serverul. Acestea nu suporta cititorii concurenti, tabela de salt
+ * si incarcarea limitata, care depind de hashring.
+ *
+ * @param main		load balancerul
+ * @param strategy	strategia de repartizare
+ */
+void loader_set_placement(load_balancer *main, placement_strategy strategy);
+
+/**
+ * @relates load_balancer
+ * @brief Alege pe cate servere se stocheaza fiecare obiect (implicit 1),
+ * inainte de adaugarea primului server.
+ *
+ * Un obiect se afla pe primele `count` servere distincte de pe hashring, in
+ * sensul acelor de ceasornic, de la hashul cheii. `loader_retrieve` il cauta
+ * pe replica ce a servit pana atunci cele mai putine cautari. La schimbarile
+ * hashringului, serverele care ies din replicile unui interval le cedeaza
+ * obiectele celor care intra, iar restul copiilor lipsa se refac de pe
+ * replicile ramase. Replicile nu suporta modurile concurente, mutarea treptata
+ * a obiectelor, incarcarea limitata si celelalte strategii de repartizare.
+ *
+ * @param main	load balancerul
+ * @param count	numarul de replici ale fiecarui obiect
+ */
+void loader_set_replicas(load_balancer *main, size_t count);
+
+/**
+ * @relates load_balancer
+ * @brief Cauta serverul caruia ii revine o cheie printr-o tabela indexata de
+ * primii biti ai hashului (`hashring_jump`), in loc de indexul Eytzinger.
+ * Tabela ocupa mai multa memorie, dar o cautare citeste de obicei doar 1-2
+ * linii de cache. Aceasta este recompletata pe loc la fiecare schimbare a
+ * hashringului.
+ *
+ * @param main load balancerul
+ */
+void loader_enable_jump_table(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Permite apelarea lui `loader_retrieve` din mai multe threaduri, fara
+ * lock, in timp ce un singur thread (scriitorul) apeleaza celelalte functii.
+ * O cautare se reia cat timp serverul ei este modificat, dar mutarile facute
+ * la schimbarile hashringului sunt impartite in bucati, deci nu le asteapta
+ * pe toate.
+ *
+ * Cititorii se inregistreaza cu `loader_register_reader` si cauta doar intre
+ * `loader_read_begin` si `loader_read_end`. Memoria pe care o pot vedea
+ * (servere sterse, tabele vechi, copii ale hashringului) este eliberata abia
+ * dupa ce toti cititorii au iesit din cautarile in care o puteau accesa.
+ *
+ * @param main load balancerul
+ */
+void loader_enable_concurrent_reads(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Permite apelarea tuturor functiilor load balancerului din mai multe
+ * threaduri (implica `loader_enable_concurrent_reads`).
+ *
+ * Nu exista un lock global: `loader_store` blocheaza doar serverul pe care
+ * stocheaza, deci stocarile pe servere diferite merg in paralel, iar
+ * `loader_retrieve` nu ia niciun lock. Adaugarea si stergerea unui server
+ * blocheaza doar serverele intre care se muta obiecte (si se fac pe rand
+ * intre ele). Fiecare thread se inregistreaza cu `loader_register_reader` si
+ * apeleaza `loader_store` si `loader_retrieve` doar intre `loader_read_begin`
+ * si `loader_read_end`.
+ *
+ * @param main load balancerul
+ */
+void loader_enable_locking(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Face ca adaugarea si stergerea serverelor sa nu mai mute obiecte pe
+ * loc. Noile labeluri sunt valabile imediat, iar obiectele sunt mutate
+ * treptat, cate putine la fiecare stocare sau cautare (sau prin
+ * `loader_rebalance_step`). Pana la terminarea mutarii, o cheie este cautata
+ * si pe serverele de pe care inca ar urma sa vina.
+ *
+ * Nu poate fi folosita impreuna cu accesul concurent.
+ *
+ * @param main load balancerul
+ */
+void loader_enable_online_rebalancing(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Limiteaza numarul de obiecte de pe fiecare server la
+ * `(1 + epsilon)` ori media (rotunjit in sus), prin consistent hashing cu
+ * incarcare limitata. Un obiect nou care ar ajunge pe un server plin este
+ * stocat pe primul server sub limita, in sensul acelor de ceasornic, si
+ * retinut intr-un director, prin care il gaseste `loader_retrieve`.
+ *
+ * Limita este respectata la stocare si la stergerea unui server, ale carui
+ * obiecte sunt stocate din nou pe rand. Adaugarea unui server muta doar
+ * obiectele care ii revin dupa hash, deci unele servere pot ramane peste
+ * noua limita (mai mica) pana la urmatoarele stocari.
+ *
+ * Nu poate fi folosita impreuna cu accesul concurent sau cu mutarea treptata
+ * a obiectelor.
+ *
+ * @param main		load balancerul
+ * @param epsilon	cat poate depasi un server media (cel putin 0)
+ */
+void loader_enable_bounded_loads(load_balancer *main, double epsilon);
+
+/**
+ * @relates load_balancer
+ * @brief Muta cel mult (aproximativ) `max_keys` obiecte ramase de mutat dupa
+ * schimbarile hashringului.
+ *
+ * @param main		load balancerul
+ * @param max_keys	numarul de obiecte dupa care se opreste
+ *
+ * @return numarul de obiecte mutate
+ */
+size_t loader_rebalance_step(load_balancer *main, size_t max_keys);
+
+/**
+ * @relates load_balancer
+ * @brief Intoarce progresul mutarii obiectelor.
+ *
+ * @param[in]	main		load balancerul
+ * @param[out]	progress	contoarele mutarii
+ */
+void loader_rebalance_progress(load_balancer *main,
+							   rebalance_progress *progress);
+
+/**
+ * @relates load_balancer
+ * @brief Inregistreaza threadul curent drept cititor concurent.
+ *
+ * @param main load balancerul (cu cititorii concurenti activati)
+ *
+ * @return starea cititorului
+ */
+epoch_reader *loader_register_reader(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Renunta la un cititor concurent.
+ *
+ * @param reader starea cititorului
+ */
+void loader_unregister_reader(epoch_reader *reader);
+
+/**
+ * @relates load_balancer
+ * @brief Incepe o sectiune de citire. Valorile intoarse de `loader_retrieve`
+ * raman valide pana la `loader_read_end`.
+ *
+ * @param main		load balancerul
+ * @param reader	starea cititorului
+ */
+void loader_read_begin(load_balancer *main, epoch_reader *reader);
+
+/**
+ * @relates load_balancer
+ * @brief Incheie o sectiune de citire.
+ *
+ * @param reader starea cititorului
+ */
+void loader_read_end(epoch_reader *reader);
+
 /**
  * @relates load_balancer
  * @brief Elibereaza load balancerul si toate serverele de pe acesta.
@@ -39,6 +278,20 @@ void free_load_balancer(load_balancer *main);
  */
 void loader_store(load_balancer *main, char *key, char *value, int *server_id);
 
+/**
+ * @relates load_balancer
+ * @brief Stocheaza o valoare de lungime data, care poate contine si bytes
+ * nuli (spre deosebire de `loader_store`, care o masoara cu `strlen`).
+ *
+ * @param[in]	main		load balancerul in care se stocheaza
+ * @param[in]	key			cheia la care se stocheaza
+ * @param[in]	value		valoarea stocata
+ * @param[in]	value_size	lungimea valorii (cel mult `UINT32_MAX`)
+ * @param[out]	server_id	id-ul serverului pe care a fost stocata valoarea
+ */
+void loader_store_value(load_balancer *main, char *key, char *value,
+						size_t value_size, int *server_id);
+
 /**
  * @relates load_balancer
  * @brief Intoarce valoarea stocata pe hashring.
@@ -54,13 +307,94 @@ char *loader_retrieve(load_balancer *main, char *key, int *server_id);
 
 /**
  * @relates load_balancer
- * @brief Adauga un nou server in load balancer, redistribuind elementele
- * serverelor vecine pe hashring.
+ * @brief Intoarce lungimea unei valori gasite de `loader_retrieve` (sau
+ * `loader_retrieve_batch`), retinuta in fata ei. Valoarea este oricum urmata
+ * de un `'\0'`, deci valorile fara bytes nuli pot fi folosite si ca siruri
+ * de caractere.
+ *
+ * @param value valoarea intoarsa de `loader_retrieve`
+ */
+size_t loader_value_size(char *value);
+
+/**
+ * @relates load_balancer
+ * @brief Sterge un obiect din sistem (de pe toate replicile sale, respectiv si
+ * de pe serverele de pe care inca s-ar muta).
+ *
+ * @param main	load balancerul din care se sterge
+ * @param key	cheia obiectului
+ *
+ * @return daca obiectul a existat
+ */
+bool loader_remove(load_balancer *main, char *key);
+
+/**
+ * @relates load_balancer
+ * @brief Gaseste serverul unei chei, ca cererea sa fie executata direct pe
+ * acesta (de exemplu, din alt thread). Serverul gasit detine cheia pana la
+ * urmatoarea adaugare sau stergere de server, deci nu se poate folosi cu
+ * modurile concurente, mutarea treptata a obiectelor, replicile sau
+ * incarcarea limitata, in care cheile nu au un singur server fix.
+ *
+ * @param[in]	main		load balancerul
+ * @param[in]	key			cheia
+ * @param[out]	hash		hashul cheii
+ * @param[out]	server_id	id-ul serverului
+ *
+ * @return serverul caruia ii revine cheia
+ */
+server_memory *loader_route(load_balancer *main, char *key, unsigned int *hash,
+							int *server_id);
+
+/**
+ * @relates load_balancer
+ * @brief Stocheaza mai multe perechi (cheie, valoare) deodata, cu acelasi
+ * efect ca apelarea lui `loader_store` pentru fiecare, in ordine.
+ *
+ * Toate cheile sunt hash-uite si repartizate serverelor inainte, apoi sunt
+ * grupate pe servere si stocate intercalat: bucketurile cheilor urmatoare
+ * sunt aduse in cache cat timp se stocheaza cheia curenta. In modurile
+ * concurente, cu incarcarea limitata si cat timp obiectele se rebalanseaza,
+ * cheile sunt stocate pe rand.
+ *
+ * @param[in]	main		load balancerul in care se stocheaza
+ * @param[in]	keys		cheile
+ * @param[in]	values		valorile, in ordinea cheilor
+ * @param[in]	count		numarul de perechi
+ * @param[out]	server_ids	serverul pe care a fost stocata fiecare pereche
+ */
+void loader_store_batch(load_balancer *main, char **keys, char **values,
+						size_t count, int *server_ids);
+
+/**
+ * @relates load_balancer
+ * @brief Cauta mai multe chei deodata, la fel ca `loader_store_batch`.
+ *
+ * @param[in]	main		load balancerul pe care se cauta cheile
+ * @param[in]	keys		cheile cautate
+ * @param[in]	count		numarul de chei
+ * @param[out]	values		valoarea gasita pentru fiecare cheie (sau NULL)
+ * @param[out]	server_ids	serverul pe care se afla fiecare cheie
+ */
+void loader_retrieve_batch(load_balancer *main, char **keys, size_t count,
+						   char **values, int *server_ids);
+
+/**
+ * @relates load_balancer
+ * @brief Adauga un nou server in load balancer, redistribuindu-i elementele
+ * serverelor vecine pe hashring. Serverul primeste `weight` ori numarul de
+ * labeluri ales cu `loader_set_virtual_nodes`, deci o parte proportionala cu
+ * ponderea din obiecte. Labelurile sunt distincte pentru orice id-uri.
+ *
+ * Indiferent de numarul labelurilor, fiecare vecin cedeaza obiectele printr-un
+ * singur transfer, cu toate intervalele preluate de la acesta.
  *
  * @param main		load balancerul
- * @param server_id	id-ul serverului de adaugat
+ * @param server_id	id-ul serverului de adaugat (care nu exista deja)
+ * @param weight	ponderea serverului (cel putin 1)
  */
-void loader_add_server(load_balancer *main, int server_id);
+void loader_add_server(load_balancer *main, int server_id,
+					   unsigned int weight);
 
 /**
  * @relates load_balancer
@@ -72,4 +406,29 @@ void loader_add_server(load_balancer *main, int server_id);
  */
 void loader_remove_server(load_balancer *main, int server_id);
 
+/**
+ * @relates load_balancer
+ * @brief Memoria folosita pentru a gasi serverul unei chei (hashringul si
+ * indexul sau, respectiv starea strategiei de repartizare), in bytes.
+ *
+ * @param main load balancerul
+ */
+size_t loader_placement_memory(load_balancer *main);
+
+/**
+ * @relates load_balancer
+ * @brief Calculeaza ocuparea fiecarui server, in ordinea id-urilor. Cu
+ * replici, fiecare copie este numarata pe serverul ei; serverele sterse care
+ * inca isi muta obiectele nu mai apar.
+ *
+ * @param[in]	main		load balancerul
+ * @param[out]	stats		ocuparea serverelor (cel mult `capacity`)
+ * @param[in]	capacity	cate servere incap in `stats`
+ *
+ * @return numarul total de servere (poate fi apelata cu `capacity` 0, ca sa
+ * afle cat spatiu trebuie alocat)
+ */
+size_t loader_stats(load_balancer *main, loader_server_stats *stats,
+					size_t capacity);
+
 #endif /* LOAD_BALANCER_H_ */
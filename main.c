@@ -1,119 +1,224 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "instrument.h"
 #include "load_balancer.h"
+#include "output.h"
+#include "replay.h"
+#include "requests.h"
 #include "utils.h"
 
-#define REQUEST_LENGTH 1024
-#define KEY_LENGTH 128
-#define VALUE_LENGTH 65536
-
-void get_key_value(char *key, char *value, char *request)
+/**
+ * @brief Optiunile date in linia de comanda.
+ */
+typedef struct {
+	/** modul de stocare al serverelor */
+	ht_engine engine;
+	/** daca obiectele se muta treptat la schimbarile hashringului */
+	bool online;
+	/** daca serverele se cauta prin tabela de salt */
+	bool jump_table;
+	/** functia de hash a cheilor */
+	key_hash_mode key_hash;
+	/** strategia de repartizare a cheilor */
+	placement_strategy placement;
+	/** numarul de labeluri ale unui server cu ponderea 1 (0 pentru valoarea
+	 * implicita) */
+	unsigned int virtual_nodes;
+	/** cat poate depasi un server media obiectelor (negativ daca incarcarea
+	 * nu e limitata) */
+	double load_bound;
+	/** pe cate servere se stocheaza fiecare obiect */
+	unsigned int replicas;
+	/** formatul rezultatelor */
+	output_format output;
+	/** numarul de threaduri care executa cererile (0 pentru executarea pe
+	 * rand, in threadul principal) */
+	unsigned int workers;
+} options;
+
+void apply_request(load_balancer *main_server, request *req,
+				   output_writer *out)
 {
-	int key_start = 0, value_start = 0;
-	int key_finish = 0, value_finish = 0;
-	int key_index = 0, value_index = 0;
-
-	for (unsigned int i = 0; i < strlen(request); ++i) {
-		if (request[i] == '"' && value_start != 1) {
-			if (key_start == 0) {
-				key_start = 1;
-			} else if (key_finish == 0) {
-				key_finish = 1;
-			} else if (value_start == 0) {
-				value_start = 1;
-			}
+	int index_server = 0;
+	char *retrieved_value;
+
+	switch (req->type) {
+	case REQUEST_STORE:
+		loader_store_value(main_server, req->key.data, req->value.data,
+						   req->value.len, &index_server);
+		output_stored(out, req->value.data, req->value.len, index_server);
+		break;
+	case REQUEST_RETRIEVE:
+		retrieved_value =
+			loader_retrieve(main_server, req->key.data, &index_server);
+		if (retrieved_value) {
+			output_retrieved(out, retrieved_value,
+							 loader_value_size(retrieved_value), index_server);
 		} else {
-			if (key_start == 1 && key_finish == 0) {
-				key[key_index++] = request[i];
-			} else if (value_start == 1 && value_finish == 0) {
-				value[value_index++] = request[i];
-			}
+			output_missing(out, req->key.data, req->key.len);
 		}
+		break;
+	case REQUEST_ADD_SERVER:
+		loader_add_server(main_server, req->server_id, req->weight);
+		break;
+	case REQUEST_REMOVE_SERVER:
+		loader_remove_server(main_server, req->server_id);
+		break;
+	case REQUEST_STATS:
+		output_stats(out, main_server);
+		break;
+	case REQUEST_INVALID:
+		DIE(1, "unknown function call");
 	}
-
-	value[value_index - 1] = 0;
 }
 
-void get_key(char *key, char *request)
+void apply_requests(request_reader *reader, options *opts)
 {
-	int key_start = 0, key_index = 0;
-
-	for (unsigned int i = 0; i < strlen(request); ++i) {
-		if (request[i] == '"') {
-			key_start = 1;
-		} else if (key_start == 1) {
-			key[key_index++] = request[i];
-		}
-	}
-}
-
-void apply_requests(FILE *input_file)
-{
-	char request[REQUEST_LENGTH] = {0};
-	char key[KEY_LENGTH] = {0};
-	char value[VALUE_LENGTH] = {0};
+	request req;
+	output_writer out;
 	load_balancer *main_server = init_load_balancer();
-
-	while (fgets(request, REQUEST_LENGTH, input_file)) {
-		request[strlen(request) - 1] = 0;
-		if (!strncmp(request, "store", sizeof("store") - 1)) {
-			get_key_value(key, value, request);
-
-			int index_server = 0;
-			loader_store(main_server, key, value, &index_server);
-			printf("Stored %s on server %d.\n", value, index_server);
-
-			memset(key, 0, sizeof(key));
-			memset(value, 0, sizeof(value));
-		} else if (!strncmp(request, "retrieve", sizeof("retrieve") - 1)) {
-			get_key(key, request);
-
-			int index_server = 0;
-			char *retrieved_value =
-				loader_retrieve(main_server, key, &index_server);
-			if (retrieved_value) {
-				printf("Retrieved %s from server %d.\n", retrieved_value,
-					   index_server);
-			} else {
-				printf("Key %s not present.\n", key);
-			}
-
-			memset(key, 0, sizeof(key));
-		} else if (!strncmp(request, "add_server", sizeof("add_server") - 1)) {
-			int server_id = atoi(request + sizeof("add_server"));
-
-			loader_add_server(main_server, server_id);
-		} else if (!strncmp(request, "remove_server",
-							sizeof("remove_server") - 1)) {
-			int server_id = atoi(request + sizeof("remove_server"));
-
-			loader_remove_server(main_server, server_id);
-		} else {
-			DIE(1, "unknown function call");
+	loader_set_storage_engine(main_server, opts->engine);
+	loader_set_key_hash(main_server, opts->key_hash);
+	loader_set_placement(main_server, opts->placement);
+	loader_set_replicas(main_server, opts->replicas);
+	if (opts->virtual_nodes)
+		loader_set_virtual_nodes(main_server, opts->virtual_nodes);
+	if (opts->online)
+		loader_enable_online_rebalancing(main_server);
+	if (opts->jump_table)
+		loader_enable_jump_table(main_server);
+	if (opts->load_bound >= 0)
+		loader_enable_bounded_loads(main_server, opts->load_bound);
+
+	/* Cu `INSTRUMENT`, masuratorile sunt scrise la `SIGUSR1` si la sfarsit. */
+	INSTRUMENT_DUMP_ON_SIGNAL(SIGUSR1);
+
+	output_open(&out, STDOUT_FILENO, opts->output);
+	if (opts->workers) {
+		replay_pipeline(main_server, reader, &out, opts->workers);
+	} else {
+		while (request_reader_next(reader, &req)) {
+			apply_request(main_server, &req, &out);
+			INSTRUMENT_POLL(stderr);
 		}
 	}
 
+	output_close(&out);
+	INSTRUMENT_DUMP(stderr);
 	free_load_balancer(main_server);
 }
 
 int main(int argc, char *argv[])
 {
-	FILE *input;
+	request_reader reader;
+	options opts = {
+		.engine = HT_ENGINE_CHAINED,
+		.online = false,
+		.jump_table = false,
+		.key_hash = KEY_HASH_DJB2,
+		.placement = PLACEMENT_RING,
+		.virtual_nodes = 0,
+		.load_bound = -1,
+		.replicas = 1,
+		.output = OUTPUT_TEXT,
+		.workers = 0,
+	};
+	int arg = 1;
+
+	for (; arg < argc - 1; ++arg) {
+		if (!strcmp(argv[arg], "--online")) {
+			opts.online = true;
+		} else if (!strcmp(argv[arg], "--binary-output")) {
+			opts.output = OUTPUT_BINARY;
+		} else if (!strcmp(argv[arg], "--jump-table")) {
+			opts.jump_table = true;
+		} else if (!strcmp(argv[arg], "--key-hash") && arg + 1 < argc - 1) {
+			++arg;
+			if (!strcmp(argv[arg], "fast")) {
+				opts.key_hash = KEY_HASH_FAST;
+			} else if (strcmp(argv[arg], "djb2")) {
+				printf("Unknown key hash %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--placement") && arg + 1 < argc - 1) {
+			++arg;
+			if (!strcmp(argv[arg], "jump")) {
+				opts.placement = PLACEMENT_JUMP;
+			} else if (!strcmp(argv[arg], "maglev")) {
+				opts.placement = PLACEMENT_MAGLEV;
+			} else if (!strcmp(argv[arg], "rendezvous")) {
+				opts.placement = PLACEMENT_RENDEZVOUS;
+			} else if (strcmp(argv[arg], "ring")) {
+				printf("Unknown placement %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--virtual-nodes") &&
+				   arg + 1 < argc - 1) {
+			opts.virtual_nodes = atoi(argv[++arg]);
+			if (!opts.virtual_nodes) {
+				printf("Invalid number of virtual nodes %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--pipeline") && arg + 1 < argc - 1) {
+			opts.workers = atoi(argv[++arg]);
+			if (!opts.workers) {
+				printf("Invalid number of threads %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--replicas") && arg + 1 < argc - 1) {
+			opts.replicas = atoi(argv[++arg]);
+			if (!opts.replicas) {
+				printf("Invalid number of replicas %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--bounded-load") &&
+				   arg + 1 < argc - 1) {
+			opts.load_bound = atof(argv[++arg]);
+			if (opts.load_bound < 0) {
+				printf("Invalid load bound %s\n", argv[arg]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "--engine") && arg + 1 < argc - 1) {
+			++arg;
+			if (!strcmp(argv[arg], "flat")) {
+				opts.engine = HT_ENGINE_FLAT;
+			} else if (strcmp(argv[arg], "chained")) {
+				printf("Unknown engine %s\n", argv[arg]);
+				return -1;
+			}
+		} else {
+			break;
+		}
+	}
 
-	if (argc != 2) {
-		printf("Usage:%s input_file \n", argv[0]);
+	if (arg != argc - 1) {
+		printf("Usage:%s [--engine chained|flat] [--key-hash djb2|fast] "
+			   "[--placement ring|jump|maglev|rendezvous] "
+			   "[--virtual-nodes count] [--replicas count] [--online] "
+			   "[--jump-table] [--bounded-load epsilon] [--binary-output] "
+			   "[--pipeline threads] input_file \n",
+			   argv[0]);
 		return -1;
 	}
 
-	input = fopen(argv[1], "rt");
-	DIE(input == NULL, "missing input file");
-
-	apply_requests(input);
+	/* Cererile sunt impartite workerilor dupa serverul cheii, deci fiecare
+	 * cheie trebuie sa aiba un singur server, fix intre 2 schimbari. */
+	if (opts.workers &&
+		(opts.online || opts.replicas > 1 || opts.load_bound >= 0)) {
+		printf("--pipeline cannot be combined with --online, --replicas or "
+			   "--bounded-load\n");
+		return -1;
+	}
 
-	fclose(input);
+	request_reader_open(&reader, argv[arg]);
+	apply_requests(&reader, &opts);
+	request_reader_close(&reader);
 
 	return 0;
 }
@@ -0,0 +1,233 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "utils.h"
+
+/** Lungimea maxima a textului dinaintea si de dupa valoarea unei linii */
+#define OUTPUT_AFFIX_SIZE 32
+
+/** Lungimea maxima a unei linii scrise de `output_stats` */
+#define OUTPUT_STATS_SIZE 512
+
+/** Bufferul deschis, golit si daca programul se opreste cu `exit` (de
+ * exemplu, dintr-un `DIE`), ca rezultatele deja calculate sa nu se piarda */
+static output_writer *active_writer;
+
+static void output_flush_active(void)
+{
+	output_writer *out = active_writer;
+
+	/* O eroare la scriere apeleaza din nou `exit`, deci bufferul nu mai
+	 * trebuie golit a doua oara. */
+	active_writer = NULL;
+	if (out)
+		output_flush(out);
+}
+
+void output_open(output_writer *out, int fd, output_format format)
+{
+	static bool registered;
+
+	*out = (output_writer){.fd = fd, .format = format};
+	out->data = malloc(OUTPUT_BUFFER_SIZE);
+	DIE(!out->data, "failed malloc() of output.data");
+
+	if (!registered) {
+		DIE(atexit(output_flush_active), "failed atexit()");
+		registered = true;
+	}
+	active_writer = out;
+}
+
+/** Scrie complet bucatile date, reluand dupa scrierile partiale. */
+static void write_all(int fd, struct iovec *iov, int count)
+{
+	while (count) {
+		ssize_t written = writev(fd, iov, count);
+		if (written < 0 && errno == EINTR)
+			continue;
+		DIE(written < 0, "failed writev() of the output");
+
+		while (count && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			++iov;
+			--count;
+		}
+		if (count) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+}
+
+void output_flush(output_writer *out)
+{
+	struct iovec iov = {out->data, out->len};
+
+	write_all(out->fd, &iov, 1);
+	out->len = 0;
+}
+
+/** Formateaza un numar in baza 10 si intoarce numarul de caractere scrise. */
+static size_t format_int(char *dest, int number)
+{
+	char digits[16];
+	size_t count = 0, len = 0;
+	unsigned int value =
+		number < 0 ? 0u - (unsigned int)number : (unsigned int)number;
+
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	if (number < 0)
+		dest[len++] = '-';
+	while (count)
+		dest[len++] = digits[--count];
+
+	return len;
+}
+
+/**
+ * Adauga in buffer `prefix`, `payload` si `suffix`. Daca `payload` este mare,
+ * bufferul si cele 3 bucati sunt scrise imediat, printr-un singur `writev`.
+ */
+static void output_append(output_writer *out, const void *prefix,
+						  size_t prefix_len, const char *payload, size_t len,
+						  const char *suffix, size_t suffix_len)
+{
+	if (out->len + prefix_len + len + suffix_len > OUTPUT_BUFFER_SIZE ||
+		len >= OUTPUT_DIRECT_SIZE) {
+		if (len >= OUTPUT_DIRECT_SIZE) {
+			struct iovec iov[] = {{out->data, out->len},
+								  {(void *)prefix, prefix_len},
+								  {(void *)payload, len},
+								  {(void *)suffix, suffix_len}};
+			write_all(out->fd, iov, 4);
+			out->len = 0;
+			return;
+		}
+		output_flush(out);
+	}
+
+	memcpy(out->data + out->len, prefix, prefix_len);
+	memcpy(out->data + out->len + prefix_len, payload, len);
+	memcpy(out->data + out->len + prefix_len + len, suffix, suffix_len);
+	out->len += prefix_len + len + suffix_len;
+}
+
+/** Adauga o inregistrare binara. */
+static void output_record(output_writer *out, output_record_type type,
+						  const char *payload, size_t len, int server_id)
+{
+	char header[sizeof(uint8_t) + sizeof(int32_t) + sizeof(uint32_t)];
+	int32_t id = server_id;
+	uint32_t length = len;
+
+	header[0] = type;
+	memcpy(header + sizeof(uint8_t), &id, sizeof(id));
+	memcpy(header + sizeof(uint8_t) + sizeof(id), &length, sizeof(length));
+	output_append(out, header, sizeof(header), payload, len, "", 0);
+}
+
+/** Adauga o linie de forma "<prefix><valoare><text><id>.\n". */
+static void output_line(output_writer *out, const char *prefix,
+						const char *payload, size_t len, const char *text,
+						int server_id)
+{
+	char suffix[OUTPUT_AFFIX_SIZE];
+	size_t suffix_len = strlen(text);
+
+	memcpy(suffix, text, suffix_len);
+	suffix_len += format_int(suffix + suffix_len, server_id);
+	suffix[suffix_len++] = '.';
+	suffix[suffix_len++] = '\n';
+	output_append(out, prefix, strlen(prefix), payload, len, suffix,
+				  suffix_len);
+}
+
+void output_stored(output_writer *out, const char *value, size_t len,
+				   int server_id)
+{
+	if (out->format == OUTPUT_BINARY)
+		output_record(out, OUTPUT_STORED, value, len, server_id);
+	else
+		output_line(out, "Stored ", value, len, " on server ", server_id);
+}
+
+void output_retrieved(output_writer *out, const char *value, size_t len,
+					  int server_id)
+{
+	if (out->format == OUTPUT_BINARY)
+		output_record(out, OUTPUT_RETRIEVED, value, len, server_id);
+	else
+		output_line(out, "Retrieved ", value, len, " from server ",
+					server_id);
+}
+
+void output_missing(output_writer *out, const char *key, size_t len)
+{
+	static const char suffix[] = " not present.\n";
+
+	if (out->format == OUTPUT_BINARY)
+		output_record(out, OUTPUT_MISSING, key, len, -1);
+	else
+		output_append(out, "Key ", sizeof("Key ") - 1, key, len, suffix,
+					  sizeof(suffix) - 1);
+}
+
+/** Adauga ocuparea unui singur server. */
+static void output_server_stats(output_writer *out,
+								const loader_server_stats *stats)
+{
+	const ht_stats *total = &stats->memory.total;
+	char line[OUTPUT_STATS_SIZE];
+
+	/* Statisticile sunt cerute rar, deci `snprintf` e suficient aici. */
+	int len = snprintf(
+		line, sizeof(line),
+		"server=%d weight=%u labels=%zu keys=%zu displaced_keys=%zu "
+		"key_bytes=%zu value_bytes=%zu node_bytes=%zu table_bytes=%zu "
+		"longest_chain=%zu slab_used=%zu slab_reserved=%zu\n",
+		stats->id, stats->weight, stats->num_labels, total->size,
+		stats->memory.displaced_keys, total->key_bytes, total->value_bytes,
+		total->node_bytes, total->table_bytes, total->longest_chain,
+		stats->memory.slab_used, stats->memory.slab_reserved);
+
+	if (out->format == OUTPUT_BINARY)
+		output_record(out, OUTPUT_STATS, line, len - 1, stats->id);
+	else
+		output_append(out, "", 0, line, len, "", 0);
+}
+
+void output_stats(output_writer *out, load_balancer *main)
+{
+	size_t count = loader_stats(main, NULL, 0);
+	if (!count)
+		return;
+
+	loader_server_stats *stats = malloc(count * sizeof(*stats));
+	DIE(!stats, "failed malloc() of the server stats");
+
+	count = loader_stats(main, stats, count);
+	for (size_t i = 0; i < count; ++i)
+		output_server_stats(out, &stats[i]);
+	free(stats);
+}
+
+void output_close(output_writer *out)
+{
+	if (active_writer == out)
+		active_writer = NULL;
+	output_flush(out);
+	free(out->data);
+}
@@ -0,0 +1,138 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+#include <stddef.h>
+
+#include "load_balancer.h"
+
+/**
+ * @file output.h
+ * @brief Scrierea rezultatelor cererilor, printr-un buffer mare.
+ *
+ * Liniile sunt asamblate in buffer (numerele sunt formatate direct, fara
+ * `printf`), iar bufferul este scris cu `write` doar cand se umple. Valorile
+ * mari nu se mai copiaza in buffer: sunt scrise impreuna cu acesta, printr-un
+ * singur `writev`.
+ */
+
+/** Dimensiunea bufferului de iesire */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+/** Valorile de cel putin atatia bytes sunt scrise direct, fara copiere */
+#define OUTPUT_DIRECT_SIZE (64 << 10)
+
+/**
+ * @brief Formatul rezultatelor.
+ */
+typedef enum {
+	/** liniile de text ale temei ("Stored ... on server ...") */
+	OUTPUT_TEXT,
+	/**
+	 * inregistrari binare: tipul (1 byte, `output_record_type`), id-ul
+	 * serverului (`int32_t`), lungimea (`uint32_t`), apoi valoarea (sau
+	 * cheia, pentru `OUTPUT_MISSING`), fara '\0'; numerele sunt in ordinea
+	 * bytes a masinii
+	 */
+	OUTPUT_BINARY,
+} output_format;
+
+/**
+ * @brief Tipul unei inregistrari binare.
+ */
+typedef enum {
+	/** obiect stocat */
+	OUTPUT_STORED,
+	/** obiect gasit */
+	OUTPUT_RETRIEVED,
+	/** cheie negasita (id-ul serverului este -1) */
+	OUTPUT_MISSING,
+	/** ocuparea unui server, ca linie de text `cheie=valoare` */
+	OUTPUT_STATS,
+} output_record_type;
+
+/**
+ * @class output_writer
+ * @brief Un buffer de iesire, asociat unui file descriptor.
+ */
+typedef struct {
+	/** file descriptorul in care se scrie */
+	int fd;
+	/** formatul rezultatelor */
+	output_format format;
+	/** bufferul */
+	char *data;
+	/** cati bytes asteapta in buffer */
+	size_t len;
+} output_writer;
+
+/**
+ * @relates output_writer
+ * @brief Initializeaza un buffer de iesire gol. Pana la `output_close`,
+ * bufferul este golit si daca programul se opreste cu `exit`.
+ *
+ * @param out		bufferul
+ * @param fd		file descriptorul in care se scrie
+ * @param format	formatul rezultatelor
+ */
+void output_open(output_writer *out, int fd, output_format format);
+
+/**
+ * @relates output_writer
+ * @brief Adauga rezultatul unui `store`.
+ *
+ * @param out		bufferul
+ * @param value		valoarea stocata
+ * @param len		lungimea valorii
+ * @param server_id	serverul pe care a ajuns
+ */
+void output_stored(output_writer *out, const char *value, size_t len,
+				   int server_id);
+
+/**
+ * @relates output_writer
+ * @brief Adauga rezultatul unui `retrieve` reusit.
+ *
+ * @param out		bufferul
+ * @param value		valoarea gasita
+ * @param len		lungimea valorii
+ * @param server_id	serverul pe care a fost gasita
+ */
+void output_retrieved(output_writer *out, const char *value, size_t len,
+					  int server_id);
+
+/**
+ * @relates output_writer
+ * @brief Adauga rezultatul unui `retrieve` pentru o cheie inexistenta.
+ *
+ * @param out	bufferul
+ * @param key	cheia cautata
+ * @param len	lungimea cheii
+ */
+void output_missing(output_writer *out, const char *key, size_t len);
+
+/**
+ * @relates output_writer
+ * @brief Adauga rezultatul unui `stats`: ocuparea fiecarui server din load
+ * balancer (`loader_stats`), cate o linie de perechi `cheie=valoare`.
+ *
+ * @param out	bufferul
+ * @param main	load balancerul
+ */
+void output_stats(output_writer *out, load_balancer *main);
+
+/**
+ * @relates output_writer
+ * @brief Scrie tot ce asteapta in buffer.
+ *
+ * @param out bufferul
+ */
+void output_flush(output_writer *out);
+
+/**
+ * @relates output_writer
+ * @brief Scrie ce a ramas in buffer si il elibereaza.
+ *
+ * @param out bufferul
+ */
+void output_close(output_writer *out);
+
+#endif /* OUTPUT_H_ */
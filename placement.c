@@ -0,0 +1,393 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "placement.h"
+#include "utils.h"
+
+/** Marcheaza o pozitie inca neocupata din tabela Maglev */
+#define MAGLEV_EMPTY UINT_MAX
+
+/** Constante cu care se deriva din id pozitia de start si pasul unui server
+ * in tabela Maglev */
+#define MAGLEV_OFFSET_SEED 0x6d61676c65766f66ull
+#define MAGLEV_SKIP_SEED 0x6d61676c6576736bull
+
+unsigned int placement_slot_start(const placement *place, size_t slot)
+{
+	uint64_t slots = placement_slots(place);
+	uint64_t start = (((uint64_t)slot << 32) + slots - 1) / slots;
+
+	return start > UINT_MAX ? UINT_MAX : start;
+}
+
+void placement_init(placement *place, placement_strategy strategy)
+{
+	*place = (placement){.strategy = strategy};
+}
+
+/** Pozitia unui server in `members`. */
+static size_t placement_index(const placement *place, int id)
+{
+	size_t index = 0;
+	while (index < place->num_members &&
+		   place->members[index].id != id)
+		++index;
+
+	DIE(index == place->num_members, "no server with this id");
+	return index;
+}
+
+/** Recalculeaza intrarile rendezvous: `weight` intrari pentru fiecare
+ * server. */
+static void placement_build_entries(placement *place)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < place->num_members; ++i)
+		count += place->members[i].weight;
+
+	place->buckets =
+		realloc(place->buckets, count * sizeof(unsigned int));
+	place->seeds = realloc(place->seeds, count * sizeof(uint64_t));
+	DIE(count && (!place->buckets || !place->seeds),
+		"failed realloc() of placement.buckets");
+
+	size_t entry = 0;
+	for (size_t i = 0; i < place->num_members; ++i) {
+		uint64_t id = (unsigned int)place->members[i].id;
+
+		for (unsigned int j = 0; j < place->members[i].weight; ++j) {
+			place->buckets[entry] = i;
+			place->seeds[entry] = placement_mix((id << 32) | j);
+			++entry;
+		}
+	}
+	place->num_buckets = count;
+}
+
+/**
+ * Umple tabela Maglev: fiecare server isi parcurge propria permutare a
+ * pozitiilor si, pe rand, ocupa cate `weight` pozitii libere, pana se umple
+ * tabela.
+ */
+static void placement_build_table(placement *place)
+{
+	size_t num_members = place->num_members;
+	if (!num_members)
+		return;
+
+	if (!place->table) {
+		place->table = malloc(MAGLEV_TABLE_SIZE * sizeof(unsigned int));
+		DIE(!place->table, "failed malloc() of placement.table");
+	}
+
+	uint64_t *position = malloc(2 * num_members * sizeof(uint64_t));
+	DIE(!position, "failed malloc() of the Maglev permutations");
+	uint64_t *skip = position + num_members;
+
+	for (size_t i = 0; i < num_members; ++i) {
+		uint64_t id = (unsigned int)place->members[i].id;
+
+		position[i] =
+			placement_mix(id ^ MAGLEV_OFFSET_SEED) % MAGLEV_TABLE_SIZE;
+		skip[i] =
+			placement_mix(id ^ MAGLEV_SKIP_SEED) % (MAGLEV_TABLE_SIZE - 1) + 1;
+	}
+
+	for (size_t i = 0; i < MAGLEV_TABLE_SIZE; ++i)
+		place->table[i] = MAGLEV_EMPTY;
+
+	size_t filled = 0;
+	while (filled < MAGLEV_TABLE_SIZE) {
+		for (size_t i = 0; i < num_members && filled < MAGLEV_TABLE_SIZE;
+			 ++i) {
+			for (unsigned int turn = 0; turn < place->members[i].weight &&
+										filled < MAGLEV_TABLE_SIZE;
+				 ++turn) {
+				while (place->table[position[i]] != MAGLEV_EMPTY)
+					position[i] = (position[i] + skip[i]) % MAGLEV_TABLE_SIZE;
+
+				place->table[position[i]] = i;
+				++filled;
+			}
+		}
+	}
+
+	free(position);
+}
+
+/** Serverul unui slot, dupa schimbare. */
+static server_memory *placement_slot_owner(const placement *place, size_t slot)
+{
+	return placement_find(place, placement_slot_start(place, slot))->server;
+}
+
+/**
+ * Completeaza serverul de dupa schimbare al sloturilor candidate si le
+ * pastreaza doar pe cele care si-au schimbat serverul.
+ */
+static size_t placement_settle(const placement *place,
+							   placement_change *changes, size_t count)
+{
+	size_t kept = 0;
+
+	if (!place->num_members)
+		return 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		changes[i].to = placement_slot_owner(place, changes[i].slot);
+		if (changes[i].to != changes[i].from)
+			changes[kept++] = changes[i];
+	}
+
+	return kept;
+}
+
+/**
+ * Intrarea rendezvous castigatoare a unei chei dintre intrarile
+ * `[first, last)`, impreuna cu scorul ei (0 daca nu castiga niciuna).
+ */
+static size_t placement_best_entry(const placement *place, uint64_t key,
+								   size_t first, size_t last,
+								   uint64_t *best_score)
+{
+	size_t best = first;
+
+	*best_score = 0;
+	for (size_t i = first; i < last; ++i) {
+		uint64_t score = placement_mix(key ^ place->seeds[i]);
+		if (score > *best_score) {
+			*best_score = score;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Sloturile mutate la adaugarea unui server: la jump, cele care ajung in
+ * bucketurile de la `old_buckets` incolo; la rendezvous, cele in care una
+ * dintre intrarile noi (de la `old_buckets` incolo) bate castigatorul vechi.
+ */
+static size_t placement_added(const placement *place, size_t old_buckets,
+							  placement_change *changes)
+{
+	size_t slots = placement_slots(place), count = 0;
+
+	if (!old_buckets)
+		return 0;
+
+	for (size_t slot = 0; slot < slots; ++slot) {
+		uint64_t key = placement_mix(slot);
+		size_t before, after;
+
+		if (place->strategy == PLACEMENT_JUMP) {
+			after = placement_jump(key, place->num_buckets);
+			if (after < old_buckets)
+				continue;
+			before = placement_jump(key, old_buckets);
+		} else {
+			uint64_t old_score, new_score;
+			before = placement_best_entry(place, key, 0, old_buckets,
+										  &old_score);
+			after = placement_best_entry(place, key, old_buckets,
+										 place->num_buckets, &new_score);
+			if (new_score <= old_score)
+				continue;
+		}
+
+		changes[count++] = (placement_change){
+			.slot = slot,
+			.from = place->members[place->buckets[before]].server,
+			.to = place->members[place->buckets[after]].server,
+		};
+	}
+
+	return count;
+}
+
+/**
+ * Sloturile care pot fi mutate la stergerea serverului de pe pozitia `index`:
+ * cele ale serverului si, la jump, cele ale ultimelor bucketuri, care iau
+ * locul bucketurilor sterse. Celelalte sloturi raman pe loc, deci serverul de
+ * dupa schimbare se calculeaza doar pentru acestea (`placement_settle`).
+ */
+static size_t placement_leaving(const placement *place, size_t index,
+								placement_change *changes)
+{
+	size_t slots = placement_slots(place), count = 0;
+	size_t kept = place->num_buckets - place->members[index].weight;
+
+	for (size_t slot = 0; slot < slots; ++slot) {
+		uint64_t key = placement_mix(slot), score;
+		size_t entry =
+			place->strategy == PLACEMENT_JUMP
+				? placement_jump(key, place->num_buckets)
+				: placement_best_entry(place, key, 0, place->num_buckets,
+									   &score);
+
+		if (place->buckets[entry] != index &&
+			(place->strategy != PLACEMENT_JUMP || entry < kept))
+			continue;
+
+		changes[count++] = (placement_change){
+			.slot = slot,
+			.from = place->members[place->buckets[entry]].server,
+		};
+	}
+
+	return count;
+}
+
+/** Serverul fiecarei pozitii din tabela Maglev, inainte de o schimbare. */
+static server_memory **placement_table_owners(const placement *place)
+{
+	if (!place->num_members)
+		return NULL;
+
+	server_memory **owners = malloc(MAGLEV_TABLE_SIZE * sizeof(*owners));
+	DIE(!owners, "failed malloc() of the Maglev owners");
+
+	for (size_t i = 0; i < MAGLEV_TABLE_SIZE; ++i)
+		owners[i] = place->members[place->table[i]].server;
+
+	return owners;
+}
+
+/** Compara tabela Maglev refacuta cu serverele de dinainte ale pozitiilor. */
+static size_t placement_table_diff(const placement *place,
+								   server_memory **owners,
+								   placement_change *changes)
+{
+	size_t count = 0;
+
+	if (!owners || !place->num_members)
+		return 0;
+
+	for (size_t i = 0; i < MAGLEV_TABLE_SIZE; ++i) {
+		server_memory *owner = place->members[place->table[i]].server;
+		if (owner != owners[i])
+			changes[count++] = (placement_change){i, owners[i], owner};
+	}
+
+	return count;
+}
+
+size_t placement_add(placement *place, int id, unsigned int weight,
+					 server_memory *server, placement_change *changes)
+{
+	size_t old_buckets = place->num_buckets, count = 0;
+	server_memory **owners = NULL;
+
+	if (changes && place->strategy == PLACEMENT_MAGLEV)
+		owners = placement_table_owners(place);
+
+	if (place->num_members == place->capacity) {
+		place->capacity = place->capacity ? 2 * place->capacity : 1;
+		place->members =
+			realloc(place->members,
+					place->capacity * sizeof(placement_member));
+		DIE(!place->members, "failed realloc() of placement.members");
+	}
+
+	size_t index = place->num_members++;
+	place->members[index] = (placement_member){id, weight, server};
+
+	switch (place->strategy) {
+	case PLACEMENT_JUMP:
+		/* Bucketurile noi se adauga la sfarsit, deci preiau chei de la
+		 * toate celelalte in mod egal. */
+		place->buckets =
+			realloc(place->buckets,
+					(place->num_buckets + weight) * sizeof(unsigned int));
+		DIE(!place->buckets, "failed realloc() of placement.buckets");
+		for (unsigned int i = 0; i < weight; ++i)
+			place->buckets[place->num_buckets++] = index;
+		if (changes)
+			count = placement_added(place, old_buckets, changes);
+		break;
+	case PLACEMENT_MAGLEV:
+		placement_build_table(place);
+		count = placement_table_diff(place, owners, changes);
+		free(owners);
+		break;
+	default:
+		/* Intrarile serverului nou sunt ultimele, iar celelalte raman
+		 * neschimbate. */
+		placement_build_entries(place);
+		if (changes)
+			count = placement_added(place, old_buckets, changes);
+	}
+
+	return count;
+}
+
+size_t placement_remove(placement *place, int id, placement_change *changes)
+{
+	size_t index = placement_index(place, id), count = 0;
+	server_memory **owners = NULL;
+
+	if (changes && place->strategy == PLACEMENT_MAGLEV)
+		owners = placement_table_owners(place);
+	else if (changes)
+		count = placement_leaving(place, index, changes);
+
+	--place->num_members;
+	memmove(&place->members[index], &place->members[index + 1],
+			(place->num_members - index) * sizeof(placement_member));
+
+	switch (place->strategy) {
+	case PLACEMENT_JUMP:
+		/* Jump consistent hash poate sterge doar ultimul bucket, deci fiecare
+		 * bucket al serverului este inlocuit de ultimul bucket ramas. Cheile
+		 * ultimelor `weight` bucketuri se redistribuie si ele, deci se muta
+		 * inca aproximativ `weight / num_buckets` din chei, mai putin cand
+		 * serverul sters este ultimul adaugat (bucketurile lui sunt chiar
+		 * ultimele). */
+		for (size_t i = place->num_buckets; i-- > 0;) {
+			if (place->buckets[i] == index)
+				place->buckets[i] =
+					place->buckets[--place->num_buckets];
+		}
+
+		for (size_t i = 0; i < place->num_buckets; ++i) {
+			if (place->buckets[i] > index)
+				--place->buckets[i];
+		}
+		break;
+	case PLACEMENT_MAGLEV:
+		placement_build_table(place);
+		count = placement_table_diff(place, owners, changes);
+		free(owners);
+		return count;
+	default:
+		placement_build_entries(place);
+	}
+
+	return changes ? placement_settle(place, changes, count) : 0;
+}
+
+size_t placement_memory(const placement *place)
+{
+	size_t memory = place->capacity * sizeof(placement_member);
+
+	if (place->strategy == PLACEMENT_MAGLEV && place->table)
+		memory += MAGLEV_TABLE_SIZE * sizeof(unsigned int);
+	if (place->buckets)
+		memory += place->num_buckets * sizeof(unsigned int);
+	if (place->seeds)
+		memory += place->num_buckets * sizeof(uint64_t);
+
+	return memory;
+}
+
+void placement_destroy(placement *place)
+{
+	free(place->members);
+	free(place->buckets);
+	free(place->seeds);
+	free(place->table);
+	placement_init(place, place->strategy);
+}
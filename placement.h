@@ -0,0 +1,258 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+#include <stddef.h>
+#include <stdint.h>
+
+#include "server.h"
+
+/**
+ * @file placement.h
+ * @brief Strategii de repartizare a cheilor pe servere, alternative
+ * hashringului.
+ *
+ * Toate strategiile impart hashurile cheilor in intervale consecutive (sloturi)
+ * si repartizeaza fiecare slot unui server. Astfel, la o schimbare a
+ * serverelor, obiectele mutate sunt exact cele din sloturile care si-au
+ * schimbat serverul, si se pot transfera pe intervale de hashuri, ca pe
+ * hashring.
+ */
+
+/** Numarul de sloturi pentru strategiile jump si rendezvous */
+#define PLACEMENT_SLOTS 65536
+/** Dimensiunea tabelei Maglev (numar prim, ca fiecare server sa o poata
+ * parcurge complet) */
+#define MAGLEV_TABLE_SIZE 65537
+
+/**
+ * @brief Algoritmul prin care se alege serverul unei chei.
+ */
+typedef enum {
+	/** hashringul sortat (consistent hashing cu labeluri), implicit */
+	PLACEMENT_RING,
+	/** jump consistent hash: fara memorie in afara listei de servere,
+	 * cautare in O(log n) */
+	PLACEMENT_JUMP,
+	/** tabela Maglev: cautare in O(1), putine obiecte mutate la schimbari */
+	PLACEMENT_MAGLEV,
+	/** rendezvous (highest random weight): cautare in O(n), cele mai putine
+	 * obiecte mutate */
+	PLACEMENT_RENDEZVOUS,
+} placement_strategy;
+
+/**
+ * @brief Un server, asa cum il vede o strategie de repartizare.
+ */
+typedef struct {
+	/** id-ul serverului */
+	int id;
+	/** ponderea serverului */
+	unsigned int weight;
+	/** serverul */
+	server_memory *server;
+} placement_member;
+
+/**
+ * @brief Un slot care si-a schimbat serverul la adaugarea sau stergerea unui
+ * server.
+ */
+typedef struct {
+	/** slotul */
+	size_t slot;
+	/** serverul de dinainte */
+	server_memory *from;
+	/** serverul de dupa */
+	server_memory *to;
+} placement_change;
+
+/**
+ * @class placement
+ * @brief Starea unei strategii de repartizare (alta decat `PLACEMENT_RING`).
+ *
+ * Un server cu ponderea `w` ocupa `w` bucketuri (jump), respectiv `w` intrari
+ * concurente (rendezvous) sau `w` pozitii la fiecare tura de umplere a
+ * tabelei (Maglev).
+ */
+typedef struct {
+	/** strategia folosita */
+	placement_strategy strategy;
+	/** serverele, in ordinea adaugarii (la jump, ordinea bucketurilor) */
+	placement_member *members;
+	/** numarul de servere */
+	size_t num_members;
+	/** dimensiunea alocata a lui `members` */
+	size_t capacity;
+	/** pozitia in `members` a serverului fiecarui bucket (jump) sau a
+	 * fiecarei intrari (rendezvous) */
+	unsigned int *buckets;
+	/** valorile cu care se amesteca hashul slotului pentru fiecare intrare
+	 * (rendezvous) */
+	uint64_t *seeds;
+	/** numarul de bucketuri, respectiv intrari */
+	size_t num_buckets;
+	/** pozitia in `members` a serverului fiecarui slot (Maglev) */
+	unsigned int *table;
+} placement;
+
+/**
+ * @brief Amesteca bitii unui cuvant (finalizatorul splitmix64).
+ */
+static inline uint64_t placement_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+/**
+ * @relates placement
+ * @brief Numarul de sloturi in care sunt impartite hashurile.
+ */
+static inline size_t placement_slots(const placement *place)
+{
+	return place->strategy == PLACEMENT_MAGLEV ? MAGLEV_TABLE_SIZE
+												   : PLACEMENT_SLOTS;
+}
+
+/**
+ * @relates placement
+ * @brief Slotul unui hash. Sloturile sunt intervale consecutive de hashuri.
+ */
+static inline size_t placement_slot(const placement *place,
+									unsigned int hash)
+{
+	return ((uint64_t)hash * placement_slots(place)) >> 32;
+}
+
+/**
+ * @brief Jump consistent hash (Lamping, Veach): bucketul, dintre
+ * `num_buckets`, al unei chei. La adaugarea unui bucket, se muta doar cheile
+ * care ajung in acesta.
+ */
+static inline size_t placement_jump(uint64_t key, size_t num_buckets)
+{
+	int64_t bucket = -1, next = 0;
+
+	while (next < (int64_t)num_buckets) {
+		bucket = next;
+		key = key * 2862933555777941757ull + 1;
+		next = (bucket + 1) * ((double)(1ll << 31) / (double)((key >> 33) + 1));
+	}
+
+	return bucket;
+}
+
+/**
+ * @relates placement
+ * @brief Cauta serverul caruia ii revine un hash.
+ *
+ * @param place		strategia (cu cel putin un server)
+ * @param hash		hashul cautat
+ *
+ * @return serverul gasit
+ */
+static inline placement_member *placement_find(const placement *place,
+											   unsigned int hash)
+{
+	size_t slot = placement_slot(place, hash);
+
+	if (place->strategy == PLACEMENT_MAGLEV)
+		return &place->members[place->table[slot]];
+
+	uint64_t key = placement_mix(slot);
+	if (place->strategy == PLACEMENT_JUMP) {
+		size_t bucket = placement_jump(key, place->num_buckets);
+		return &place->members[place->buckets[bucket]];
+	}
+
+	/* Castiga intrarea cu cel mai mare scor pentru acest slot. */
+	size_t best = 0;
+	uint64_t best_score = 0;
+	for (size_t i = 0; i < place->num_buckets; ++i) {
+		uint64_t score = placement_mix(key ^ place->seeds[i]);
+		if (score > best_score) {
+			best_score = score;
+			best = i;
+		}
+	}
+
+	return &place->members[place->buckets[best]];
+}
+
+/**
+ * @relates placement
+ * @brief Primul hash al unui slot (`UINT_MAX` pentru sfarsitul ultimului).
+ */
+unsigned int placement_slot_start(const placement *place, size_t slot);
+
+/**
+ * @relates placement
+ * @brief Initializeaza o strategie fara servere.
+ *
+ * @param place		strategia
+ * @param strategy	algoritmul folosit (diferit de `PLACEMENT_RING`)
+ */
+void placement_init(placement *place, placement_strategy strategy);
+
+/**
+ * @relates placement
+ * @brief Adauga un server si, optional, gaseste sloturile preluate de acesta.
+ *
+ * Sloturile mutate se gasesc fara a recalcula serverul fiecarui slot de 2
+ * ori: la jump se muta doar sloturile care ajung in bucketurile noi, la
+ * rendezvous doar cele in care o intrare noua are scorul mai mare decat
+ * castigatorul vechi, iar la Maglev tabela noua se compara cu cea veche.
+ *
+ * @param[in]	place		strategia
+ * @param[in]	id			id-ul serverului
+ * @param[in]	weight		ponderea serverului
+ * @param[in]	server		serverul
+ * @param[out]	changes		sloturile mutate, crescator (cel mult
+ *							`placement_slots(place)`), sau NULL daca nu
+ *							trebuie gasite
+ *
+ * @return numarul de sloturi mutate (0 daca nu existau servere inainte)
+ */
+size_t placement_add(placement *place, int id, unsigned int weight,
+					 server_memory *server, placement_change *changes);
+
+/**
+ * @relates placement
+ * @brief Sterge un server si, optional, gaseste sloturile mutate. La jump,
+ * bucketurile serverului sunt preluate de ultimele bucketuri, iar cheile
+ * acestora se redistribuie, deci se muta aproximativ de 2 ori mai multe chei
+ * decat minimul (mai putin la stergerea ultimului server adaugat).
+ *
+ * La jump si rendezvous se recalculeaza serverul doar pentru sloturile
+ * serverului sters (si ale ultimelor bucketuri, la jump), iar la Maglev
+ * tabela noua se compara cu cea veche.
+ *
+ * @param[in]	place		strategia
+ * @param[in]	id			id-ul serverului (care exista)
+ * @param[out]	changes		sloturile mutate, crescator (cel mult
+ *							`placement_slots(place)`), sau NULL daca nu
+ *							trebuie gasite
+ *
+ * @return numarul de sloturi mutate (0 daca nu mai raman servere)
+ */
+size_t placement_remove(placement *place, int id, placement_change *changes);
+
+/**
+ * @relates placement
+ * @brief Memoria folosita de strategie (in bytes).
+ *
+ * @param place strategia
+ */
+size_t placement_memory(const placement *place);
+
+/**
+ * @relates placement
+ * @brief Elibereaza memoria strategiei.
+ *
+ * @param place strategia
+ */
+void placement_destroy(placement *place);
+
+#endif /* PLACEMENT_H_ */
@@ -0,0 +1,402 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instrument.h"
+#include "replay.h"
+#include "utils.h"
+
+/**
+ * @brief Coada circulara de cereri citite, dar inca neexecutate.
+ */
+typedef struct {
+	/** cererile (`REPLAY_QUEUE_SIZE`) */
+	request *slots;
+	/** pozitia primei cereri */
+	size_t head;
+	/** numarul de cereri din coada */
+	size_t count;
+	/** daca s-a terminat fisierul */
+	bool done;
+	pthread_mutex_t lock;
+	/** semnalat cand apar cereri noi (sau se termina fisierul) */
+	pthread_cond_t not_empty;
+	/** semnalat cand se elibereaza locuri */
+	pthread_cond_t not_full;
+} request_queue;
+
+/**
+ * @brief Serverul si rezultatul unei cereri dintr-o fereastra.
+ */
+typedef struct {
+	/** serverul caruia ii revine cheia */
+	server_memory *server;
+	/** hashul cheii */
+	unsigned int hash;
+	/** id-ul serverului */
+	int server_id;
+	/** daca a fost gasita valoarea (`retrieve`) */
+	bool found;
+	/** pozitia valorii gasite in arena workerului */
+	size_t offset;
+	/** lungimea valorii gasite */
+	size_t len;
+} replay_entry;
+
+struct replay_state;
+
+/**
+ * @brief Un thread care executa cererile unor servere.
+ */
+typedef struct {
+	/** starea comuna */
+	struct replay_state *state;
+	pthread_t thread;
+	/** pozitiile cererilor din fereastra curenta, in ordine */
+	size_t *tasks;
+	/** numarul de cereri din fereastra curenta */
+	size_t num_tasks;
+	/** copiile valorilor gasite in fereastra curenta (un `store` ulterior pe
+	 * aceeasi cheie ar elibera valoarea de pe server) */
+	char *arena;
+	/** cati bytes din arena sunt folositi */
+	size_t arena_len;
+	/** dimensiunea alocata a arenei */
+	size_t arena_capacity;
+} replay_worker;
+
+/**
+ * @brief Starea comuna a threadurilor.
+ */
+typedef struct replay_state {
+	/** cererile citite */
+	request_queue queue;
+	/** cititorul cererilor */
+	request_reader *reader;
+	/** cererile ferestrei curente */
+	request *window;
+	/** serverele si rezultatele cererilor din fereastra */
+	replay_entry *entries;
+	/** workerii */
+	replay_worker *workers;
+	/** numarul de workeri */
+	unsigned int num_workers;
+
+	pthread_mutex_t lock;
+	/** semnalat cand incepe o fereastra (sau se opresc workerii) */
+	pthread_cond_t start;
+	/** semnalat cand toti workerii au terminat fereastra */
+	pthread_cond_t finished;
+	/** numarul ferestrei curente */
+	unsigned long generation;
+	/** cati workeri nu au terminat fereastra */
+	unsigned int pending;
+	/** daca workerii trebuie sa se opreasca */
+	bool stop;
+} replay_state;
+
+static void queue_init(request_queue *queue)
+{
+	*queue = (request_queue){0};
+	queue->slots = malloc(REPLAY_QUEUE_SIZE * sizeof(request));
+	DIE(!queue->slots, "failed malloc() of queue.slots");
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->not_empty, NULL);
+	pthread_cond_init(&queue->not_full, NULL);
+}
+
+static void queue_destroy(request_queue *queue)
+{
+	pthread_cond_destroy(&queue->not_full);
+	pthread_cond_destroy(&queue->not_empty);
+	pthread_mutex_destroy(&queue->lock);
+	free(queue->slots);
+}
+
+/** Adauga o cerere, asteptand daca coada este plina. */
+static void queue_push(request_queue *queue, const request *req)
+{
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == REPLAY_QUEUE_SIZE)
+		pthread_cond_wait(&queue->not_full, &queue->lock);
+
+	queue->slots[(queue->head + queue->count) % REPLAY_QUEUE_SIZE] = *req;
+	++queue->count;
+	pthread_cond_signal(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/** Marcheaza sfarsitul fisierului. */
+static void queue_close(request_queue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	queue->done = true;
+	pthread_cond_signal(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Scoate din coada cel mult `max` cereri, asteptand pana exista cel putin
+ * una. Intoarce 0 doar daca s-a terminat fisierul.
+ */
+static size_t queue_pop(request_queue *queue, request *dest, size_t max)
+{
+	pthread_mutex_lock(&queue->lock);
+	while (!queue->count && !queue->done)
+		pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+	size_t count = queue->count < max ? queue->count : max;
+	for (size_t i = 0; i < count; ++i)
+		dest[i] = queue->slots[(queue->head + i) % REPLAY_QUEUE_SIZE];
+
+	queue->head = (queue->head + count) % REPLAY_QUEUE_SIZE;
+	queue->count -= count;
+	pthread_cond_signal(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+	return count;
+}
+
+/** Citeste toate cererile din fisier, in coada. */
+static void *parser_thread(void *arg)
+{
+	replay_state *state = arg;
+	request req;
+
+	while (request_reader_next(state->reader, &req))
+		queue_push(&state->queue, &req);
+
+	queue_close(&state->queue);
+	return NULL;
+}
+
+/** Copiaza o valoare gasita in arena workerului. */
+static void worker_keep_value(replay_worker *worker, replay_entry *entry,
+							  const char *value)
+{
+	size_t len = dict_data_size(value);
+	size_t needed = worker->arena_len + len;
+
+	if (needed > worker->arena_capacity) {
+		worker->arena_capacity = 2 * worker->arena_capacity > needed
+									 ? 2 * worker->arena_capacity
+									 : needed;
+		worker->arena = realloc(worker->arena, worker->arena_capacity);
+		DIE(!worker->arena, "failed realloc() of worker.arena");
+	}
+
+	memcpy(worker->arena + worker->arena_len, value, len);
+	entry->offset = worker->arena_len;
+	entry->len = len;
+	worker->arena_len += len;
+}
+
+/** Executa cererile workerului din fereastra curenta. */
+static void worker_run(replay_worker *worker)
+{
+	replay_state *state = worker->state;
+
+	worker->arena_len = 0;
+	for (size_t i = 0; i < worker->num_tasks; ++i) {
+		request *req = &state->window[worker->tasks[i]];
+		replay_entry *entry = &state->entries[worker->tasks[i]];
+
+		INSTRUMENT_BEGIN(span);
+		if (req->type == REQUEST_STORE) {
+			server_store(entry->server, req->key.data, entry->hash,
+						 req->value.data, req->value.len);
+			INSTRUMENT_END(INSTRUMENT_STORE, span);
+			continue;
+		}
+
+		char *value =
+			server_retrieve(entry->server, req->key.data, entry->hash);
+		INSTRUMENT_END(INSTRUMENT_RETRIEVE, span);
+		entry->found = value;
+		if (value)
+			worker_keep_value(worker, entry, value);
+	}
+}
+
+static void *worker_thread(void *arg)
+{
+	replay_worker *worker = arg;
+	replay_state *state = worker->state;
+	unsigned long generation = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&state->lock);
+		while (state->generation == generation && !state->stop)
+			pthread_cond_wait(&state->start, &state->lock);
+		if (state->stop) {
+			pthread_mutex_unlock(&state->lock);
+			return NULL;
+		}
+		generation = state->generation;
+		pthread_mutex_unlock(&state->lock);
+
+		worker_run(worker);
+
+		pthread_mutex_lock(&state->lock);
+		if (!--state->pending)
+			pthread_cond_signal(&state->finished);
+		pthread_mutex_unlock(&state->lock);
+	}
+}
+
+/** Workerul care executa cererile unui server. */
+static inline unsigned int replay_owner(replay_state *state, int server_id)
+{
+	return (unsigned int)server_id % state->num_workers;
+}
+
+/**
+ * Executa primele `count` cereri din fereastra (doar `store` si `retrieve`)
+ * si scrie rezultatele in ordine.
+ */
+static void replay_window(replay_state *state, load_balancer *main,
+						  size_t count, output_writer *out)
+{
+	if (!count)
+		return;
+
+	for (unsigned int i = 0; i < state->num_workers; ++i)
+		state->workers[i].num_tasks = 0;
+
+	/* Toate cererile unui server ajung la acelasi worker, in ordine. Nodurile
+	 * unui server sunt alocate si eliberate doar din slabul lui, deci workerii
+	 * nu au nevoie de lockuri. */
+	for (size_t i = 0; i < count; ++i) {
+		replay_entry *entry = &state->entries[i];
+		entry->server = loader_route(main, state->window[i].key.data,
+									 &entry->hash, &entry->server_id);
+
+		replay_worker *worker =
+			&state->workers[replay_owner(state, entry->server_id)];
+		worker->tasks[worker->num_tasks++] = i;
+	}
+
+	pthread_mutex_lock(&state->lock);
+	state->pending = state->num_workers;
+	++state->generation;
+	pthread_cond_broadcast(&state->start);
+	while (state->pending)
+		pthread_cond_wait(&state->finished, &state->lock);
+	pthread_mutex_unlock(&state->lock);
+
+	for (size_t i = 0; i < count; ++i) {
+		request *req = &state->window[i];
+		replay_entry *entry = &state->entries[i];
+
+		if (req->type == REQUEST_STORE) {
+			output_stored(out, req->value.data, req->value.len,
+						  entry->server_id);
+		} else if (entry->found) {
+			replay_worker *worker =
+				&state->workers[replay_owner(state, entry->server_id)];
+			output_retrieved(out, worker->arena + entry->offset, entry->len,
+							 entry->server_id);
+		} else {
+			output_missing(out, req->key.data, req->key.len);
+		}
+	}
+}
+
+/**
+ * Executa o adaugare sau stergere de server, sau afiseaza ocuparea lor (toti
+ * workerii sunt opriti). O linie necunoscuta opreste programul, dupa ce
+ * rezultatele cererilor dinaintea ei au fost scrise in buffer.
+ */
+static void replay_barrier(load_balancer *main, request *req,
+						   output_writer *out)
+{
+	if (req->type == REQUEST_ADD_SERVER)
+		loader_add_server(main, req->server_id, req->weight);
+	else if (req->type == REQUEST_REMOVE_SERVER)
+		loader_remove_server(main, req->server_id);
+	else if (req->type == REQUEST_STATS)
+		output_stats(out, main);
+	else
+		DIE(1, "unknown function call");
+}
+
+void replay_pipeline(load_balancer *main, request_reader *reader,
+					 output_writer *out, unsigned int num_workers)
+{
+	replay_state state = {.reader = reader, .num_workers = num_workers};
+	pthread_t parser;
+
+	queue_init(&state.queue);
+	pthread_mutex_init(&state.lock, NULL);
+	pthread_cond_init(&state.start, NULL);
+	pthread_cond_init(&state.finished, NULL);
+
+	state.window = malloc(REPLAY_WINDOW * sizeof(request));
+	state.entries = malloc(REPLAY_WINDOW * sizeof(replay_entry));
+	state.workers = calloc(num_workers, sizeof(replay_worker));
+	DIE(!state.window || !state.entries || !state.workers,
+		"failed malloc() of the replay window");
+
+	for (unsigned int i = 0; i < num_workers; ++i) {
+		replay_worker *worker = &state.workers[i];
+		worker->state = &state;
+		worker->tasks = malloc(REPLAY_WINDOW * sizeof(size_t));
+		DIE(!worker->tasks, "failed malloc() of worker.tasks");
+		DIE(pthread_create(&worker->thread, NULL, worker_thread, worker),
+			"failed pthread_create() of a worker");
+	}
+
+	/* Cheile si valorile raman in maparea fisierului pana cand sunt scrise
+	 * rezultatele lor. */
+	request_reader_consume(reader, 0);
+	DIE(pthread_create(&parser, NULL, parser_thread, &state),
+		"failed pthread_create() of the parser");
+
+	size_t count = 0;
+	for (;;) {
+		size_t fetched = 0;
+		if (count < REPLAY_WINDOW)
+			fetched = queue_pop(&state.queue, state.window + count,
+								REPLAY_WINDOW - count);
+		if (!fetched && !count)
+			break;
+		count += fetched;
+
+		size_t executed = 0;
+		while (executed < count &&
+			   (state.window[executed].type == REQUEST_STORE ||
+				state.window[executed].type == REQUEST_RETRIEVE))
+			++executed;
+
+		replay_window(&state, main, executed, out);
+		if (executed < count)
+			replay_barrier(main, &state.window[executed++], out);
+
+		request_reader_consume(reader, state.window[executed - 1].end);
+		INSTRUMENT_POLL(stderr);
+		memmove(state.window, state.window + executed,
+				(count - executed) * sizeof(request));
+		count -= executed;
+	}
+
+	pthread_mutex_lock(&state.lock);
+	state.stop = true;
+	pthread_cond_broadcast(&state.start);
+	pthread_mutex_unlock(&state.lock);
+
+	for (unsigned int i = 0; i < num_workers; ++i) {
+		pthread_join(state.workers[i].thread, NULL);
+		free(state.workers[i].tasks);
+		free(state.workers[i].arena);
+	}
+	pthread_join(parser, NULL);
+
+	free(state.workers);
+	free(state.entries);
+	free(state.window);
+	pthread_cond_destroy(&state.finished);
+	pthread_cond_destroy(&state.start);
+	pthread_mutex_destroy(&state.lock);
+	queue_destroy(&state.queue);
+}
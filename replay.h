@@ -0,0 +1,41 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include "load_balancer.h"
+#include "output.h"
+#include "requests.h"
+
+/**
+ * @file replay.h
+ * @brief Executarea cererilor din fisierul de intrare pe mai multe threaduri.
+ *
+ * Un thread citeste cererile si le pune intr-o coada circulara. Threadul
+ * principal le ia din coada in ferestre de cel mult `REPLAY_WINDOW` cereri,
+ * gaseste serverul fiecarei chei si imparte cererile workerilor dupa server,
+ * deci cererile pentru aceeasi cheie se executa in ordinea din fisier. Dupa
+ * ce workerii termina fereastra, rezultatele sunt scrise in ordinea cererilor.
+ * Adaugarile si stergerile de servere (si cererile `stats`) inchid fereastra
+ * curenta si se executa singure, ca rezultatele sa fie aceleasi ca la
+ * executarea pe rand.
+ */
+
+/** Numarul maxim de cereri dintr-o fereastra */
+#define REPLAY_WINDOW 4096
+/** Capacitatea cozii dintre threadul care citeste cererile si cel principal */
+#define REPLAY_QUEUE_SIZE 8192
+
+/**
+ * @brief Executeaza toate cererile ramase dintr-un fisier, pe mai multe
+ * threaduri. Load balancerul nu poate folosi modurile in care o cheie nu are
+ * un singur server (vezi `loader_route`).
+ *
+ * @param main			load balancerul
+ * @param reader		cererile
+ * @param out			unde se scriu rezultatele
+ * @param num_workers	numarul de threaduri care executa cererile
+ */
+void replay_pipeline(load_balancer *main, request_reader *reader,
+					 output_writer *out, unsigned int num_workers);
+
+#endif /* REPLAY_H_ */
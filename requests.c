@@ -0,0 +1,213 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _DEFAULT_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "requests.h"
+#include "utils.h"
+
+/** Paginile deja citite sunt eliberate in bucati de cel putin atatia bytes */
+#define RELEASE_CHUNK (64 << 20)
+
+void request_reader_open(request_reader *reader, const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	DIE(fd < 0, "missing input file");
+
+	struct stat info;
+	DIE(fstat(fd, &info), "failed fstat() of the input file");
+
+	*reader = (request_reader){.size = info.st_size, .consumed = SIZE_MAX};
+	if (reader->size) {
+		/* Maparea e privata, deci terminatorii scrisi in ea nu ajung in
+		 * fisier. */
+		reader->data = mmap(NULL, reader->size, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE, fd, 0);
+		DIE(reader->data == MAP_FAILED, "failed mmap() of the input file");
+		madvise(reader->data, reader->size, MADV_SEQUENTIAL);
+	}
+
+	close(fd);
+}
+
+/**
+ * Elibereaza paginile de dinaintea liniei care incepe la `pos` (copiile
+ * private ale paginilor modificate, altfel ar ramane in memorie pana la
+ * sfarsit), dar nu si pe cele ale cererilor inca nefolosite.
+ */
+static void request_reader_release(request_reader *reader, size_t pos)
+{
+	size_t consumed = __atomic_load_n(&reader->consumed, __ATOMIC_ACQUIRE);
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t end = (pos < consumed ? pos : consumed) / page * page;
+
+	if (end < reader->released || end - reader->released < RELEASE_CHUNK)
+		return;
+
+	madvise(reader->data + reader->released, end - reader->released,
+			MADV_DONTNEED);
+	reader->released = end;
+}
+
+/** Cauta un caracter intr-o linie, de la `from` (intoarce `len` daca nu
+ * exista). */
+static size_t find_char(const char *line, size_t len, size_t from, char c)
+{
+	if (from >= len)
+		return len;
+
+	const char *found = memchr(line + from, c, len - from);
+	return found ? (size_t)(found - line) : len;
+}
+
+/** Citeste un numar intreg de la `*pos`, sarind spatiile dinainte, ca
+ * `atoi`. */
+static bool parse_number(const char *line, size_t len, size_t *pos,
+						 long *number)
+{
+	size_t i = *pos;
+	while (i < len && isspace((unsigned char)line[i]))
+		++i;
+
+	bool negative = i < len && line[i] == '-';
+	if (i < len && (line[i] == '-' || line[i] == '+'))
+		++i;
+	if (i == len || !isdigit((unsigned char)line[i]))
+		return false;
+
+	long value = 0;
+	while (i < len && isdigit((unsigned char)line[i]))
+		value = 10 * value + (line[i++] - '0');
+
+	*number = negative ? -value : value;
+	*pos = i;
+	return true;
+}
+
+/**
+ * `store "<cheie>" "<valoare>"`: cheia este intre primele 2 ghilimele, iar
+ * valoarea incepe dupa a 3-a si se termina inaintea ultimului caracter al
+ * liniei (ghilimelele de inchidere).
+ */
+static void parse_store(char *line, size_t len, request *req)
+{
+	size_t key_start = find_char(line, len, 0, '"') + 1;
+	if (key_start > len)
+		key_start = len;
+	size_t key_end = find_char(line, len, key_start, '"');
+	size_t value_start = find_char(line, len, key_end + 1, '"') + 1;
+	size_t value_end = len - 1;
+
+	/* Fara valoare, ambele string-uri se termina la `len`: dupa linie
+	 * urmeaza mereu '\n', peste care se poate scrie. */
+	if (value_start >= len)
+		value_start = value_end = len;
+
+	line[key_end] = '\0';
+	req->key = (string_view){line + key_start, key_end - key_start};
+
+	line[value_end] = '\0';
+	req->value = (string_view){line + value_start, value_end - value_start};
+}
+
+/** `retrieve "<cheie>"`: cheia contine caracterele de dupa primele
+ * ghilimele, fara ghilimele. */
+static void parse_retrieve(char *line, size_t len, request *req)
+{
+	size_t start = find_char(line, len, 0, '"');
+	size_t key_len = 0;
+	char *key = line + (start < len ? start + 1 : len);
+
+	for (size_t i = start + 1; i < len; ++i) {
+		if (line[i] != '"')
+			key[key_len++] = line[i];
+	}
+
+	key[key_len] = '\0';
+	req->key = (string_view){key, key_len};
+}
+
+/** Verifica daca o linie incepe cu numele unei comenzi (un literal). */
+#define HAS_COMMAND(line, len, command)                                        \
+	((len) >= sizeof(command) - 1 &&                                           \
+	 !memcmp(line, command, sizeof(command) - 1))
+
+/** Interpreteaza o linie (urmata de un '\n' in memorie). */
+static void parse_request(char *line, size_t len, request *req)
+{
+	long number;
+
+	if (HAS_COMMAND(line, len, "store")) {
+		req->type = REQUEST_STORE;
+		parse_store(line, len, req);
+	} else if (HAS_COMMAND(line, len, "retrieve")) {
+		req->type = REQUEST_RETRIEVE;
+		parse_retrieve(line, len, req);
+	} else if (HAS_COMMAND(line, len, "add_server")) {
+		/* Ponderea este optionala: "add_server <id> [pondere]". */
+		size_t pos = sizeof("add_server");
+		req->type = REQUEST_ADD_SERVER;
+		req->server_id = 0;
+		req->weight = 1;
+		if (parse_number(line, len, &pos, &number)) {
+			req->server_id = number;
+			if (parse_number(line, len, &pos, &number))
+				req->weight = number;
+		}
+	} else if (HAS_COMMAND(line, len, "remove_server")) {
+		size_t pos = sizeof("remove_server");
+		req->type = REQUEST_REMOVE_SERVER;
+		req->server_id = parse_number(line, len, &pos, &number) ? number : 0;
+	} else if (HAS_COMMAND(line, len, "stats")) {
+		req->type = REQUEST_STATS;
+	} else {
+		/* Eroarea este semnalata abia la executarea liniei, dupa ce au fost
+		 * executate (si scrise) toate cererile dinaintea ei. */
+		req->type = REQUEST_INVALID;
+	}
+}
+
+bool request_reader_next(request_reader *reader, request *req)
+{
+	if (reader->pos >= reader->size)
+		return false;
+
+	size_t start = reader->pos;
+	request_reader_release(reader, start);
+
+	char *line = reader->data + start;
+	size_t len = find_char(line, reader->size - start, 0, '\n');
+
+	if (start + len == reader->size) {
+		/* Ultima linie nu are '\n', deci este copiata, ca terminatorii sa nu
+		 * fie scrisi dupa sfarsitul maparii. */
+		reader->tail = malloc(len + 1);
+		DIE(!reader->tail, "failed malloc() of the last request");
+		memcpy(reader->tail, line, len);
+		reader->tail[len] = '\n';
+		line = reader->tail;
+	}
+
+	reader->pos = start + len + 1;
+	req->end = reader->pos;
+	parse_request(line, len, req);
+	return true;
+}
+
+void request_reader_consume(request_reader *reader, size_t end)
+{
+	__atomic_store_n(&reader->consumed, end, __ATOMIC_RELEASE);
+}
+
+void request_reader_close(request_reader *reader)
+{
+	free(reader->tail);
+	if (reader->size)
+		munmap(reader->data, reader->size);
+}
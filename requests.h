@@ -0,0 +1,124 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef REQUESTS_H_
+#define REQUESTS_H_
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file requests.h
+ * @brief Citirea cererilor din fisierul de intrare, fara copieri.
+ *
+ * Fisierul este mapat in memorie (privat, deci modificarile nu ajung pe disc),
+ * iar cererile sunt interpretate pe loc: cheile si valorile sunt terminate cu
+ * '\0' direct in maparea fisierului, peste ghilimelele care le incheie. Liniile
+ * pot avea orice lungime.
+ */
+
+/**
+ * @brief O bucata dintr-un string (pointer si lungime), terminata cu '\0'.
+ */
+typedef struct {
+	/** inceputul bucatii */
+	char *data;
+	/** lungimea bucatii (fara '\0') */
+	size_t len;
+} string_view;
+
+/**
+ * @brief Tipul unei cereri.
+ */
+typedef enum {
+	/** `store "<cheie>" "<valoare>"` */
+	REQUEST_STORE,
+	/** `retrieve "<cheie>"` */
+	REQUEST_RETRIEVE,
+	/** `add_server <id> [pondere]` */
+	REQUEST_ADD_SERVER,
+	/** `remove_server <id>` */
+	REQUEST_REMOVE_SERVER,
+	/** `stats` (afiseaza ocuparea fiecarui server) */
+	REQUEST_STATS,
+	/** o linie necunoscuta; executarea ei opreste programul */
+	REQUEST_INVALID,
+} request_type;
+
+/**
+ * @brief O cerere din fisierul de intrare.
+ */
+typedef struct {
+	/** tipul cererii */
+	request_type type;
+	/** cheia (`store`, `retrieve`) */
+	string_view key;
+	/** valoarea (`store`) */
+	string_view value;
+	/** id-ul serverului (`add_server`, `remove_server`) */
+	int server_id;
+	/** ponderea serverului (`add_server`, implicit 1) */
+	unsigned int weight;
+	/** pozitia de dupa linia cererii, in fisier */
+	size_t end;
+} request;
+
+/**
+ * @class request_reader
+ * @brief Un fisier de intrare mapat in memorie.
+ */
+typedef struct {
+	/** maparea fisierului */
+	char *data;
+	/** dimensiunea fisierului */
+	size_t size;
+	/** inceputul urmatoarei linii */
+	size_t pos;
+	/** pana unde au fost deja eliberate paginile citite */
+	size_t released;
+	/** pana unde cererile au fost folosite complet (paginile de dupa nu se
+	 * elibereaza) */
+	size_t consumed;
+	/** copia ultimei linii, daca nu se termina cu '\n' */
+	char *tail;
+} request_reader;
+
+/**
+ * @relates request_reader
+ * @brief Mapeaza in memorie un fisier de intrare.
+ *
+ * @param reader	cititorul initializat
+ * @param path		calea fisierului
+ */
+void request_reader_open(request_reader *reader, const char *path);
+
+/**
+ * @relates request_reader
+ * @brief Interpreteaza urmatoarea cerere. Paginile citite sunt eliberate
+ * treptat, deci cheile si valorile raman valide doar pana la urmatorul apel
+ * (sau, dupa `request_reader_consume`, pana cand sunt marcate ca folosite).
+ *
+ * @param[in]	reader	cititorul
+ * @param[out]	req		cererea citita
+ *
+ * @return daca a existat o cerere (altfel s-a terminat fisierul)
+ */
+bool request_reader_next(request_reader *reader, request *req);
+
+/**
+ * @relates request_reader
+ * @brief Marcheaza cererile de pana la `end` ca folosite complet. Dupa primul
+ * apel, se elibereaza doar paginile cererilor marcate, deci functia poate fi
+ * apelata din alt thread decat cel care citeste cererile.
+ *
+ * @param reader	cititorul
+ * @param end		pozitia de dupa ultima cerere folosita (`request.end`)
+ */
+void request_reader_consume(request_reader *reader, size_t end);
+
+/**
+ * @relates request_reader
+ * @brief Elibereaza maparea fisierului.
+ *
+ * @param reader cititorul
+ */
+void request_reader_close(request_reader *reader);
+
+#endif /* REQUESTS_H_ */
@@ -1,79 +1,297 @@
 /* Copyright 2023 Sima Alexandru (312CA) */
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "hashtable.h"
+#include "instrument.h"
 #include "server.h"
 #include "utils.h"
 
 #define BUCKET_NO 421
 
+/** Factorul de incarcare peste care se mareste baza de date */
+#define LOAD_FACTOR 1.0
+
+/** Factorul de incarcare pentru bazele de date cu adresare deschisa, care
+ * trebuie sa aiba mereu pozitii libere */
+#define FLAT_LOAD_FACTOR 0.8
+
 struct server_memory {
 	/** hashtable care contine
 	 *obiectele stocate pe server */
 	hashtable *database;
+	/** obiectele care nu revin serverului dupa hash, ci au fost mutate aici
+	 * de pe un server plin (NULL pana la primul astfel de obiect) */
+	hashtable *displaced;
+	/** numar impar cat timp baza de date este modificata */
+	unsigned long seq;
+	/** daca modificarile iau `lock` */
+	bool locking;
+	/** serializeaza modificarile facute din threaduri diferite */
+	pthread_mutex_t lock;
 };
 
-static int compare_server_entries(void *a, void *b)
+server_memory *init_server_memory(ht_engine engine)
+{
+	struct server_memory *server = malloc(sizeof(struct server_memory));
+	DIE(!server, "failed malloc() of server_memory");
+
+	double load_factor =
+		engine == HT_ENGINE_FLAT ? FLAT_LOAD_FACTOR : LOAD_FACTOR;
+	server->database = ht_create(engine, BUCKET_NO, load_factor);
+	DIE(!server->database, "failed malloc() of server_memory.database");
+	server->displaced = NULL;
+	server->seq = 0;
+	server->locking = false;
+	return server;
+}
+
+void server_enable_locking(server_memory *server)
 {
-	return strcmp((char *)a, (char *)b);
+	if (server->locking)
+		return;
+
+	DIE(pthread_mutex_init(&server->lock, NULL),
+		"failed pthread_mutex_init() of server_memory.lock");
+	ht_enable_locking(server->database);
+	server->locking = true;
 }
 
-static void free_server_entry(void *key, void *data)
+void server_hold(server_memory *server)
 {
-	free(key);
-	free(data);
+	if (server->locking)
+		pthread_mutex_lock(&server->lock);
 }
 
-static char *copy_string(char *s)
+void server_release(server_memory *server)
 {
-	char *copy = malloc(strlen(s) + 1);
-	DIE(!copy, "failed malloc() of copy");
+	if (server->locking)
+		pthread_mutex_unlock(&server->lock);
+}
 
-	strcpy(copy, s);
-	return copy;
+void server_write_begin(server_memory *server)
+{
+	/* Cititorii concurenti vad un numar impar pana la `server_write_end`. */
+	__atomic_store_n(&server->seq, server->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
 }
 
-server_memory *init_server_memory()
+void server_write_end(server_memory *server)
 {
-	struct server_memory *server = malloc(sizeof(struct server_memory));
-	DIE(!server, "failed malloc() of server_memory");
+	__atomic_store_n(&server->seq, server->seq + 1, __ATOMIC_RELEASE);
+}
 
-	server->database = ht_create(BUCKET_NO, hash_function_key,
-								 compare_server_entries, free_server_entry);
-	DIE(!server->database, "failed malloc() of server_memory.database");
-	return server;
+void server_lock(server_memory *server)
+{
+	server_hold(server);
+	server_write_begin(server);
+}
+
+void server_unlock(server_memory *server)
+{
+	server_write_end(server);
+	server_release(server);
+}
+
+void server_store(server_memory *server, char *key, unsigned int hash,
+				  char *value, unsigned int value_size)
+{
+	/* Cheile sunt copiate impreuna cu terminatorul. Valorile primesc unul
+	 * in plus, ca valoarea intoarsa de `server_retrieve` sa poata fi
+	 * folosita direct ca sir de caractere. */
+	ht_store_item(server->database, key, strlen(key) + 1, hash, value,
+				  value_size);
+}
+
+char *server_retrieve(server_memory *server, char *key, unsigned int hash)
+{
+	return ht_retrieve_item(server->database, key, strlen(key) + 1, hash);
+}
+
+void server_prefetch_bucket(server_memory *server, unsigned int hash)
+{
+	ht_prefetch_bucket(server->database, hash);
 }
 
-void server_store(server_memory *server, char *key, char *value)
+void server_prefetch_node(server_memory *server, unsigned int hash)
 {
-	char *key_copy = copy_string(key);
-	DIE(!key_copy, "failed strdup() of key");
+	ht_prefetch_node(server->database, hash);
+}
+
+char *server_lookup(server_memory *server, char *key, unsigned int hash)
+{
+	unsigned int key_size = strlen(key) + 1;
+
+	for (;;) {
+		unsigned long seq = __atomic_load_n(&server->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
 
-	char *value_copy = copy_string(value);
-	DIE(!value_copy, "failed strdup() of value");
+		char *value = ht_lookup_item(server->database, key, key_size, hash);
 
-	ht_store_item(server->database, key_copy, value_copy);
+		/* Daca serverul nu a fost modificat intre timp, rezultatul e
+		 * corect; altfel cautarea se reia. */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&server->seq, __ATOMIC_RELAXED) == seq)
+			return value;
+	}
 }
 
-char *server_retrieve(server_memory *server, char *key)
+void server_store_displaced(server_memory *server, char *key,
+							unsigned int hash, char *value,
+							unsigned int value_size)
 {
-	return ht_retrieve_item(server->database, key);
+	if (!server->displaced) {
+		ht_engine engine = server->database->engine;
+		server->displaced = ht_create(
+			engine, BUCKET_NO,
+			engine == HT_ENGINE_FLAT ? FLAT_LOAD_FACTOR : LOAD_FACTOR);
+		DIE(!server->displaced,
+			"failed malloc() of server_memory.displaced");
+	}
+
+	ht_store_item(server->displaced, key, strlen(key) + 1, hash, value,
+				  value_size);
 }
 
-void server_remove(server_memory *server, char *key)
+char *server_retrieve_displaced(server_memory *server, char *key,
+								unsigned int hash)
 {
-	ht_remove_item(server->database, key);
+	if (!server->displaced)
+		return NULL;
+	return ht_retrieve_item(server->displaced, key, strlen(key) + 1, hash);
+}
+
+bool server_remove_displaced(server_memory *server, char *key,
+							 unsigned int hash)
+{
+	if (!server->displaced)
+		return false;
+	return ht_remove_item(server->displaced, key, strlen(key) + 1, hash);
+}
+
+void server_for_each(server_memory *server,
+					 void (*func)(dict_entry *entry, void *arg), void *arg)
+{
+	ht_for_each(server->database, func, arg);
+	if (server->displaced)
+		ht_for_each(server->displaced, func, arg);
+}
+
+size_t server_size(server_memory *server)
+{
+	size_t size = ht_size(server->database);
+
+	if (server->displaced)
+		size += ht_size(server->displaced);
+	return size;
+}
+
+bool server_remove(server_memory *server, char *key, unsigned int hash)
+{
+	return ht_remove_item(server->database, key, strlen(key) + 1, hash);
+}
+
+void server_set_reclaimer(server_memory *server, epoch *reclaimer)
+{
+	ht_set_reclaimer(server->database, reclaimer);
 }
 
 void free_server_memory(server_memory *server)
 {
+	if (server->locking)
+		pthread_mutex_destroy(&server->lock);
 	ht_destroy(server->database);
+	if (server->displaced)
+		ht_destroy(server->displaced);
 	free(server);
 }
 
-void transfer_items(server_memory *dest, server_memory *src,
-					unsigned int min_hash, unsigned int max_hash)
+void server_memory_usage(server_memory *server, size_t *used,
+						 size_t *reserved)
+{
+	ht_memory_usage(server->database, used, reserved);
+
+	if (server->displaced) {
+		size_t displaced_used, displaced_reserved;
+
+		ht_memory_usage(server->displaced, &displaced_used,
+						&displaced_reserved);
+		*used += displaced_used;
+		*reserved += displaced_reserved;
+	}
+}
+
+void server_get_stats(server_memory *server, server_stats *stats)
+{
+	ht_get_stats(server->database, &stats->total);
+	server_memory_usage(server, &stats->slab_used, &stats->slab_reserved);
+	stats->displaced_keys = 0;
+	if (!server->displaced)
+		return;
+
+	ht_stats displaced;
+	ht_get_stats(server->displaced, &displaced);
+	stats->displaced_keys = displaced.size;
+	stats->total.size += displaced.size;
+	stats->total.key_bytes += displaced.key_bytes;
+	stats->total.value_bytes += displaced.value_bytes;
+	stats->total.node_bytes += displaced.node_bytes;
+	stats->total.table_bytes += displaced.table_bytes;
+	if (displaced.longest_chain > stats->total.longest_chain)
+		stats->total.longest_chain = displaced.longest_chain;
+}
+
+size_t transfer_items(server_memory *dest, server_memory *src,
+					  unsigned int min_hash, unsigned int max_hash)
+{
+	INSTRUMENT_BEGIN(span);
+	size_t moved = ht_transfer_items(dest->database, src->database, min_hash,
+									 max_hash);
+	INSTRUMENT_COUNT(INSTRUMENT_MOVED_KEYS, moved);
+	INSTRUMENT_END(INSTRUMENT_TRANSFER, span);
+
+	return moved;
+}
+
+size_t transfer_ranges(server_memory *dest, server_memory *src,
+					   const hash_range *ranges, size_t count)
+{
+	INSTRUMENT_BEGIN(span);
+	size_t moved =
+		ht_transfer_ranges(dest->database, src->database, ranges, count);
+	INSTRUMENT_COUNT(INSTRUMENT_MOVED_KEYS, moved);
+	INSTRUMENT_END(INSTRUMENT_TRANSFER, span);
+
+	return moved;
+}
+
+size_t copy_ranges(server_memory *dest, server_memory *src,
+				   const hash_range *ranges, size_t count)
+{
+	size_t copied =
+		ht_copy_ranges(dest->database, src->database, ranges, count);
+	INSTRUMENT_COUNT(INSTRUMENT_MOVED_KEYS, copied);
+
+	return copied;
+}
+
+size_t server_remove_ranges(server_memory *server, const hash_range *ranges,
+							size_t count)
+{
+	return ht_remove_ranges(server->database, ranges, count);
+}
+
+size_t server_count_range(server_memory *server, unsigned int min_hash,
+						  unsigned int max_hash)
+{
+	return ht_count_range(server->database, min_hash, max_hash);
+}
+
+unsigned int server_range_bound(server_memory *server, unsigned int min_hash,
+								unsigned int max_hash, size_t count)
 {
-	ht_transfer_items(dest->database, src->database, min_hash, max_hash);
+	return ht_range_bound(server->database, min_hash, max_hash, count);
 }
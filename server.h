@@ -2,6 +2,8 @@
 #ifndef SERVER_H_
 #define SERVER_H_
 
+#include "hashtable.h"
+
 /**
  * @class server_memory
  * @brief Server care poate memora, cauta si sterge obiecte.
@@ -9,13 +11,30 @@
 struct server_memory;
 typedef struct server_memory server_memory;
 
+/**
+ * @brief Ocuparea unui server, calculata de `server_get_stats`.
+ */
+typedef struct {
+	/** totalurile obiectelor de pe server (inclusiv ale celor mutate de pe
+	 * alte servere; `longest_chain` este maximul celor 2 hashtable-uri) */
+	ht_stats total;
+	/** cate dintre obiecte au fost mutate aici de pe servere pline */
+	size_t displaced_keys;
+	/** memoria ocupata de blocurile obiectelor (vezi `server_memory_usage`) */
+	size_t slab_used;
+	/** memoria rezervata de server pentru blocuri */
+	size_t slab_reserved;
+} server_stats;
+
 /**
  * @relates server_memory
  * @brief aloca si initializeaza un server.
  *
+ * @param engine modul in care serverul isi organizeaza baza de date
+ *
  * @return un nou server initializat
  */
-server_memory *init_server_memory();
+server_memory *init_server_memory(ht_engine engine);
 
 /**
  * @relates server_memory
@@ -27,22 +46,162 @@ void free_server_memory(server_memory *server);
 
 /**
  * @relates server_memory
- * @brief Stocheaza pe server o pereche (cheie, valoare).
+ * @brief Incepe o modificare a serverului. Toate modificarile (`server_store`,
+ * `server_remove`, `transfer_items`) trebuie facute intre `server_lock` si
+ * `server_unlock` (sau intre `server_write_begin` si `server_write_end`, pe un
+ * server blocat cu `server_hold`) daca serverul poate fi citit concurent
+ * (`server_lookup`) sau modificat din mai multe threaduri
+ * (`server_enable_locking`).
+ *
+ * @param server serverul
+ */
+void server_lock(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Incheie o modificare a serverului.
+ *
+ * @param server serverul
+ */
+void server_unlock(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Blocheaza serverul pentru celelalte threaduri care il modifica, dar
+ * nu si pentru cititorii concurenti. Modificarile facute intre `server_hold`
+ * si `server_release` trebuie incadrate, fiecare, intre `server_write_begin`
+ * si `server_write_end`, ca o modificare lunga sa poata fi impartita in
+ * bucati intre care cititorii nu asteapta.
+ *
+ * @param server serverul
+ */
+void server_hold(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Deblocheaza un server blocat cu `server_hold`.
+ *
+ * @param server serverul
+ */
+void server_release(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Incepe o bucata dintr-o modificare a unui server blocat cu
+ * `server_hold`: pana la `server_write_end`, cautarile concurente pe server
+ * se reiau.
+ *
+ * @param server serverul
+ */
+void server_write_begin(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Incheie o bucata dintr-o modificare (vezi `server_write_begin`).
+ *
+ * @param server serverul
+ */
+void server_write_end(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Permite modificarea serverului din mai multe threaduri: de acum
+ * inainte, `server_lock` ia un mutex propriu serverului.
+ *
+ * @param server serverul
+ */
+void server_enable_locking(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Stocheaza pe server o pereche (cheie, valoare), inlocuind valoarea
+ * veche a cheii, daca exista.
+ *
+ * @param server	serverul pe care se executa operatia
+ * @param key		cheia stocata
+ * @param hash		hashul cheii (`hash_function_key`)
+ * @param value		valoarea stocata (poate contine bytes nuli)
+ * @param value_size	lungimea valorii (fara terminator)
+ */
+void server_store(server_memory *server, char *key, unsigned int hash,
+				  char *value, unsigned int value_size);
+
+/**
+ * @relates server_memory
+ * @brief Stocheaza pe server o pereche care nu ii revine dupa hash (mutata de
+ * pe un server plin). Astfel de perechi sunt retinute separat, deci nu sunt
+ * mutate de `transfer_items`.
  *
  * @param server	serverul pe care se executa operatia
  * @param key		cheia stocata
+ * @param hash		hashul cheii
  * @param value		valoarea stocata
+ * @param value_size	lungimea valorii (fara terminator)
+ */
+void server_store_displaced(server_memory *server, char *key,
+							unsigned int hash, char *value,
+							unsigned int value_size);
+
+/**
+ * @relates server_memory
+ * @brief Returneaza valoarea unei perechi stocate cu `server_store_displaced`.
+ *
+ * @param server	serverul pe care se cauta cheia
+ * @param key		cheia cautata
+ * @param hash		hashul cheii
+ *
+ * @return		valoarea gasita
+ * @retval NULL	valoarea nu exista pe server
  */
-void server_store(server_memory *server, char *key, char *value);
+char *server_retrieve_displaced(server_memory *server, char *key,
+								unsigned int hash);
 
 /**
  * @relates server_memory
- * @brief Sterge o pereche (cheie, valoare) de pe server.
+ * @brief Sterge o pereche stocata cu `server_store_displaced`, daca exista.
  *
  * @param server	serverul pe care se executa operatia
  * @param key		cheia perechii sterse
+ * @param hash		hashul cheii
+ *
+ * @return daca perechea a existat
+ */
+bool server_remove_displaced(server_memory *server, char *key,
+							 unsigned int hash);
+
+/**
+ * @relates server_memory
+ * @brief Apeleaza o functie pentru fiecare pereche stocata pe server
+ * (inclusiv cele mutate de pe alte servere). Functia nu trebuie sa modifice
+ * serverul.
+ *
+ * @param server	serverul
+ * @param func		functia apelata, cu perechea si `arg`
+ * @param arg		argument dat mai departe functiei
+ */
+void server_for_each(server_memory *server,
+					 void (*func)(dict_entry *entry, void *arg), void *arg);
+
+/**
+ * @relates server_memory
+ * @brief Numarul de perechi stocate pe server (inclusiv cele mutate de pe
+ * alte servere).
+ *
+ * @param server serverul
  */
-void server_remove(server_memory *server, char *key);
+size_t server_size(server_memory *server);
+
+/**
+ * @relates server_memory
+ * @brief Sterge o pereche (cheie, valoare) de pe server, daca exista.
+ *
+ * @param server	serverul pe care se executa operatia
+ * @param key		cheia perechii sterse
+ * @param hash		hashul cheii
+ *
+ * @return daca perechea a existat
+ */
+bool server_remove(server_memory *server, char *key, unsigned int hash);
 
 /**
  * @relates server_memory
@@ -50,11 +209,78 @@ void server_remove(server_memory *server, char *key);
  *
  * @param server	serverul pe care se cauta cheia
  * @param key		cheia cautata
+ * @param hash		hashul cheii
+ *
+ * @return		valoarea gasita
+ * @retval NULL	valoarea nu exista pe server
+ */
+char *server_retrieve(server_memory *server, char *key, unsigned int hash);
+
+/**
+ * @relates server_memory
+ * @brief Aduce in cache bucketul unei chei, inaintea unei operatii pe ea.
+ *
+ * @param server	serverul
+ * @param hash		hashul cheii
+ */
+void server_prefetch_bucket(server_memory *server, unsigned int hash);
+
+/**
+ * @relates server_memory
+ * @brief Aduce in cache primul nod din bucketul unei chei, dupa
+ * `server_prefetch_bucket`.
+ *
+ * @param server	serverul
+ * @param hash		hashul cheii
+ */
+void server_prefetch_node(server_memory *server, unsigned int hash);
+
+/**
+ * @relates server_memory
+ * @brief Returneaza valoarea stocata la o cheie, fara sa modifice serverul.
+ * Poate fi apelata concurent cu operatiile threadului care modifica serverul,
+ * din interiorul unei sectiuni critice a domeniului dat la
+ * `server_set_reclaimer`; valoarea ramane valida pana la iesirea din ea.
+ *
+ * @param server	serverul pe care se cauta cheia
+ * @param key		cheia cautata
+ * @param hash		hashul cheii
  *
  * @return		valoarea gasita
  * @retval NULL	valoarea nu exista pe server
  */
-char *server_retrieve(server_memory *server, char *key);
+char *server_lookup(server_memory *server, char *key, unsigned int hash);
+
+/**
+ * @relates server_memory
+ * @brief Permite cautari concurente cu `server_lookup`.
+ *
+ * @param server	serverul
+ * @param reclaimer	domeniul prin care se elibereaza memoria vizibila
+ *					cititorilor
+ */
+void server_set_reclaimer(server_memory *server, epoch *reclaimer);
+
+/**
+ * @relates server_memory
+ * @brief Intoarce memoria folosita de obiectele alocate de server, respectiv
+ * memoria pe care acesta a rezervat-o.
+ *
+ * @param[in]	server		serverul
+ * @param[out]	used		memoria ocupata de obiecte (in bytes)
+ * @param[out]	reserved	memoria rezervata (in bytes)
+ */
+void server_memory_usage(server_memory *server, size_t *used,
+						 size_t *reserved);
+
+/**
+ * @relates server_memory
+ * @brief Calculeaza ocuparea serverului (vezi `ht_get_stats`).
+ *
+ * @param[in]	server	serverul
+ * @param[out]	stats	ocuparea sa
+ */
+void server_get_stats(server_memory *server, server_stats *stats);
 
 /**
  * @relates server_memory
@@ -65,8 +291,81 @@ char *server_retrieve(server_memory *server, char *key);
  * @param src		serverul original
  * @param min_hash	hashul minim pe care il au obiectele transferate
  * @param max_hash	hashul maxim pe care il au obiectele transferate
+ *
+ * @return numarul de obiecte transferate
+ */
+size_t transfer_items(server_memory *dest, server_memory *src,
+					  unsigned int min_hash, unsigned int max_hash);
+
+/**
+ * @relates server_memory
+ * @brief Transfera deodata obiectele din mai multe intervale de hashuri
+ * (disjuncte) de pe `src` pe `dest`.
+ *
+ * @param dest		serverul destinatie
+ * @param src		serverul original
+ * @param ranges	intervalele transferate
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte transferate
+ */
+size_t transfer_ranges(server_memory *dest, server_memory *src,
+					   const hash_range *ranges, size_t count);
+
+/**
+ * @relates server_memory
+ * @brief Copiaza obiectele din mai multe intervale de hashuri (disjuncte) de
+ * pe `src` pe `dest`, unde devin replici.
+ *
+ * @param dest		serverul destinatie
+ * @param src		serverul original
+ * @param ranges	intervalele copiate
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte copiate
+ */
+size_t copy_ranges(server_memory *dest, server_memory *src,
+				   const hash_range *ranges, size_t count);
+
+/**
+ * @relates server_memory
+ * @brief Sterge de pe server obiectele din mai multe intervale de hashuri
+ * (disjuncte).
+ *
+ * @param server	serverul
+ * @param ranges	intervalele sterse
+ * @param count		numarul de intervale
+ *
+ * @return numarul de obiecte sterse
+ */
+size_t server_remove_ranges(server_memory *server, const hash_range *ranges,
+							size_t count);
+
+/**
+ * @relates server_memory
+ * @brief Numara obiectele de pe server cu hashul in `[min_hash, max_hash)`.
+ *
+ * @param server	serverul
+ * @param min_hash	hashul minim
+ * @param max_hash	hashul maxim (exclusiv)
+ */
+size_t server_count_range(server_memory *server, unsigned int min_hash,
+						  unsigned int max_hash);
+
+/**
+ * @relates server_memory
+ * @brief Alege o limita `bound` astfel incat `[min_hash, bound)` sa contina
+ * aproximativ `count` obiecte de pe server, pentru transferuri facute pe
+ * bucati.
+ *
+ * @param server	serverul
+ * @param min_hash	inceputul intervalului
+ * @param max_hash	sfarsitul (exclusiv) al intervalului
+ * @param count		numarul dorit de obiecte (cel putin 1)
+ *
+ * @return limita aleasa (`max_hash` daca intervalul are mai putine obiecte)
  */
-void transfer_items(server_memory *dest, server_memory *src,
-					unsigned int min_hash, unsigned int max_hash);
+unsigned int server_range_bound(server_memory *server, unsigned int min_hash,
+								unsigned int max_hash, size_t count);
 
 #endif /* SERVER_H_ */
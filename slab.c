@@ -0,0 +1,292 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#define _POSIX_C_SOURCE 200112L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "slab.h"
+#include "utils.h"
+
+/** Dimensiunea (si alinierea) unui chunk */
+#define SLAB_CHUNK_SIZE 65536
+
+/** Alinierea blocurilor */
+#define SLAB_ALIGN 16
+
+/** Pana la aceasta dimensiune, clasele cresc cu cate `SLAB_SMALL_STEP` */
+#define SLAB_SMALL_MAX 512
+#define SLAB_SMALL_STEP 32
+
+/** Blocurile mai mari de atat primesc cate un chunk separat */
+#define SLAB_MAX_BLOCK (SLAB_CHUNK_SIZE / 8)
+
+/** Clasa blocurilor care nu incap intr-un chunk obisnuit */
+#define SLAB_LARGE_CLASS -1
+
+/**
+ * @class slab_chunk
+ * @brief Antetul unui chunk, aflat la inceputul zonei de memorie a acestuia.
+ */
+typedef struct slab_chunk {
+	/** alocatorul care detine chunkul */
+	slab *owner;
+	/** vecinii din lista tuturor chunkurilor alocatorului */
+	struct slab_chunk *prev, *next;
+	/** urmatorul chunk cu blocuri libere din aceeasi clasa */
+	struct slab_chunk *next_partial;
+	/** daca chunkul se afla in lista de chunkuri cu blocuri libere */
+	bool in_partial;
+
+	/** clasa blocurilor (sau `SLAB_LARGE_CLASS`) */
+	int size_class;
+	/** dimensiunea unui bloc */
+	size_t block_size;
+	/** numarul de blocuri alocate din chunk */
+	size_t live;
+	/** dimensiunea totala a chunkului */
+	size_t size;
+
+	/** blocurile eliberate, inlantuite prin primii bytes ai fiecaruia */
+	void *free_list;
+	/** primul bloc care nu a fost alocat niciodata */
+	char *bump;
+	/** sfarsitul zonei de blocuri */
+	char *end;
+} slab_chunk;
+
+/** Dimensiunea antetului, rotunjita la alinierea blocurilor */
+#define SLAB_HEADER_SIZE \
+	((sizeof(slab_chunk) + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN)
+
+/** Calculeaza clasa in care intra un bloc de `size` bytes. */
+static int slab_size_class(size_t size)
+{
+	if (size > SLAB_MAX_BLOCK)
+		return SLAB_LARGE_CLASS;
+	if (size <= SLAB_SMALL_MAX)
+		return size ? (size - 1) / SLAB_SMALL_STEP : 0;
+
+	int size_class = SLAB_SMALL_MAX / SLAB_SMALL_STEP;
+	for (size_t limit = SLAB_SMALL_MAX * 2; limit < size; limit *= 2)
+		++size_class;
+	return size_class;
+}
+
+/** Calculeaza dimensiunea blocurilor dintr-o clasa. */
+static size_t slab_class_size(int size_class)
+{
+	int small_classes = SLAB_SMALL_MAX / SLAB_SMALL_STEP;
+	if (size_class < small_classes)
+		return (size_t)(size_class + 1) * SLAB_SMALL_STEP;
+
+	return (size_t)SLAB_SMALL_MAX << (size_class - small_classes + 1);
+}
+
+static inline slab_chunk *slab_chunk_of(void *ptr)
+{
+	return (slab_chunk *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_CHUNK_SIZE - 1));
+}
+
+/** Aloca un chunk nou pentru blocuri de dimensiunea `block_size`. */
+static slab_chunk *slab_new_chunk(slab *allocator, int size_class,
+								  size_t block_size)
+{
+	size_t size = SLAB_CHUNK_SIZE;
+	if (size_class == SLAB_LARGE_CLASS)
+		size = SLAB_HEADER_SIZE + block_size;
+
+	void *memory;
+	DIE(posix_memalign(&memory, SLAB_CHUNK_SIZE, size),
+		"failed posix_memalign() of slab_chunk");
+
+	slab_chunk *chunk = memory;
+	chunk->owner = allocator;
+	chunk->prev = NULL;
+	chunk->next = allocator->chunks;
+	if (allocator->chunks)
+		allocator->chunks->prev = chunk;
+	allocator->chunks = chunk;
+
+	chunk->next_partial = NULL;
+	chunk->in_partial = false;
+	chunk->size_class = size_class;
+	chunk->block_size = block_size;
+	chunk->live = 0;
+	chunk->size = size;
+	chunk->free_list = NULL;
+	chunk->bump = (char *)chunk + SLAB_HEADER_SIZE;
+	chunk->end = (char *)chunk + size;
+
+	allocator->reserved += size;
+	return chunk;
+}
+
+/** Scoate chunkul din lista alocatorului si il elibereaza. */
+static void slab_release_chunk(slab_chunk *chunk)
+{
+	slab *owner = chunk->owner;
+
+	if (chunk->prev)
+		chunk->prev->next = chunk->next;
+	else
+		owner->chunks = chunk->next;
+	if (chunk->next)
+		chunk->next->prev = chunk->prev;
+
+	owner->reserved -= chunk->size;
+	free(chunk);
+}
+
+static inline void slab_lock(slab *allocator)
+{
+	if (allocator->locking)
+		pthread_mutex_lock(&allocator->lock);
+}
+
+static inline void slab_unlock(slab *allocator)
+{
+	if (allocator->locking)
+		pthread_mutex_unlock(&allocator->lock);
+}
+
+/** Elibereaza alocatorul propriu-zis, dupa ce nu mai are chunkuri. */
+static void slab_release(slab *allocator)
+{
+	if (allocator->locking)
+		pthread_mutex_destroy(&allocator->lock);
+	free(allocator);
+}
+
+slab *slab_create(void)
+{
+	slab *allocator = calloc(1, sizeof(slab));
+	DIE(!allocator, "failed malloc() of slab");
+
+	return allocator;
+}
+
+void slab_enable_locking(slab *allocator)
+{
+	if (allocator->locking)
+		return;
+
+	DIE(pthread_mutex_init(&allocator->lock, NULL),
+		"failed pthread_mutex_init() of slab.lock");
+	allocator->locking = true;
+}
+
+/** Aloca un bloc; alocatorul trebuie sa fie deja blocat. */
+static void *slab_alloc_locked(slab *allocator, size_t size)
+{
+	int size_class = slab_size_class(size);
+
+	if (size_class == SLAB_LARGE_CLASS) {
+		size_t block_size = (size + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+		slab_chunk *chunk =
+			slab_new_chunk(allocator, SLAB_LARGE_CLASS, block_size);
+
+		chunk->live = 1;
+		allocator->used += block_size;
+		return chunk->bump;
+	}
+
+	slab_chunk *chunk = allocator->partial[size_class];
+	if (!chunk) {
+		chunk = slab_new_chunk(allocator, size_class,
+							   slab_class_size(size_class));
+		chunk->in_partial = true;
+		allocator->partial[size_class] = chunk;
+	}
+
+	void *block;
+	if (chunk->free_list) {
+		block = chunk->free_list;
+		chunk->free_list = *(void **)block;
+	} else {
+		block = chunk->bump;
+		chunk->bump += chunk->block_size;
+	}
+
+	++chunk->live;
+	allocator->used += chunk->block_size;
+
+	/* Chunkul plin iese din lista, pana se elibereaza un bloc din el. */
+	if (!chunk->free_list &&
+		(size_t)(chunk->end - chunk->bump) < chunk->block_size) {
+		allocator->partial[size_class] = chunk->next_partial;
+		chunk->next_partial = NULL;
+		chunk->in_partial = false;
+	}
+
+	return block;
+}
+
+void *slab_alloc(slab *allocator, size_t size)
+{
+	slab_lock(allocator);
+	void *block = slab_alloc_locked(allocator, size);
+	slab_unlock(allocator);
+
+	return block;
+}
+
+void slab_free(void *ptr)
+{
+	slab_chunk *chunk = slab_chunk_of(ptr);
+	slab *owner = chunk->owner;
+
+	slab_lock(owner);
+	--chunk->live;
+	owner->used -= chunk->block_size;
+
+	if (chunk->size_class == SLAB_LARGE_CLASS) {
+		slab_release_chunk(chunk);
+	} else if (owner->destroyed) {
+		/* Chunkurile alocatorilor distrusi nu mai sunt refolosite. */
+		if (!chunk->live)
+			slab_release_chunk(chunk);
+	} else {
+		*(void **)ptr = chunk->free_list;
+		chunk->free_list = ptr;
+
+		if (!chunk->in_partial) {
+			chunk->next_partial = owner->partial[chunk->size_class];
+			owner->partial[chunk->size_class] = chunk;
+			chunk->in_partial = true;
+		}
+	}
+
+	bool release = owner->destroyed && !owner->chunks;
+	slab_unlock(owner);
+
+	if (release)
+		slab_release(owner);
+}
+
+size_t slab_block_size(void *ptr)
+{
+	return slab_chunk_of(ptr)->block_size;
+}
+
+void slab_destroy(slab *allocator)
+{
+	slab_lock(allocator);
+
+	slab_chunk *chunk = allocator->chunks;
+	while (chunk) {
+		slab_chunk *next = chunk->next;
+
+		if (!chunk->live)
+			slab_release_chunk(chunk);
+		chunk = next;
+	}
+
+	/* Alocatorul ramane in viata cat timp are chunkuri cu blocuri mutate in
+	 * alte structuri, pentru ca acestea isi gasesc prin el lista si lockul. */
+	allocator->destroyed = true;
+	bool release = !allocator->chunks;
+	slab_unlock(allocator);
+
+	if (release)
+		slab_release(allocator);
+}
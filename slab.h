@@ -0,0 +1,100 @@
+/* Copyright 2023 Sima Alexandru (312CA) */
+#ifndef SLAB_H_
+#define SLAB_H_
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Numarul de clase de dimensiuni ale blocurilor */
+#define SLAB_NUM_CLASSES 20
+
+struct slab_chunk;
+
+/**
+ * @class slab
+ * @brief Alocator de blocuri mici, grupate pe clase de dimensiuni in chunkuri
+ * mari (size-classed slab allocator).
+ *
+ * Fiecare chunk isi tine propria lista de blocuri libere, deci un bloc poate
+ * fi eliberat si dupa distrugerea alocatorului (de exemplu un nod retras,
+ * inca vizibil cititorilor concurenti). La distrugerea alocatorului,
+ * chunkurile goale sunt eliberate dintr-o data, iar cele care inca au blocuri
+ * folosite (si alocatorul, care le tine evidenta) raman in viata pana la
+ * eliberarea ultimului bloc.
+ */
+typedef struct slab {
+	/** pentru fiecare clasa, chunkurile care mai au blocuri libere */
+	struct slab_chunk *partial[SLAB_NUM_CLASSES];
+	/** toate chunkurile alocatorului */
+	struct slab_chunk *chunks;
+
+	/** memoria ocupata de blocurile alocate (in bytes) */
+	size_t used;
+	/** memoria rezervata pentru chunkuri (in bytes) */
+	size_t reserved;
+
+	/** daca alocatorul a fost distrus (dar mai are blocuri folosite) */
+	bool destroyed;
+	/** daca operatiile iau `lock` */
+	bool locking;
+	/** protejeaza alocatorul cand blocurile lui pot fi eliberate din alte
+	 * threaduri decat cel care aloca */
+	pthread_mutex_t lock;
+} slab;
+
+/**
+ * @relates slab
+ * @brief Creeaza un alocator gol.
+ *
+ * @return alocatorul creat
+ */
+slab *slab_create(void);
+
+/**
+ * @relates slab
+ * @brief Aloca un bloc.
+ *
+ * @param allocator	alocatorul
+ * @param size		dimensiunea blocului
+ *
+ * @return adresa blocului alocat (aliniata la 16 bytes)
+ */
+void *slab_alloc(slab *allocator, size_t size);
+
+/**
+ * @relates slab
+ * @brief Elibereaza un bloc alocat cu `slab_alloc`, indiferent de alocatorul
+ * care l-a alocat (sau daca acesta a fost distrus intre timp).
+ *
+ * @param ptr adresa blocului
+ */
+void slab_free(void *ptr);
+
+/**
+ * @relates slab
+ * @brief Intoarce dimensiunea utilizabila a unui bloc (cel putin cea ceruta
+ * la alocare), adica dimensiunea clasei sale.
+ *
+ * @param ptr adresa blocului
+ */
+size_t slab_block_size(void *ptr);
+
+/**
+ * @relates slab
+ * @brief Protejeaza alocatorul cu un mutex, pentru cand blocurile lui pot
+ * fi alocate si eliberate din threaduri diferite.
+ *
+ * @param allocator alocatorul
+ */
+void slab_enable_locking(slab *allocator);
+
+/**
+ * @relates slab
+ * @brief Distruge alocatorul, eliberand toate chunkurile care nu mai au
+ * blocuri in folosinta.
+ *
+ * @param allocator alocatorul
+ */
+void slab_destroy(slab *allocator);
+
+#endif /* SLAB_H_ */